@@ -0,0 +1,520 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * The sun_harvester Python module: the Sun model and the
+ * SolarEnergyHarvester power model, without the simulator.
+ *
+ * Besides the scalar functions, the batch functions read the dates from,
+ * and write the results into, caller-provided buffers (NumPy arrays,
+ * array.array, memoryview, ...) through the buffer protocol: the loops run
+ * in C++, without the GIL and without a Python object per element.
+ *
+ * The dates are seconds since the Epoch, float64 or int64, interpreted as
+ * a harvester whose StartAt is in a time zone utc_offset seconds east of
+ * UTC, so the results are the same of the simulated harvesters.
+ *
+ *   import numpy, sun_harvester
+ *   t = numpy.arange (1420070400, 1420070400 + 365 * 86400, 60, dtype=numpy.int64)
+ *   p = numpy.empty (len (t))
+ *   sun_harvester.harvested_powers (t, p, latitude=38.11, longitude=15.661, panel_tilt_angle=30)
+ */
+
+#include <Python.h>
+
+#include "ns3/sun.h"
+#include "ns3/solar-energy-harvester.h"
+
+#include <string.h>
+#include <time.h>
+
+using namespace ns3;
+
+/**
+ * A buffer of float64 or int64 elements, released on destruction
+ */
+class Buffer
+{
+public:
+  Buffer ()
+    : m_acquired (false)
+  {
+  }
+
+  ~Buffer ()
+  {
+    if (m_acquired)
+      {
+        PyBuffer_Release (&m_view);
+      }
+  }
+
+  /**
+   * \param object the buffer exporter, or None if optional
+   * \param name the argument name, for the errors
+   * \param writable the results are written into it
+   * \param integers int64 elements are accepted besides float64
+   * \return false, with a Python exception set, if object is not suitable
+   */
+  bool Acquire (PyObject *object, const char *name, bool writable, bool integers)
+  {
+    if (PyObject_GetBuffer (object, &m_view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0)) != 0)
+      {
+        return false;
+      }
+    m_acquired = true;
+
+    // native byte order and alignment only
+    const char *format = m_view.format;
+    if (format[0] == '@' || format[0] == '=')
+      {
+        ++format;
+      }
+    m_integers = integers && m_view.itemsize == 8 && (!strcmp (format, "q") || !strcmp (format, "l"));
+    if (!m_integers && (m_view.itemsize != 8 || strcmp (format, "d")))
+      {
+        PyErr_Format (PyExc_TypeError, "%s must be a contiguous buffer of float64%s", name,
+                      integers ? " or int64" : "");
+        return false;
+      }
+    return true;
+  }
+
+  Py_ssize_t GetSize (void) const
+  {
+    return m_acquired ? m_view.len / m_view.itemsize : 0;
+  }
+
+  double *GetDoubles (void) const
+  {
+    return m_acquired ? static_cast<double *> (m_view.buf) : 0;
+  }
+
+  int64_t GetInteger (Py_ssize_t i) const
+  {
+    return m_integers ? static_cast<const int64_t *> (m_view.buf)[i]
+           : (int64_t) floor (static_cast<const double *> (m_view.buf)[i]);
+  }
+
+private:
+  Py_buffer m_view;
+  bool m_acquired;
+  bool m_integers;
+};
+
+/**
+ * \param time seconds since the Epoch
+ * \param utcOffset seconds east of UTC
+ * \param date the date the harvester has at time
+ */
+static void
+ToDate (int64_t time, long utcOffset, tm *date)
+{
+  time_t local = time + utcOffset;
+  gmtime_r (&local, date);
+  date->tm_gmtoff = utcOffset;
+}
+
+/**
+ * \return false, with a Python exception set, if name is not an algorithm
+ */
+static bool
+ToAlgorithm (const char *name, Sun::PositionAlgorithm *algorithm)
+{
+  if (!strcmp (name, "PSA"))
+    {
+      *algorithm = Sun::PSA_ALGORITHM;
+    }
+  else if (!strcmp (name, "Fast"))
+    {
+      *algorithm = Sun::FAST_ALGORITHM;
+    }
+  else if (!strcmp (name, "SPA"))
+    {
+      *algorithm = Sun::SPA_ALGORITHM;
+    }
+  else
+    {
+      PyErr_Format (PyExc_ValueError, "unknown algorithm %s, use PSA, Fast or SPA", name);
+      return false;
+    }
+  return true;
+}
+
+/**
+ * The keyword arguments of the panel, with the SolarEnergyHarvester
+ * attribute defaults
+ */
+struct PanelArguments
+{
+  SolarEnergyHarvester::Panel panel;
+  const char *algorithm;
+  long utcOffset;
+
+  PanelArguments ()
+    : algorithm ("PSA"),
+      utcOffset (0)
+  {
+    panel.latitude = 38.11;
+    panel.longitude = 15.661;
+    panel.altitude = 31;
+    panel.solarCellEfficiency = 8;
+    panel.dcdcEfficiency = 90;
+    panel.panelAzimuthAngle = 0;
+    panel.panelTiltAngle = 0;
+    panel.panelDimension = 1;
+    panel.diffusePercentage = 10;
+    panel.sunPositionAlgorithm = Sun::PSA_ALGORITHM;
+  }
+
+  /**
+   * Complete the panel once parsed
+   * \return false, with a Python exception set, on errors
+   */
+  bool Finish (void)
+  {
+    panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+    return ToAlgorithm (algorithm, &panel.sunPositionAlgorithm);
+  }
+};
+
+#define PANEL_KEYWORDS "latitude", "longitude", "altitude", "solar_cell_efficiency", "dcdc_efficiency", \
+  "panel_azimuth_angle", "panel_tilt_angle", "panel_dimension", "diffuse_percentage", "algorithm", "utc_offset"
+#define PANEL_FORMAT "dddddddddsl"
+#define PANEL_ARGUMENTS(a) &a.panel.latitude, &a.panel.longitude, &a.panel.altitude, &a.panel.solarCellEfficiency, \
+  &a.panel.dcdcEfficiency, &a.panel.panelAzimuthAngle, &a.panel.panelTiltAngle, &a.panel.panelDimension, \
+  &a.panel.diffusePercentage, &a.algorithm, &a.utcOffset
+
+PyDoc_STRVAR (air_mass_doc,
+              "air_mass(latitude, altitude)\n\n"
+              "The Air Mass factor of a location, as Sun::GetAirMass.");
+
+static PyObject *
+AirMass (PyObject *self, PyObject *args)
+{
+  double latitude;
+  double altitude;
+  if (!PyArg_ParseTuple (args, "dd:air_mass", &latitude, &altitude))
+    {
+      return 0;
+    }
+  return PyFloat_FromDouble (Sun::GetAirMass (latitude, altitude));
+}
+
+PyDoc_STRVAR (position_doc,
+              "position(time, latitude, longitude, algorithm='PSA', utc_offset=0)\n\n"
+              "The sun position at time, as a (zenith, azimuth, elevation) tuple in degrees.");
+
+static PyObject *
+Position (PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = { "time", "latitude", "longitude", "algorithm", "utc_offset", 0 };
+  long long time;
+  double latitude;
+  double longitude;
+  const char *algorithmName = "PSA";
+  long utcOffset = 0;
+  Sun::PositionAlgorithm algorithm;
+  if (!PyArg_ParseTupleAndKeywords (args, kwargs, "Ldd|sl:position", const_cast<char **> (keywords),
+                                    &time, &latitude, &longitude, &algorithmName, &utcOffset)
+      || !ToAlgorithm (algorithmName, &algorithm))
+    {
+      return 0;
+    }
+
+  tm date;
+  ToDate (time, utcOffset, &date);
+  Sun::Coordinates coordinates;
+  Sun::GetPosition (algorithm, &date, latitude, longitude, &coordinates);
+  return Py_BuildValue ("(ddd)", coordinates.dZenithAngle, coordinates.dAzimuth, coordinates.dElevationAngle);
+}
+
+PyDoc_STRVAR (positions_doc,
+              "positions(times, latitude, longitude, zenith, azimuth, elevation, algorithm='PSA', utc_offset=0)\n\n"
+              "The sun position at every time, written into the float64 buffers zenith, azimuth and elevation,\n"
+              "each one as long as times, or None.");
+
+static PyObject *
+Positions (PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = { "times", "latitude", "longitude", "zenith", "azimuth", "elevation",
+                                    "algorithm", "utc_offset", 0 };
+  PyObject *timesObject;
+  PyObject *outputObjects[3];
+  double latitude;
+  double longitude;
+  const char *algorithmName = "PSA";
+  long utcOffset = 0;
+  Sun::PositionAlgorithm algorithm;
+  if (!PyArg_ParseTupleAndKeywords (args, kwargs, "OddOOO|sl:positions", const_cast<char **> (keywords),
+                                    &timesObject, &latitude, &longitude,
+                                    &outputObjects[0], &outputObjects[1], &outputObjects[2],
+                                    &algorithmName, &utcOffset)
+      || !ToAlgorithm (algorithmName, &algorithm))
+    {
+      return 0;
+    }
+
+  static const char *names[3] = { "zenith", "azimuth", "elevation" };
+  Buffer times;
+  Buffer outputs[3];
+  if (!times.Acquire (timesObject, "times", false, true))
+    {
+      return 0;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+      if (outputObjects[i] == Py_None)
+        {
+          continue;
+        }
+      if (!outputs[i].Acquire (outputObjects[i], names[i], true, false))
+        {
+          return 0;
+        }
+      if (outputs[i].GetSize () != times.GetSize ())
+        {
+          PyErr_Format (PyExc_ValueError, "%s must be as long as times", names[i]);
+          return 0;
+        }
+    }
+
+  double *zenith = outputs[0].GetDoubles ();
+  double *azimuth = outputs[1].GetDoubles ();
+  double *elevation = outputs[2].GetDoubles ();
+  Py_ssize_t n = times.GetSize ();
+  Py_BEGIN_ALLOW_THREADS
+  for (Py_ssize_t i = 0; i < n; ++i)
+    {
+      tm date;
+      ToDate (times.GetInteger (i), utcOffset, &date);
+      Sun::Coordinates coordinates;
+      Sun::GetPosition (algorithm, &date, latitude, longitude, &coordinates);
+      if (zenith)
+        {
+          zenith[i] = coordinates.dZenithAngle;
+        }
+      if (azimuth)
+        {
+          azimuth[i] = coordinates.dAzimuth;
+        }
+      if (elevation)
+        {
+          elevation[i] = coordinates.dElevationAngle;
+        }
+    }
+  Py_END_ALLOW_THREADS
+
+  Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR (harvested_power_doc,
+              "harvested_power(time, latitude=38.11, longitude=15.661, altitude=31, solar_cell_efficiency=8,\n"
+              "                dcdc_efficiency=90, panel_azimuth_angle=0, panel_tilt_angle=0, panel_dimension=1,\n"
+              "                diffuse_percentage=10, algorithm='PSA', utc_offset=0)\n\n"
+              "The power harvested at time, in Watt, as SolarEnergyHarvester::CalculateHarvestedPower;\n"
+              "the defaults are the ones of the harvester attributes.");
+
+static PyObject *
+HarvestedPower (PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = { "time", PANEL_KEYWORDS, 0 };
+  long long time;
+  PanelArguments arguments;
+  if (!PyArg_ParseTupleAndKeywords (args, kwargs, "L|" PANEL_FORMAT ":harvested_power", const_cast<char **> (keywords),
+                                    &time, PANEL_ARGUMENTS (arguments))
+      || !arguments.Finish ())
+    {
+      return 0;
+    }
+
+  tm date;
+  ToDate (time, arguments.utcOffset, &date);
+  return PyFloat_FromDouble (SolarEnergyHarvester::CalculateHarvestedPower (&date, arguments.panel));
+}
+
+PyDoc_STRVAR (harvested_powers_doc,
+              "harvested_powers(times, out, **panel)\n\n"
+              "The power harvested at every time, in Watt, written into the float64 buffer out, as long as\n"
+              "times; the panel keywords are the ones of harvested_power.");
+
+static PyObject *
+HarvestedPowers (PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = { "times", "out", PANEL_KEYWORDS, 0 };
+  PyObject *timesObject;
+  PyObject *outObject;
+  PanelArguments arguments;
+  if (!PyArg_ParseTupleAndKeywords (args, kwargs, "OO|" PANEL_FORMAT ":harvested_powers", const_cast<char **> (keywords),
+                                    &timesObject, &outObject, PANEL_ARGUMENTS (arguments))
+      || !arguments.Finish ())
+    {
+      return 0;
+    }
+
+  Buffer times;
+  Buffer out;
+  if (!times.Acquire (timesObject, "times", false, true) || !out.Acquire (outObject, "out", true, false))
+    {
+      return 0;
+    }
+  if (out.GetSize () != times.GetSize ())
+    {
+      PyErr_SetString (PyExc_ValueError, "out must be as long as times");
+      return 0;
+    }
+
+  double *power = out.GetDoubles ();
+  Py_ssize_t n = times.GetSize ();
+  Py_BEGIN_ALLOW_THREADS
+  for (Py_ssize_t i = 0; i < n; ++i)
+    {
+      tm date;
+      ToDate (times.GetInteger (i), arguments.utcOffset, &date);
+      power[i] = SolarEnergyHarvester::CalculateHarvestedPower (&date, arguments.panel);
+    }
+  Py_END_ALLOW_THREADS
+
+  Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR (panel_insolations_doc,
+              "panel_insolations(times, tilts, azimuths, out, latitude=38.11, longitude=15.661, altitude=31,\n"
+              "                  diffuse_percentage=10, utc_offset=0)\n\n"
+              "The PSA insolation, in W/m^2, of every panel orientation at every time, as\n"
+              "SolarEnergyHarvester::GetPanelInsolation: out is a float64 buffer of len(times) * len(tilts)\n"
+              "elements, row i holding the orientations at times[i]. The sun position is computed once per time,\n"
+              "so the cost per orientation is a few products; the power is the insolation times the efficiencies\n"
+              "and the panel dimension.");
+
+static PyObject *
+PanelInsolations (PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = { "times", "tilts", "azimuths", "out", "latitude", "longitude", "altitude",
+                                    "diffuse_percentage", "utc_offset", 0 };
+  PyObject *timesObject;
+  PyObject *tiltsObject;
+  PyObject *azimuthsObject;
+  PyObject *outObject;
+  double latitude = 38.11;
+  double longitude = 15.661;
+  double altitude = 31;
+  double diffusePercentage = 10;
+  long utcOffset = 0;
+  if (!PyArg_ParseTupleAndKeywords (args, kwargs, "OOOO|ddddl:panel_insolations", const_cast<char **> (keywords),
+                                    &timesObject, &tiltsObject, &azimuthsObject, &outObject,
+                                    &latitude, &longitude, &altitude, &diffusePercentage, &utcOffset))
+    {
+      return 0;
+    }
+
+  Buffer times;
+  Buffer tilts;
+  Buffer azimuths;
+  Buffer out;
+  if (!times.Acquire (timesObject, "times", false, true) || !tilts.Acquire (tiltsObject, "tilts", false, false)
+      || !azimuths.Acquire (azimuthsObject, "azimuths", false, false) || !out.Acquire (outObject, "out", true, false))
+    {
+      return 0;
+    }
+  if (azimuths.GetSize () != tilts.GetSize () || out.GetSize () != times.GetSize () * tilts.GetSize ())
+    {
+      PyErr_SetString (PyExc_ValueError, "azimuths must be as long as tilts, out len(times) * len(tilts)");
+      return 0;
+    }
+
+  const double *tilt = tilts.GetDoubles ();
+  const double *azimuth = azimuths.GetDoubles ();
+  double *insolation = out.GetDoubles ();
+  Py_ssize_t n = times.GetSize ();
+  Py_ssize_t m = tilts.GetSize ();
+  double airMass = Sun::GetAirMass (latitude, altitude);
+  Sun::Location location = Sun::GetLocation (latitude, longitude);
+  Py_BEGIN_ALLOW_THREADS
+  for (Py_ssize_t i = 0; i < n; ++i)
+    {
+      tm date;
+      ToDate (times.GetInteger (i), utcOffset, &date);
+      Sun::CelestialState state;
+      Sun::GetCelestialState (&date, &state);
+      Sun::Coordinates coordinates;
+      Sun::PSA (state, location, &coordinates);
+      for (Py_ssize_t j = 0; j < m; ++j)
+        {
+          insolation[i * m + j] = SolarEnergyHarvester::GetPanelInsolation (coordinates, airMass, tilt[j], azimuth[j],
+                                                                            diffusePercentage);
+        }
+    }
+  Py_END_ALLOW_THREADS
+
+  Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR (enable_counters_doc,
+              "enable_counters(enable)\n\n"
+              "Count the sun position evaluations from now on, as Sun::EnableCounters.");
+
+static PyObject *
+EnableCounters (PyObject *self, PyObject *args)
+{
+  int enable;
+  if (!PyArg_ParseTuple (args, "p:enable_counters", &enable))
+    {
+      return 0;
+    }
+  Sun::EnableCounters (enable);
+  Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR (psa_evaluations_doc,
+              "psa_evaluations()\n\n"
+              "The number of sun position evaluations of the program while counting, as Sun::GetPsaEvaluations.");
+
+static PyObject *
+PsaEvaluations (PyObject *self, PyObject *args)
+{
+  return PyLong_FromUnsignedLongLong (Sun::GetPsaEvaluations ());
+}
+
+static PyMethodDef g_methods[] = {
+  { "air_mass", (PyCFunction) AirMass, METH_VARARGS, air_mass_doc },
+  { "position", (PyCFunction) Position, METH_VARARGS | METH_KEYWORDS, position_doc },
+  { "positions", (PyCFunction) Positions, METH_VARARGS | METH_KEYWORDS, positions_doc },
+  { "harvested_power", (PyCFunction) HarvestedPower, METH_VARARGS | METH_KEYWORDS, harvested_power_doc },
+  { "harvested_powers", (PyCFunction) HarvestedPowers, METH_VARARGS | METH_KEYWORDS, harvested_powers_doc },
+  { "panel_insolations", (PyCFunction) PanelInsolations, METH_VARARGS | METH_KEYWORDS, panel_insolations_doc },
+  { "enable_counters", (PyCFunction) EnableCounters, METH_VARARGS, enable_counters_doc },
+  { "psa_evaluations", (PyCFunction) PsaEvaluations, METH_NOARGS, psa_evaluations_doc },
+  { 0, 0, 0, 0 }
+};
+
+static struct PyModuleDef g_module = {
+  PyModuleDef_HEAD_INIT,
+  "sun_harvester",
+  "The sun-harvester Sun and SolarEnergyHarvester power models, with batch functions on buffers.",
+  -1,
+  g_methods
+};
+
+PyMODINIT_FUNC
+PyInit_sun_harvester (void)
+{
+  return PyModule_Create (&g_module);
+}
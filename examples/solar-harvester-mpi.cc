@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Multi-rank scaling workload: nNodes nodes, split in contiguous blocks
+ * among the MPI ranks, each one with a BasicEnergySource and a
+ * SolarEnergyHarvester, simulated for the given number of days with the
+ * distributed simulator. Every rank installs the harvesters of its own
+ * nodes only, keeps its own sun-model caches and, with --tracing=1, writes
+ * its own trace file. Every rank prints its wall time and event count,
+ * and rank 0 the totals, one "key value" pair per line.
+ *
+ * Usage example, on the local host:
+ *
+ *   ./waf --run "solar-harvester-mpi --nodes=10000 --days=30 --interval=60s" --command-template="mpirun -np 4 %s"
+ *
+ * utils/sun-harvester-mpi-scaling.sh runs it with an increasing number of
+ * ranks.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/energy-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
+
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SolarHarvesterMpi");
+
+static double
+GetWallSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int
+main (int argc, char *argv[])
+{
+#ifdef NS3_MPI
+  uint32_t nNodes = 1000;
+  double days = 7;
+  Time interval = Seconds (60);
+  bool tracing = false;
+  std::string traceFile = "solar-harvester-mpi.tr";
+  bool nullMessage = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes, over all the ranks", nNodes);
+  cmd.AddValue ("days", "Simulated days", days);
+  cmd.AddValue ("interval", "Harvested power update interval", interval);
+  cmd.AddValue ("tracing", "Enable the ascii traces, one file per rank", tracing);
+  cmd.AddValue ("traceFile", "The ascii trace file name, before the rank suffix", traceFile);
+  cmd.AddValue ("nullmsg", "Use the null message synchronization instead of the granted time window", nullMessage);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("SimulatorImplementationType",
+                     StringValue (nullMessage ? "ns3::NullMessageSimulatorImpl" : "ns3::DistributedSimulatorImpl"));
+  MpiInterface::Enable (&argc, &argv);
+
+  uint32_t rank = MpiInterface::GetSystemId ();
+  uint32_t size = MpiInterface::GetSize ();
+
+  double setupBegin = GetWallSeconds ();
+
+  // every rank creates all the nodes, as the distributed simulator expects,
+  // but only the energy sources of its own ones
+  NodeContainer nodes;
+  NodeContainer localNodes;
+  for (uint32_t r = 0; r < size; ++r)
+    {
+      uint32_t first = (uint64_t) nNodes * r / size;
+      uint32_t last = (uint64_t) nNodes * (r + 1) / size;
+      NodeContainer block;
+      block.Create (last - first, r);
+      nodes.Add (block);
+      if (r == rank)
+        {
+          localNodes.Add (block);
+        }
+    }
+
+  BasicEnergySourceHelper sourceHelper;
+  EnergySourceContainer sources = sourceHelper.Install (localNodes);
+
+  SolarEnergyHarvesterHelper harvesterHelper;
+  harvesterHelper.Set ("PeriodicHarvestedPowerUpdateInterval", TimeValue (interval));
+  EnergyHarvesterContainer harvesters = harvesterHelper.BulkInstall (sources);
+
+  if (tracing)
+    {
+      harvesterHelper.EnableAscii (traceFile, harvesters);
+    }
+
+  double setupTime = GetWallSeconds () - setupBegin;
+
+  Simulator::Stop (Days (days));
+
+  double runBegin = GetWallSeconds ();
+  Simulator::Run ();
+  double runTime = GetWallSeconds () - runBegin;
+  uint64_t events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+
+  const SolarEnergyHarvester::Counters &counters = SolarEnergyHarvester::GetGlobalCounters ();
+  std::cout << "rank " << rank << " harvesters " << harvesters.GetN ()
+            << " setup_wall_s " << setupTime << " run_wall_s " << runTime
+            << " events " << events << " harvester_updates " << counters.updates << std::endl;
+
+  unsigned long long localCounts[2] = { (unsigned long long) events, (unsigned long long) counters.updates };
+  unsigned long long totalCounts[2];
+  double maxRunTime;
+  MPI_Reduce (localCounts, totalCounts, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce (&runTime, &maxRunTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (rank == 0)
+    {
+      std::cout << "ranks " << size << std::endl;
+      std::cout << "nodes " << nNodes << std::endl;
+      std::cout << "days " << days << std::endl;
+      std::cout << "interval_s " << interval.GetSeconds () << std::endl;
+      std::cout << "run_wall_s " << maxRunTime << std::endl;
+      std::cout << "events " << totalCounts[0] << std::endl;
+      std::cout << "events_per_wall_s " << (maxRunTime > 0 ? totalCounts[0] / maxRunTime : 0) << std::endl;
+      std::cout << "harvester_updates " << totalCounts[1] << std::endl;
+    }
+
+  MpiInterface::Disable ();
+  return 0;
+#else
+  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+}
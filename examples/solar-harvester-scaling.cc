@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Reference workload for the performance of the module: nNodes nodes, each
+ * one with a BasicEnergySource and a SolarEnergyHarvester, simulated for
+ * the given number of days. At the end, the wall time, the number of
+ * processed events and the peak resident memory are reported, one
+ * "key value" pair per line.
+ *
+ * Usage example:
+ *
+ *   ./waf --run "solar-harvester-scaling --nodes=10000 --days=30 --interval=60s --tracing=none"
+ *
+ * With --bulkInstall, the harvesters are installed with
+ * SolarEnergyHarvesterHelper::BulkInstall; with --specFile, they are
+ * installed from a per-node panel spec file (see
+ * SolarEnergyHarvesterHelper::InstallFromFile).
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/energy-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SolarHarvesterScaling");
+
+static uint64_t g_traceFirings = 0;
+
+static double
+GetWallSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* Trace sink doing the least possible work, to measure the trace overhead. */
+static void
+HarvestedPower (double oldValue, double harvestedPower)
+{
+  ++g_traceFirings;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nNodes = 1000;
+  double days = 30;
+  Time interval = Seconds (1);
+  std::string tracing = "none";
+  std::string traceFile = "solar-harvester-scaling.tr";
+  std::string specFile = "";
+  bool bulkInstall = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes", nNodes);
+  cmd.AddValue ("days", "Simulated days", days);
+  cmd.AddValue ("interval", "Harvested power update interval", interval);
+  cmd.AddValue ("tracing", "Tracing mode: none, callback (empty sink on HarvestedPower) or ascii", tracing);
+  cmd.AddValue ("traceFile", "The ascii trace file name", traceFile);
+  cmd.AddValue ("bulkInstall", "Install the harvesters with SolarEnergyHarvesterHelper::BulkInstall", bulkInstall);
+  cmd.AddValue ("specFile", "Install the harvesters from this panel spec file (CSV or binary) instead of the attribute defaults", specFile);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (tracing == "none" || tracing == "callback" || tracing == "ascii",
+                       "Unknown tracing mode " << tracing);
+
+  Sun::EnableCounters (true);
+  double setupBegin = GetWallSeconds ();
+
+  NodeContainer nodes;
+  nodes.Create (nNodes);
+
+  BasicEnergySourceHelper sourceHelper;
+  EnergySourceContainer sources = sourceHelper.Install (nodes);
+
+  SolarEnergyHarvesterHelper harvesterHelper;
+  harvesterHelper.Set ("PeriodicHarvestedPowerUpdateInterval", TimeValue (interval));
+  double installBegin = GetWallSeconds ();
+  EnergyHarvesterContainer harvesters;
+  if (!specFile.empty ())
+    {
+      harvesters = harvesterHelper.InstallFromFile (sources, specFile);
+    }
+  else if (bulkInstall)
+    {
+      harvesters = harvesterHelper.BulkInstall (sources);
+    }
+  else
+    {
+      harvesters = harvesterHelper.Install (sources);
+    }
+  double installTime = GetWallSeconds () - installBegin;
+
+  if (tracing == "callback")
+    {
+      for (EnergyHarvesterContainer::Iterator i = harvesters.Begin (); i != harvesters.End (); ++i)
+        {
+          (*i)->TraceConnectWithoutContext ("HarvestedPower", MakeCallback (&HarvestedPower));
+        }
+    }
+  else if (tracing == "ascii")
+    {
+      AsciiTraceHelper ascii;
+      harvesterHelper.EnableAscii (ascii.CreateFileStream (traceFile), harvesters);
+    }
+
+  double setupTime = GetWallSeconds () - setupBegin;
+
+  Time duration = Days (days);
+  Simulator::Stop (duration);
+
+  double runBegin = GetWallSeconds ();
+  Simulator::Run ();
+  double runTime = GetWallSeconds () - runBegin;
+  uint64_t events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+
+  const SolarEnergyHarvester::Counters &counters = SolarEnergyHarvester::GetGlobalCounters ();
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  std::cout << "nodes " << nNodes << std::endl;
+  std::cout << "days " << days << std::endl;
+  std::cout << "interval_s " << interval.GetSeconds () << std::endl;
+  std::cout << "tracing " << tracing << std::endl;
+  std::cout << "install " << (!specFile.empty () ? "file" : bulkInstall ? "bulk" : "default") << std::endl;
+  std::cout << "install_wall_s " << installTime << std::endl;
+  std::cout << "install_wall_s_per_10k_nodes " << installTime / nNodes * 10000 << std::endl;
+  std::cout << "setup_wall_s " << setupTime << std::endl;
+  std::cout << "run_wall_s " << runTime << std::endl;
+  std::cout << "events " << events << std::endl;
+  std::cout << "events_per_wall_s " << (runTime > 0 ? events / runTime : 0) << std::endl;
+  std::cout << "events_per_sim_s_per_node " << events / duration.GetSeconds () / nNodes << std::endl;
+  std::cout << "harvester_updates " << counters.updates << std::endl;
+  std::cout << "harvester_night_updates " << counters.nightUpdates << std::endl;
+  std::cout << "harvester_trace_firings " << counters.traceFirings << std::endl;
+  std::cout << "sink_trace_firings " << g_traceFirings << std::endl;
+  std::cout << "psa_evaluations " << Sun::GetPsaEvaluations () << std::endl;
+  std::cout << "celestial_evaluations " << Sun::GetCelestialEvaluations () << std::endl;
+  std::cout << "peak_rss_kb " << usage.ru_maxrss << std::endl;
+
+  return 0;
+}
@@ -26,11 +26,72 @@
 
 
 #include "ns3/energy-harvester.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+#include <fstream>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("SolarEnergyHarvesterHelper");
 
+const char SolarEnergyHarvesterHelper::SpecFileMagic[8] = { 'S', 'H', 'S', 'P', 'E', 'C', '0', '1' };
+
+/**
+ * Parse one CSV spec line into spec; the date is converted with strptime
+ * and mktime only when it differs from the one of the previous line.
+ *
+ * \return false if the line is malformed
+ */
+static bool
+ParseSpecLine (const char *line, SolarEnergyHarvesterHelper::PanelSpec &spec,
+               std::string &lastDate, int64_t &lastStartTime)
+{
+  char *end;
+  spec.nodeId = strtoul (line, &end, 10);
+  double *fields[] = { &spec.latitude, &spec.longitude, &spec.altitude, &spec.panelTiltAngle,
+                       &spec.panelAzimuthAngle, &spec.panelDimension, &spec.solarCellEfficiency,
+                       &spec.dcdcEfficiency };
+  for (size_t i = 0; i < sizeof (fields) / sizeof (fields[0]); ++i)
+    {
+      if (end == line || *end != ',')
+        {
+          return false;
+        }
+      line = end + 1;
+      *fields[i] = strtod (line, &end);
+    }
+  if (end == line || *end != ',')
+    {
+      return false;
+    }
+  line = end + 1;
+  while (*line == ' ')
+    {
+      ++line;
+    }
+
+  if (lastDate != line)
+    {
+      struct tm tm;
+      memset (&tm, 0, sizeof (tm));
+      if (!strptime (line, "%Y-%m-%d %H:%M:%S", &tm))
+        {
+          return false;
+        }
+      tm.tm_isdst = -1;
+      lastDate = line;
+      lastStartTime = mktime (&tm);
+    }
+  spec.startTime = lastStartTime;
+  spec.reserved = 0;
+  return true;
+}
+
 
 SolarEnergyHarvesterHelper::SolarEnergyHarvesterHelper (void)
 {
@@ -47,21 +108,214 @@ SolarEnergyHarvesterHelper::Set (std::string name, const AttributeValue &v)
   m_solarEnergyHarvester.Set (name, v);
 }
 
+bool
+SolarEnergyHarvesterHelper::IsLocal (Ptr<EnergySource> source)
+{
+  return source->GetNode ()->GetSystemId () == Simulator::GetSystemId ();
+}
+
 Ptr<EnergyHarvester>
 SolarEnergyHarvesterHelper::DoInstall (Ptr<EnergySource> source) const
 {
   NS_ASSERT (source != 0);
-  Ptr<Node> node = source->GetNode ();
 
   // Create a new Basic Energy Harvester
-  Ptr<EnergyHarvester> harvester = m_solarEnergyHarvester.Create<EnergyHarvester> ();
+  Ptr<SolarEnergyHarvester> harvester = m_solarEnergyHarvester.Create<SolarEnergyHarvester> ();
   NS_ASSERT (harvester != 0);
 
+  if (!IsLocal (source))
+    {
+      // the node is simulated by another rank: the harvester stays idle
+      harvester->SetNode (source->GetNode ());
+      harvester->SetDeferredStart (true);
+      return harvester;
+    }
+
   // Connect the Basic Energy Harvester to the Energy Source
+  Connect (harvester, source);
+  return harvester;
+}
+
+void
+SolarEnergyHarvesterHelper::Connect (Ptr<EnergyHarvester> harvester, Ptr<EnergySource> source)
+{
   source->ConnectEnergyHarvester (harvester);
-  harvester->SetNode (node);
+  harvester->SetNode (source->GetNode ());
   harvester->SetEnergySource (source);
-  return harvester;
+}
+
+void
+SolarEnergyHarvesterHelper::AddToNode (Ptr<EnergyHarvester> harvester)
+{
+  Ptr<Node> node = harvester->GetNode ();
+  Ptr<EnergyHarvesterContainer> harvesters = node->GetObject<EnergyHarvesterContainer> ();
+  if (harvesters == 0)
+    {
+      harvesters = CreateObject<EnergyHarvesterContainer> ();
+      node->AggregateObject (harvesters);
+    }
+  harvesters->Add (harvester);
+}
+
+EnergyHarvesterContainer
+SolarEnergyHarvesterHelper::BulkInstall (EnergySourceContainer sources) const
+{
+  NS_LOG_FUNCTION (this);
+
+  // the attributes are applied, and StartAt parsed, only once
+  Ptr<SolarEnergyHarvester> prototype = m_solarEnergyHarvester.Create<SolarEnergyHarvester> ();
+  prototype->SetDeferredStart (true);
+
+  EnergyHarvesterContainer harvesters;
+  for (EnergySourceContainer::Iterator i = sources.Begin (); i != sources.End (); ++i)
+    {
+      if (!IsLocal (*i))
+        {
+          continue;
+        }
+      Ptr<SolarEnergyHarvester> harvester = CopyObject<SolarEnergyHarvester> (prototype);
+      Connect (harvester, *i);
+      AddToNode (harvester);
+      harvesters.Add (harvester);
+    }
+  prototype->Dispose ();
+
+  Simulator::ScheduleNow (&SolarEnergyHarvesterHelper::StartAll, harvesters);
+  return harvesters;
+}
+
+void
+SolarEnergyHarvesterHelper::StartAll (EnergyHarvesterContainer harvesters)
+{
+  NS_LOG_FUNCTION (harvesters.GetN ());
+  for (EnergyHarvesterContainer::Iterator i = harvesters.Begin (); i != harvesters.End (); ++i)
+    {
+      DynamicCast<SolarEnergyHarvester> (*i)->Start ();
+    }
+}
+
+bool
+SolarEnergyHarvesterHelper::ParsePanelSpec (std::string line, PanelSpec &spec)
+{
+  std::string lastDate;
+  int64_t lastStartTime = 0;
+  return ParseSpecLine (line.c_str (), spec, lastDate, lastStartTime);
+}
+
+EnergyHarvesterContainer
+SolarEnergyHarvesterHelper::InstallFromFile (EnergySourceContainer sources, std::string filename) const
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  // node id -> energy source
+  std::vector<Ptr<EnergySource> > sourceOf;
+  for (EnergySourceContainer::Iterator i = sources.Begin (); i != sources.End (); ++i)
+    {
+      uint32_t id = (*i)->GetNode ()->GetId ();
+      if (id >= sourceOf.size ())
+        {
+          sourceOf.resize (id + 1);
+        }
+      NS_ABORT_MSG_IF (sourceOf[id] != 0, "InstallFromFile: node " << id << " has more than one energy source");
+      sourceOf[id] = *i;
+    }
+
+  std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot open the panel spec file " << filename);
+
+  char magic[sizeof (SpecFileMagic)];
+  file.read (magic, sizeof (magic));
+  bool binary = file.gcount () == sizeof (magic) && memcmp (magic, SpecFileMagic, sizeof (magic)) == 0;
+  if (!binary)
+    {
+      file.clear ();
+      file.seekg (0);
+    }
+
+  // as in BulkInstall, the attributes are applied, and StartAt parsed, once
+  Ptr<SolarEnergyHarvester> prototype = m_solarEnergyHarvester.Create<SolarEnergyHarvester> ();
+  prototype->SetDeferredStart (true);
+
+  EnergyHarvesterContainer harvesters;
+  PanelSpec spec;
+  std::string line;
+  std::string lastDate;
+  int64_t lastStartTime = 0;
+  int64_t lastLocalTime = 0;
+  struct tm startDate;
+  bool haveStartDate = false;
+  uint64_t lineNumber = 0;
+
+  while (true)
+    {
+      if (binary)
+        {
+          file.read (reinterpret_cast<char *> (&spec), sizeof (spec));
+          if (file.gcount () == 0)
+            {
+              break;
+            }
+          NS_ABORT_MSG_UNLESS (file.gcount () == sizeof (spec), "Truncated panel spec file " << filename);
+        }
+      else
+        {
+          if (!std::getline (file, line))
+            {
+              break;
+            }
+          ++lineNumber;
+          size_t comment = line.find ('#');
+          if (comment != std::string::npos)
+            {
+              line.erase (comment);
+            }
+          if (line.find_first_not_of (" \t\r") == std::string::npos)
+            {
+              continue;
+            }
+          line.erase (line.find_last_not_of (" \t\r") + 1);
+          NS_ABORT_MSG_UNLESS (ParseSpecLine (line.c_str (), spec, lastDate, lastStartTime),
+                               filename << ":" << lineNumber << ": malformed panel spec");
+        }
+
+      NS_ABORT_MSG_UNLESS (spec.nodeId < sourceOf.size () && sourceOf[spec.nodeId] != 0,
+                           "InstallFromFile: no energy source for node " << spec.nodeId);
+      if (!IsLocal (sourceOf[spec.nodeId]))
+        {
+          continue;
+        }
+
+      Ptr<SolarEnergyHarvester> harvester = CopyObject<SolarEnergyHarvester> (prototype);
+      Connect (harvester, sourceOf[spec.nodeId]);
+      AddToNode (harvester);
+
+      SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+      panel.latitude = spec.latitude;
+      panel.longitude = spec.longitude;
+      panel.altitude = spec.altitude;
+      panel.panelTiltAngle = spec.panelTiltAngle;
+      panel.panelAzimuthAngle = spec.panelAzimuthAngle;
+      panel.panelDimension = spec.panelDimension;
+      panel.solarCellEfficiency = spec.solarCellEfficiency;
+      panel.dcdcEfficiency = spec.dcdcEfficiency;
+      harvester->SetPanel (panel);
+
+      if (!haveStartDate || spec.startTime != lastLocalTime)
+        {
+          time_t when = spec.startTime;
+          localtime_r (&when, &startDate);
+          lastLocalTime = spec.startTime;
+          haveStartDate = true;
+        }
+      harvester->SetStartDate (startDate);
+
+      harvesters.Add (harvester);
+    }
+  prototype->Dispose ();
+
+  NS_LOG_DEBUG ("Installed " << harvesters.GetN () << " harvesters from " << filename);
+  Simulator::ScheduleNow (&SolarEnergyHarvesterHelper::StartAll, harvesters);
+  return harvesters;
 }
 
 void
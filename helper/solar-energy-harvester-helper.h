@@ -26,6 +26,8 @@
 #include "ns3/solar-energy-trace-helper.h"
 #include "ns3/energy-source.h"
 #include "ns3/node.h"
+#include "ns3/energy-source-container.h"
+#include "ns3/energy-harvester-container.h"
 
 namespace ns3 {
 
@@ -40,13 +42,110 @@ public:
   SolarEnergyHarvesterHelper (void);
   ~SolarEnergyHarvesterHelper (void);
 
+  /**
+   * One record of a binary panel spec file.
+   */
+  struct PanelSpec
+  {
+    uint32_t nodeId;
+    uint32_t reserved; //!< Padding, must be 0
+    double latitude;
+    double longitude;
+    double altitude;
+    double panelTiltAngle;
+    double panelAzimuthAngle;
+    double panelDimension;
+    double solarCellEfficiency;
+    double dcdcEfficiency;
+    int64_t startTime; //!< The starting date, in seconds since the Epoch
+  };
+
   void Set (std::string name, const AttributeValue &v);
 
+  /**
+   * \return true if the node of source is simulated by this process, i.e.,
+   * its system id is the one of the simulator (always true without the
+   * distributed simulator)
+   */
+  static bool IsLocal (Ptr<EnergySource> source);
+
+  /**
+   * Install a SolarEnergyHarvester on the energy sources of the nodes listed
+   * in a panel spec file, reading it in one streaming pass. Every harvester
+   * gets the attributes set with Set, overridden by the values of its record,
+   * which are applied already parsed (SolarEnergyHarvester::SetPanel and
+   * SetStartDate), i.e., without string attributes.
+   *
+   * The file is either CSV, one node per line ('#' starts a comment):
+   *
+   *   nodeId,latitude,longitude,altitude,tilt,azimuth,dimension,solarCellEfficiency,dcdcEfficiency,YYYY-MM-DD hh:mm:ss
+   *
+   * or binary: the SpecFileMagic header followed by PanelSpec records in
+   * native byte order.
+   *
+   * Under the distributed simulator, the records of the nodes owned by other
+   * ranks are skipped. As in BulkInstall, the harvesters are copies of one
+   * prototype, added to the EnergyHarvesterContainer of their node and
+   * started by a single event at the current simulation time.
+   *
+   * \param sources the energy sources, at most one per node
+   * \param filename the spec file name
+   * \return the installed harvesters, in file order
+   */
+  EnergyHarvesterContainer InstallFromFile (EnergySourceContainer sources, std::string filename) const;
+
+  static const char SpecFileMagic[8];
+
+  /**
+   * Parse one CSV line of a panel spec file, as InstallFromFile does.
+   *
+   * \param line the line, without comments
+   * \param spec the parsed record
+   * \return false if the line is malformed
+   */
+  static bool ParsePanelSpec (std::string line, PanelSpec &spec);
+
+  /**
+   * Same as Install, tuned for many energy sources: the attributes set with
+   * Set (including the StartAt date) are applied and parsed once, to a
+   * prototype harvester that is then copied for every source, and all the
+   * harvesters are started by a single event at the current simulation
+   * time, instead of one per harvester in DoInitialize. Only the sources of
+   * the nodes owned by this rank get a harvester. As Install, every harvester
+   * is added to the EnergyHarvesterContainer aggregated to its node.
+   *
+   * \param sources the energy sources
+   * \return the installed harvesters
+   */
+  EnergyHarvesterContainer BulkInstall (EnergySourceContainer sources) const;
+
   virtual void EnableAsciiInternal (Ptr<OutputStreamWrapper> stream, Ptr<SolarEnergyHarvester> nd);
 
 private:
+  /**
+   * Under the distributed simulator, the harvester of a source whose node is
+   * owned by another rank (see IsLocal) is neither connected to the source
+   * nor started, so that Install simulates every harvester on one rank only.
+   */
   virtual Ptr<EnergyHarvester> DoInstall (Ptr<EnergySource> source) const;
 
+  /**
+   * Connect a new harvester to its energy source and node.
+   */
+  static void Connect (Ptr<EnergyHarvester> harvester, Ptr<EnergySource> source);
+
+  /**
+   * Add harvester to the EnergyHarvesterContainer aggregated to its node,
+   * aggregating one if needed, as EnergyHarvesterHelper::Install does.
+   */
+  static void AddToNode (Ptr<EnergyHarvester> harvester);
+
+  /**
+   * Start the periodic updates of all the harvesters installed by BulkInstall
+   * or InstallFromFile.
+   */
+  static void StartAll (EnergyHarvesterContainer harvesters);
+
 private:
   ObjectFactory m_solarEnergyHarvester;
 };
@@ -0,0 +1,69 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-energy-predictor-helper.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarEnergyPredictorHelper");
+
+SolarEnergyPredictorHelper::SolarEnergyPredictorHelper (void)
+{
+  m_solarEnergyPredictor.SetTypeId ("ns3::SolarEnergyPredictor");
+}
+
+SolarEnergyPredictorHelper::~SolarEnergyPredictorHelper (void)
+{
+}
+
+void
+SolarEnergyPredictorHelper::Set (std::string name, const AttributeValue &v)
+{
+  m_solarEnergyPredictor.Set (name, v);
+}
+
+Ptr<SolarEnergyPredictor>
+SolarEnergyPredictorHelper::Install (Ptr<SolarEnergyHarvester> harvester) const
+{
+  NS_ASSERT (harvester != 0);
+
+  Ptr<SolarEnergyPredictor> predictor = m_solarEnergyPredictor.Create<SolarEnergyPredictor> ();
+  predictor->SetHarvester (harvester);
+  harvester->AggregateObject (predictor);
+  return predictor;
+}
+
+void
+SolarEnergyPredictorHelper::Install (EnergyHarvesterContainer c) const
+{
+  for (EnergyHarvesterContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<SolarEnergyHarvester> harvester = DynamicCast<SolarEnergyHarvester> (*i);
+      if (harvester != 0)
+        {
+          Install (harvester);
+        }
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,59 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_ENERGY_PREDICTOR_HELPER_H
+#define SOLAR_ENERGY_PREDICTOR_HELPER_H
+
+#include "ns3/object-factory.h"
+#include "ns3/energy-harvester-container.h"
+#include "ns3/solar-energy-harvester.h"
+#include "ns3/solar-energy-predictor.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * Creates a SolarEnergyPredictor for every SolarEnergyHarvester and
+ * aggregates it to the harvester, so that it can be retrieved with
+ * harvester->GetObject<SolarEnergyPredictor> ().
+ */
+class SolarEnergyPredictorHelper
+{
+public:
+  SolarEnergyPredictorHelper (void);
+  ~SolarEnergyPredictorHelper (void);
+
+  void Set (std::string name, const AttributeValue &v);
+
+  Ptr<SolarEnergyPredictor> Install (Ptr<SolarEnergyHarvester> harvester) const;
+
+  /**
+   * Install a predictor on every SolarEnergyHarvester of the container.
+   */
+  void Install (EnergyHarvesterContainer c) const;
+
+private:
+  ObjectFactory m_solarEnergyPredictor;
+};
+
+} // namespace ns3
+
+#endif /* defined(SOLAR_ENERGY_PREDICTOR_HELPER_H) */
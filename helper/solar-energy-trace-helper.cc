@@ -24,8 +24,12 @@
 #include <iterator>
 
 #include <ns3/assert.h>
+#include <ns3/global-value.h>
 #include <ns3/nstime.h>
 #include <ns3/simulator.h>
+#include <ns3/string.h>
+
+#include <sstream>
 
 namespace ns3 {
 
@@ -52,6 +56,80 @@ SolarEnergyTraceHelper::EnableAscii (Ptr<OutputStreamWrapper> stream, EnergyHarv
     }
 }
 
+void
+SolarEnergyTraceHelper::EnableAscii (std::string filename, EnergyHarvesterContainer n)
+{
+  Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper> (GetRankFilename (filename), std::ios::out);
+  EnableAscii (stream, n);
+}
+
+bool
+SolarEnergyTraceHelper::IsDistributed (void)
+{
+  StringValue type;
+  GlobalValue::GetValueByName ("SimulatorImplementationType", type);
+  return type.Get () == "ns3::DistributedSimulatorImpl" || type.Get () == "ns3::NullMessageSimulatorImpl";
+}
+
+std::string
+SolarEnergyTraceHelper::GetRankFilename (std::string filename)
+{
+  if (!IsDistributed ())
+    {
+      return filename;
+    }
+
+  std::ostringstream rank;
+  rank << "-rank" << Simulator::GetSystemId ();
+  size_t dot = filename.find_last_of ('.');
+  size_t slash = filename.find_last_of ('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+      return filename + rank.str ();
+    }
+  return filename.substr (0, dot) + rank.str () + filename.substr (dot);
+}
+
+void
+SolarEnergyTraceHelper::PrintStatistics (std::ostream &os, EnergyHarvesterContainer n) const
+{
+  for (EnergyHarvesterContainer::Iterator i = n.Begin (); i != n.End (); ++i)
+    {
+      Ptr<SolarEnergyHarvester> dev = DynamicCast<SolarEnergyHarvester> (*i);
+      NS_ASSERT (dev);
+      os << "SolarEnergyHarvester node=" << dev->GetNode ()->GetId ();
+      PrintCounters (os, dev->GetCounters ());
+    }
+
+  os << "SolarEnergyHarvester global";
+  PrintCounters (os, SolarEnergyHarvester::GetGlobalCounters ());
+  os << "Sun psaEvaluations=" << Sun::GetPsaEvaluations () << std::endl;
+}
+
+void
+SolarEnergyTraceHelper::PrintCounters (std::ostream &os, const SolarEnergyHarvester::Counters &counters)
+{
+  os << " psaEvaluations=" << counters.psaEvaluations
+     << " updates=" << counters.updates
+     << " nightUpdates=" << counters.nightUpdates
+     << " sourceNotifications=" << counters.sourceNotifications
+     << " traceFirings=" << counters.traceFirings
+     << " prefetchFallbacks=" << counters.prefetchFallbacks;
+
+  // only the non-empty buckets, as [lower bound in ns]:count
+  bool first = true;
+  for (uint32_t bucket = 0; bucket < 64; ++bucket)
+    {
+      if (counters.latencyHistogram[bucket] == 0)
+        {
+          continue;
+        }
+      os << (first ? " latency=" : ",") << (1ULL << bucket) << ":" << counters.latencyHistogram[bucket];
+      first = false;
+    }
+  os << std::endl;
+}
+
 void
 SolarEnergyTraceHelper::DefaultHarvestedPowerSinkWithContext (Ptr<OutputStreamWrapper> stream, std::string context, double previous, double current)
 {
@@ -58,8 +58,41 @@ public:
    */
   void EnableAscii (Ptr<OutputStreamWrapper> stream, EnergyHarvesterContainer n);
 
+  /**
+   * @brief Same as EnableAscii on a new stream, but under the distributed
+   * simulator every rank writes its own file (see GetRankFilename), so the
+   * ranks never share an output file.
+   *
+   * @param filename the trace file name
+   * \param n container of DeviceEnergyModel.
+   */
+  void EnableAscii (std::string filename, EnergyHarvesterContainer n);
+
   virtual void EnableAsciiInternal (Ptr<OutputStreamWrapper> stream, Ptr<SolarEnergyHarvester> nd) = 0;
 
+  /**
+   * @return true if the simulator implementation is a distributed one
+   */
+  static bool IsDistributed (void);
+
+  /**
+   * @return filename with "-rank" and the rank of this process before the
+   * extension (e.g., "solar-rank2.tr") under the distributed simulator,
+   * filename otherwise
+   */
+  static std::string GetRankFilename (std::string filename);
+
+  /**
+   * @brief Print the hot-path counters and the latency histogram of every
+   * SolarEnergyHarvester in the container, followed by the global ones.
+   *
+   * @param os the output stream
+   * \param n container of SolarEnergyHarvester.
+   */
+  void PrintStatistics (std::ostream &os, EnergyHarvesterContainer n) const;
+
+  static void PrintCounters (std::ostream &os, const SolarEnergyHarvester::Counters &counters);
+
   static void DefaultHarvestedPowerSinkWithContext (Ptr<OutputStreamWrapper> file, std::string context, double previous, double current);
   static void DefaultTotalEnergyHarvestedSinkWithContext (Ptr<OutputStreamWrapper> file, std::string context, double previous, double current);
 
@@ -0,0 +1,223 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-cloud-model.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/sun.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarCloudModel");
+
+NS_OBJECT_ENSURE_REGISTERED (SolarCloudModel);
+
+/**
+ * SplitMix64, used to expand the seeds into the generator states.
+ */
+static uint64_t
+SplitMix (uint64_t &x)
+{
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+TypeId
+SolarCloudModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SolarCloudModel")
+    .SetParent<Object> ()
+    .AddConstructor<SolarCloudModel> ()
+    .AddAttribute ("Mean",
+                   "The mean clear-sky index, by default 0.75",
+                   DoubleValue (0.75),
+                   MakeDoubleAccessor (&SolarCloudModel::m_mean),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("StdDev",
+                   "The standard deviation of the clear-sky index, by default 0.2",
+                   DoubleValue (0.2),
+                   MakeDoubleAccessor (&SolarCloudModel::m_stdDev),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Correlation",
+                   "The correlation between two consecutive samples, by default 0.98",
+                   DoubleValue (0.98),
+                   MakeDoubleAccessor (&SolarCloudModel::m_correlation),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("SpatialCorrelation",
+                   "The share of the innovations common to all the areas, by default 0.5",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&SolarCloudModel::m_spatialCorrelation),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("MinIndex",
+                   "The minimum clear-sky index, by default 0.05",
+                   DoubleValue (0.05),
+                   MakeDoubleAccessor (&SolarCloudModel::m_minIndex),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("Step",
+                   "The time between two samples of the clear-sky index, by default 60 s",
+                   TimeValue (Seconds (60)),
+                   MakeTimeAccessor (&SolarCloudModel::m_step),
+                   MakeTimeChecker ())
+    .AddAttribute ("BlockSize",
+                   "The number of samples generated at a time, by default 1440",
+                   UintegerValue (1440),
+                   MakeUintegerAccessor (&SolarCloudModel::m_blockSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Area",
+                   "The area identifier: models with the same seed, run and area generate the same series",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarCloudModel::m_area),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+SolarCloudModel::SolarCloudModel (void)
+  : m_stream (-1),
+    m_seeded (false),
+    m_last (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SolarCloudModel::~SolarCloudModel (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+double
+SolarCloudModel::GetClearSkyIndex (Time t)
+{
+  NS_ASSERT (m_step.IsStrictlyPositive () && !t.IsNegative ());
+
+  uint64_t sample = t.GetTimeStep () / m_step.GetTimeStep ();
+  while (sample >= m_series.size ())
+    {
+      GenerateBlock ();
+    }
+  return m_series[sample];
+}
+
+int64_t
+SolarCloudModel::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_stream = stream;
+  m_seeded = false;
+  m_series.clear ();
+  return 1;
+}
+
+void
+SolarCloudModel::GenerateBlock (void)
+{
+  NS_LOG_FUNCTION (this << m_series.size ());
+
+  if (!m_seeded)
+    {
+      uint64_t seed = ((uint64_t) RngSeedManager::GetSeed () << 32) ^ RngSeedManager::GetRun ();
+      if (m_stream >= 0)
+        {
+          // mixed, so that consecutive streams give unrelated seeds
+          uint64_t stream = m_stream;
+          seed ^= SplitMix (stream);
+        }
+      m_common.Seed (seed);
+      m_local.Seed (seed ^ (((uint64_t) m_area + 1) * 0xD1B54A32D192ED03ULL));
+      // FillNormal produces pairs
+      m_commonNormal.resize ((m_blockSize + 1) / 2 * 2);
+      m_localNormal.resize ((m_blockSize + 1) / 2 * 2);
+      m_last = m_mean;
+      m_seeded = true;
+    }
+
+  m_common.FillNormal (&m_commonNormal[0], m_commonNormal.size (), m_uniform);
+  m_local.FillNormal (&m_localNormal[0], m_localNormal.size (), m_uniform);
+
+  double common = sqrt (m_spatialCorrelation);
+  double local = sqrt (1 - m_spatialCorrelation);
+  double innovation = m_stdDev * sqrt (1 - m_correlation * m_correlation);
+
+  size_t first = m_series.size ();
+  m_series.resize (first + m_blockSize);
+  for (uint32_t i = 0; i < m_blockSize; ++i)
+    {
+      double e = common * m_commonNormal[i] + local * m_localNormal[i];
+      m_last = m_mean + m_correlation * (m_last - m_mean) + innovation * e;
+      m_last = std::min (std::max (m_last, m_minIndex), 1.0);
+      m_series[first + i] = m_last;
+    }
+}
+
+void
+SolarCloudModel::Generator::Seed (uint64_t seed)
+{
+  for (int i = 0; i < 4; ++i)
+    {
+      m_state[i] = SplitMix (seed);
+    }
+}
+
+uint64_t
+SolarCloudModel::Generator::Next (void)
+{
+  uint64_t result = m_state[0] + m_state[3];
+  uint64_t t = m_state[1] << 17;
+  m_state[2] ^= m_state[0];
+  m_state[3] ^= m_state[1];
+  m_state[1] ^= m_state[2];
+  m_state[0] ^= m_state[3];
+  m_state[2] ^= t;
+  m_state[3] = (m_state[3] << 45) | (m_state[3] >> 19);
+  return result;
+}
+
+void
+SolarCloudModel::Generator::FillNormal (double *normal, uint32_t n, std::vector<double> &uniform)
+{
+  NS_ASSERT (n % 2 == 0);
+  uint32_t pairs = n / 2;
+  uniform.resize (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      // 53 random bits in (0, 1]
+      uniform[i] = ((Next () >> 11) + 1) * (1.0 / 9007199254740992.0);
+    }
+
+  // Box-Muller, with no data dependency between iterations
+  for (uint32_t i = 0; i < pairs; ++i)
+    {
+      double r = sqrt (-2 * log (uniform[2 * i]));
+      double theta = twopi * uniform[2 * i + 1];
+      normal[2 * i] = r * cos (theta);
+      normal[2 * i + 1] = r * sin (theta);
+    }
+}
+
+} // namespace ns3
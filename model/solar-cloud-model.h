@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_CLOUD_MODEL_H
+#define SOLAR_CLOUD_MODEL_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * A stochastic clear-sky index, i.e., the ratio between the actual and the
+ * clear-sky irradiance, shared by the harvesters of an area through their
+ * CloudModel attribute.
+ *
+ * The index is a first order autoregressive process sampled every Step:
+ *
+ *   k(n) = Mean + Correlation (k(n-1) - Mean) + StdDev sqrt(1 - Correlation^2) e(n)
+ *
+ * clamped to [MinIndex, 1]. The innovation e(n) mixes a component common to
+ * all the areas and one local to the Area, weighted by SpatialCorrelation,
+ * so that nearby areas can be correlated.
+ *
+ * The series is generated BlockSize samples at a time, with a small
+ * xoshiro256+ generator and Box-Muller normals computed in a vectorizable
+ * loop, and kept (4 bytes per sample) so that any past time can be queried.
+ * Instead of an ns-3 RandomVariableStream per node and tick, the generators
+ * are seeded from the ns-3 seed and run numbers, from the stream set by
+ * AssignStreams and from the Area: the same seed, run, stream and area
+ * always give the same series. The common innovations depend on the stream
+ * too, so the areas meant to be correlated must share it.
+ */
+class SolarCloudModel : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SolarCloudModel (void);
+  virtual ~SolarCloudModel (void);
+
+  /**
+   * \param t the simulation time
+   * \return the clear-sky index at t
+   */
+  double GetClearSkyIndex (Time t);
+
+  /**
+   * Seed the series from stream too, restarting it if already generated.
+   *
+   * \param stream the first stream index to use
+   * \return the number of stream indices assigned, i.e., 1
+   */
+  int64_t AssignStreams (int64_t stream);
+
+private:
+  /**
+   * A xoshiro256+ generator.
+   */
+  class Generator
+  {
+public:
+    void Seed (uint64_t seed);
+    uint64_t Next (void);
+
+    /**
+     * Fill n standard normal samples, n even.
+     */
+    void FillNormal (double *normal, uint32_t n, std::vector<double> &uniform);
+private:
+    uint64_t m_state[4];
+  };
+
+  /**
+   * Append one block of samples to the series.
+   */
+  void GenerateBlock (void);
+
+private:
+  /** Input Parameter */
+  double m_mean;
+  double m_stdDev;
+  double m_correlation;
+  double m_spatialCorrelation;
+  double m_minIndex;
+  Time m_step;
+  uint32_t m_blockSize;
+  uint32_t m_area;
+
+  /** Internal Parameter */
+  int64_t m_stream; // <- The stream assigned by AssignStreams, -1 if none
+  bool m_seeded; // <- The generators have been seeded
+  Generator m_common; // <- The innovations common to all the areas
+  Generator m_local; // <- The innovations of this area
+  double m_last; // <- The last generated index
+  std::vector<float> m_series; // <- The index at every step
+  std::vector<double> m_commonNormal; // <- Scratch block buffers
+  std::vector<double> m_localNormal;
+  std::vector<double> m_uniform;
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_CLOUD_MODEL_H */
@@ -20,6 +20,13 @@
  */
 
 #include "solar-energy-harvester.h"
+#include "solar-energy-profile.h"
+#include "solar-irradiance-field.h"
+#include "solar-power-window.h"
+#include "solar-shared-profile.h"
+#include "solar-sun-track.h"
+#include "sun-harvester-probes.h"
+#include "sun-harvester-counters.h"
 
 #include "ns3/sun.h"
 #include "ns3/log.h"
@@ -34,8 +41,21 @@
 #include "ns3/nstime.h"
 #include "ns3/event-id.h"
 #include "ns3/device-energy-model.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
 
+#include <algorithm>
 #include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+SUN_HARVESTER_PROBE_DEFINE (update_entry)
+SUN_HARVESTER_PROBE_DEFINE (update_exit)
+SUN_HARVESTER_PROBE_DEFINE (calculate_entry)
+SUN_HARVESTER_PROBE_DEFINE (calculate_exit)
 
 namespace ns3 {
 
@@ -43,6 +63,16 @@ NS_LOG_COMPONENT_DEFINE ("SolarEnergyHarvester");
 
 NS_OBJECT_ENSURE_REGISTERED (SolarEnergyHarvester);
 
+/// The tag of the global harvester counters
+struct HarvesterCounters
+{
+};
+
+static const uint32_t N_COUNTERS = sizeof (SolarEnergyHarvester::Counters) / sizeof (uint64_t);
+static_assert (sizeof (SolarEnergyHarvester::Counters) == N_COUNTERS * sizeof (uint64_t), "The counters are all uint64_t");
+
+typedef PerThreadCounters<HarvesterCounters, N_COUNTERS> HarvesterPerThreadCounters;
+
 TypeId
 SolarEnergyHarvester::GetTypeId (void)
 {
@@ -58,17 +88,20 @@ SolarEnergyHarvester::GetTypeId (void)
     .AddAttribute ("Latitude",
                    "The location's latitude",
                    DoubleValue (38.11),
-                   MakeDoubleAccessor (&SolarEnergyHarvester::m_latitude),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::SetLatitude,
+                                       &SolarEnergyHarvester::GetLatitude),
                    MakeDoubleChecker<double> ())
     .AddAttribute ("Longitude",
                    "The longitude",
                    DoubleValue (15.661),
-                   MakeDoubleAccessor (&SolarEnergyHarvester::m_longitude),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::SetLongitude,
+                                       &SolarEnergyHarvester::GetLongitude),
                    MakeDoubleChecker<double> ())
     .AddAttribute ("Altitude",
                    "The location's altitude from the sea level [m]",
                    DoubleValue (31),
-                   MakeDoubleAccessor (&SolarEnergyHarvester::m_altitude),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::SetAltitude,
+                                       &SolarEnergyHarvester::GetAltitude),
                    MakeDoubleChecker<double> ())
     .AddAttribute ("SolarCellEfficiency",
                    "The Panel Solar Cell efficiency  by default 8 %",
@@ -100,10 +133,179 @@ SolarEnergyHarvester::GetTypeId (void)
                    DoubleValue (10),
                    MakeDoubleAccessor (&SolarEnergyHarvester::m_diffusePercentage),
                    MakeDoubleChecker<double> ())
+    .AddAttribute ("SunPositionAlgorithm",
+                   "The algorithm computing the sun position: PSA (default), Fast (about 0.15 degrees, "
+                   "cheaper) or SPA (about 0.0003 degrees, ten times slower)",
+                   EnumValue (Sun::PSA_ALGORITHM),
+                   MakeEnumAccessor (&SolarEnergyHarvester::m_sunPositionAlgorithm),
+                   MakeEnumChecker (Sun::PSA_ALGORITHM, "PSA",
+                                    Sun::FAST_ALGORITHM, "Fast",
+                                    Sun::SPA_ALGORITHM, "SPA"))
     .AddAttribute ("StartAt", "The starting date for panel simulation in format (24 hours): YYYY-MM-DD hh:mm:ss; Default: 01/01/2015 09:00:00 ",
                    StringValue ("2015-01-01 09:00:00"),
                    MakeStringAccessor  (&SolarEnergyHarvester::SetDate),
                    MakeStringChecker ())
+    .AddAttribute ("MobilityAware",
+                   "Derive Latitude, Longitude and Altitude from the position of the node MobilityModel, "
+                   "interpreted as East, North, Up meters around the Origin* attributes. By default false",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SolarEnergyHarvester::m_mobilityAware),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MobilityUpdateDistance",
+                   "The distance in m the node has to move before the location-dependent sun terms are recomputed, "
+                   "by default 100 m",
+                   DoubleValue (100),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::m_mobilityUpdateDistance),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("OriginLatitude",
+                   "The latitude of the MobilityModel coordinate system origin",
+                   DoubleValue (38.11),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::m_originLatitude),
+                   MakeDoubleChecker<double> (-90, 90))
+    .AddAttribute ("OriginLongitude",
+                   "The longitude of the MobilityModel coordinate system origin",
+                   DoubleValue (15.661),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::m_originLongitude),
+                   MakeDoubleChecker<double> (-180, 180))
+    .AddAttribute ("OriginAltitude",
+                   "The altitude from the sea level [m] of the MobilityModel coordinate system origin",
+                   DoubleValue (31),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::m_originAltitude),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("IrradianceField",
+                   "A SolarIrradianceField shared with other harvesters: if set, the harvested power is interpolated "
+                   "from its grid instead of evaluating the sun model at the harvester location. By default none",
+                   PointerValue (),
+                   MakePointerAccessor (&SolarEnergyHarvester::m_irradianceField),
+                   MakePointerChecker<SolarIrradianceField> ())
+    .AddAttribute ("CloudModel",
+                   "A SolarCloudModel, usually shared by the harvesters of the same area, whose clear-sky index "
+                   "attenuates the harvested power. By default none, i.e., clear sky",
+                   PointerValue (),
+                   MakePointerAccessor (&SolarEnergyHarvester::m_cloudModel),
+                   MakePointerChecker<SolarCloudModel> ())
+    .AddAttribute ("IrradianceDataset",
+                   "A measured irradiance dataset, converted by sun-harvester-irradiance: if set, the harvested power "
+                   "comes from its GHI, DNI and DHI transposed to the panel plane, instead of the sun model, "
+                   "and the CloudModel is ignored. By default none",
+                   StringValue (""),
+                   MakeStringAccessor (&SolarEnergyHarvester::SetIrradianceDataset),
+                   MakeStringChecker ())
+    .AddAttribute ("Albedo",
+                   "The ground reflectance, used with the IrradianceDataset. By default 0.2",
+                   DoubleValue (0.2),
+                   MakeDoubleAccessor (&SolarEnergyHarvester::m_albedo),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("PrefetchChunk",
+                   "If positive, the harvested power is read from a window of two chunks of this length, "
+                   "the next one being computed by a background thread. By default 0, i.e., disabled",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_prefetchChunk),
+                   MakeTimeChecker ())
+    .AddAttribute ("SunTrackKnotSpacing",
+                   "If positive, the sun model is evaluated only at knots this far apart, plus sunrise and sunset, "
+                   "and the power of the updates in between is interpolated with cubic Hermite splines. "
+                   "By default 0, i.e., every update evaluates the sun model",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_sunTrackKnotSpacing),
+                   MakeTimeChecker ())
+    .AddAttribute ("SharedProfileSegment",
+                   "If not empty, the prefix, starting with '/', of the POSIX shared memory segments holding the power "
+                   "of every update, one per set of harvester parameters: the first process on the host computes "
+                   "a segment, the others map it read-only. Ignored if MobilityAware, as every move would "
+                   "publish another segment. By default empty, i.e., disabled",
+                   StringValue (""),
+                   MakeStringAccessor (&SolarEnergyHarvester::m_sharedProfilePrefix),
+                   MakeStringChecker ())
+    .AddAttribute ("SharedProfileDuration",
+                   "The time covered by a shared memory profile, from StartAt; the updates beyond it evaluate "
+                   "the sun model. By default 30 days",
+                   TimeValue (Days (30)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_sharedProfileDuration),
+                   MakeTimeChecker ())
+    .AddAttribute ("SharedProfileKeep",
+                   "If true, the shared memory profile segments are kept after the last process using them "
+                   "releases them, for the following runs, until SolarSharedProfile::Remove. By default false, "
+                   "i.e., they are removed",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SolarEnergyHarvester::m_sharedProfileKeep),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ProfileReplay",
+                   "If true, the harvested power of every update is read from the energy profile shared by the "
+                   "harvesters with the same parameters, instead of evaluating the sun model. By default false",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SolarEnergyHarvester::m_profileReplay),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ProfileFormat",
+                   "The storage of the energy profile: Double (8 bytes per update, exact), Quantized16 or Quantized8 "
+                   "(2 or 1 bytes per update with power, plus a scale per block of ProfileBlockSamples updates)",
+                   EnumValue (SolarEnergyHarvester::DOUBLE_PROFILE),
+                   MakeEnumAccessor (&SolarEnergyHarvester::m_profileFormat),
+                   MakeEnumChecker (SolarEnergyHarvester::DOUBLE_PROFILE, "Double",
+                                    SolarEnergyHarvester::QUANTIZED_16_PROFILE, "Quantized16",
+                                    SolarEnergyHarvester::QUANTIZED_8_PROFILE, "Quantized8"))
+    .AddAttribute ("ProfileBlockSamples",
+                   "The number of updates sharing a scale in a quantized energy profile",
+                   UintegerValue (256),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::m_profileBlockSamples),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("PowerSegmentLength",
+                   "If positive and the energy source is a SolarPowerSegmentSink, e.g., a SolarSegmentEnergySource, "
+                   "the power is published as cubic segments of up to this length, interpolating the sun model, "
+                   "the IrradianceField or the IrradianceDataset, at four updates and ending at sunrise and sunset, "
+                   "and the source is notified once per segment. PrefetchChunk, SunTrackKnotSpacing, "
+                   "SharedProfileSegment and ProfileReplay are ignored by the segments. Other sources keep the "
+                   "periodic updates. By default 0, i.e., disabled",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_powerSegmentLength),
+                   MakeTimeChecker ())
+    .AddAttribute ("ThresholdScanStep",
+                   "The coarse step of the ScheduleOnPowerThreshold crossing scan: crossings closer than this may be missed. "
+                   "By default 10 minutes",
+                   TimeValue (Minutes (10)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_thresholdScanStep),
+                   MakeTimeChecker ())
+    .AddAttribute ("ThresholdScanHorizon",
+                   "How far ahead the ScheduleOnPowerThreshold crossing scan looks before scheduling a new scan. By default 1 day",
+                   TimeValue (Days (1)),
+                   MakeTimeAccessor (&SolarEnergyHarvester::m_thresholdScanHorizon),
+                   MakeTimeChecker ())
+    .AddAttribute ("LatencySamplingPeriod",
+                   "Measure the latency of one CalculateHarvestedPower every LatencySamplingPeriod updates, "
+                   "and add it to the latency histogram. By default 0, i.e., disabled",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::m_latencySamplingPeriod),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PsaEvaluations",
+                   "The number of sun position evaluations done by the periodic updates",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::GetPsaEvaluations),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("Updates",
+                   "The number of harvested power updates",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::GetUpdates),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("NightUpdates",
+                   "The number of harvested power updates that yielded zero power",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::GetNightUpdates),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("EnergySourceNotifications",
+                   "The number of energy source notifications",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::GetEnergySourceNotifications),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("TraceFirings",
+                   "The number of HarvestedPower and TotalEnergyHarvested trace firings",
+                   TypeId::ATTR_GET,
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&SolarEnergyHarvester::GetTraceFirings),
+                   MakeUintegerChecker<uint64_t> ())
     .AddTraceSource ("HarvestedPower",
                      "Harvested power by the EnergyHarvester.",
                      MakeTraceSourceAccessor (&SolarEnergyHarvester::m_harvestedPower),
@@ -112,14 +314,40 @@ SolarEnergyHarvester::GetTypeId (void)
                      "Total energy harvested by the solar harvester.",
                      MakeTraceSourceAccessor (&SolarEnergyHarvester::m_totalEnergyHarvestedJ),
                      "ns3::TracedValue::DoubleCallback")
+    .AddTraceSource ("PowerSegment",
+                     "The power segment notified to the energy source, at its start, when PowerSegmentLength is positive.",
+                     MakeTraceSourceAccessor (&SolarEnergyHarvester::m_powerSegmentTrace),
+                     "ns3::SolarPowerSegment::TracedCallback")
   ;
   return tid;
 
 }
 
 SolarEnergyHarvester::SolarEnergyHarvester (void)
+  : m_latitude (0),
+    m_longitude (0),
+    m_altitude (0),
+    m_sunPositionAlgorithm (Sun::PSA_ALGORITHM),
+    m_airMass (0),
+    m_profileOrigin (0),
+    m_fieldWeightsTilt (NAN),
+    m_fieldWeightsAzimuth (NAN),
+    m_fieldWeightsDiffuse (NAN),
+    m_albedo (0.2),
+    m_profileReplay (false),
+    m_profileFormat (DOUBLE_PROFILE),
+    m_profileBlockSamples (256),
+    m_segmentSink (0),
+    m_sample (0),
+    m_deferredStart (false),
+    m_started (false),
+    m_nextThresholdId (0),
+    m_latencySamplingPeriod (0),
+    m_latencySamplingCounter (0)
 {
   NS_LOG_FUNCTION (this);
+  memset (&m_counters, 0, sizeof (m_counters));
+  m_sunLocation = Sun::GetLocation (m_latitude, m_longitude);
 }
 
 SolarEnergyHarvester::~SolarEnergyHarvester (void)
@@ -139,14 +367,53 @@ void SolarEnergyHarvester::SetDate (const std::string& s)
   NS_LOG_FUNCTION (this << s);
   struct tm tm;
 
+  memset (&tm, 0, sizeof (tm));
   NS_ABORT_MSG_UNLESS (strptime (s.c_str (), "%Y-%m-%d %H:%M:%S", &tm), "Date Format (24 hours): YYYY-MM-DD hh:mm:ss");
+  tm.tm_isdst = -1;
 
-  // normalization: e.g. 29/02/2013 would become 01/03/2013
+  // normalization: e.g. 29/02/2013 would become 01/03/2013. This is the
+  // only place where the TZ settings are read: the UTC offset found here is
+  // kept by Sun::AddSeconds for all the following dates
   time_t when = mktime (&tm);
-  m_startDate = *localtime (&when);
+  localtime_r (&when, &tm);
+  SetStartDate (tm);
+}
+
+void
+SolarEnergyHarvester::SetIrradianceDataset (const std::string &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  m_irradianceDataset = 0;
+  if (!filename.empty ())
+    {
+      m_irradianceDataset = SolarIrradianceDataset::Get (filename);
+    }
+}
+
+void SolarEnergyHarvester::SetStartDate (const tm &date)
+{
+  NS_LOG_FUNCTION (this);
+  m_startDate = date;
   m_date = m_startDate;
 }
 
+void
+SolarEnergyHarvester::SetPanel (const Panel &panel)
+{
+  NS_LOG_FUNCTION (this);
+  m_latitude = panel.latitude;
+  m_longitude = panel.longitude;
+  m_altitude = panel.altitude;
+  m_solarCellEfficiency = panel.solarCellEfficiency;
+  m_DCDCefficiency = panel.dcdcEfficiency;
+  m_panelAzimuthAngle = panel.panelAzimuthAngle;
+  m_panelTiltAngle = panel.panelTiltAngle;
+  m_panelDimension = panel.panelDimension;
+  m_diffusePercentage = panel.diffusePercentage;
+  m_sunPositionAlgorithm = panel.sunPositionAlgorithm;
+  UpdateLocationTerms ();
+}
+
 void
 SolarEnergyHarvester::SetHarvestedPowerUpdateInterval (const Time harvestedPowerUpdateInterval)
 {
@@ -164,6 +431,30 @@ SolarEnergyHarvester::GetHarvestedPowerUpdateInterval (void) const
   return m_harvestedPowerUpdateInterval;
 }
 
+void
+SolarEnergyHarvester::SetLatitude (double latitude)
+{
+  NS_LOG_FUNCTION (this << latitude);
+  m_latitude = latitude;
+  UpdateLocationTerms ();
+}
+
+void
+SolarEnergyHarvester::SetLongitude (double longitude)
+{
+  NS_LOG_FUNCTION (this << longitude);
+  m_longitude = longitude;
+  UpdateLocationTerms ();
+}
+
+void
+SolarEnergyHarvester::SetAltitude (double altitude)
+{
+  NS_LOG_FUNCTION (this << altitude);
+  m_altitude = altitude;
+  UpdateLocationTerms ();
+}
+
 double
 SolarEnergyHarvester::GetDcdCefficiency (void) const
 {
@@ -234,10 +525,179 @@ SolarEnergyHarvester::GetAltitude (void) const
   return m_altitude;
 }
 
+double
+SolarEnergyHarvester::GetEnergyBetween (Time t0, Time t1)
+{
+  NS_LOG_FUNCTION (this << t0 << t1);
+  NS_ASSERT (t0 <= t1);
+
+  Ptr<SolarEnergyProfile> profile = GetProfile ();
+  Time origin = TimeStep (m_profileOrigin * m_harvestedPowerUpdateInterval.GetTimeStep ());
+  Time first = std::max (t0 - m_initializationTime, Seconds (0));
+  Time last = std::max (t1 - m_initializationTime, Seconds (0));
+  if (first < origin)
+    {
+      // before the current parameters, as if they had been used since StartAt
+      profile = SolarEnergyProfile::Get (GetPanel (), m_startDate, m_harvestedPowerUpdateInterval,
+                                         m_profileFormat, m_profileBlockSamples);
+      origin = Seconds (0);
+    }
+  return profile->GetEnergy (last - origin) - profile->GetEnergy (first - origin);
+}
+
+std::vector<double>
+SolarEnergyHarvester::GetForecast (Time horizon, Time resolution)
+{
+  NS_LOG_FUNCTION (this << horizon << resolution);
+  NS_ASSERT (resolution.IsStrictlyPositive ());
+
+  // the profile never starts after now
+  Ptr<SolarEnergyProfile> profile = GetProfile ();
+  Time origin = TimeStep (m_profileOrigin * m_harvestedPowerUpdateInterval.GetTimeStep ());
+  Time offset = std::max (Simulator::Now () - m_initializationTime, origin) - origin;
+  std::vector<double> forecast;
+  double energy = profile->GetEnergy (offset);
+  for (Time slot = Seconds (0); slot < horizon; slot += resolution)
+    {
+      double next = profile->GetEnergy (offset + std::min (slot + resolution, horizon));
+      forecast.push_back (next - energy);
+      energy = next;
+    }
+  return forecast;
+}
+
+uint32_t
+SolarEnergyHarvester::ScheduleOnPowerThreshold (double threshold, Callback<void, bool> callback)
+{
+  NS_LOG_FUNCTION (this << threshold);
+
+  uint32_t id = m_nextThresholdId++;
+  ThresholdWatch &watch = m_thresholdWatches[id];
+  watch.threshold = threshold;
+  watch.callback = callback;
+  watch.above = false;
+  if (m_started)
+    {
+      watch.above = m_harvestedPower >= threshold;
+      ScheduleThresholdCrossing (id);
+    }
+  // otherwise, Start scans it
+  return id;
+}
+
+void
+SolarEnergyHarvester::CancelPowerThreshold (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+
+  std::map<uint32_t, ThresholdWatch>::iterator i = m_thresholdWatches.find (id);
+  if (i != m_thresholdWatches.end ())
+    {
+      i->second.event.Cancel ();
+      m_thresholdWatches.erase (i);
+    }
+}
+
+void
+SolarEnergyHarvester::SetDeferredStart (bool deferred)
+{
+  NS_LOG_FUNCTION (this << deferred);
+  m_deferredStart = deferred;
+}
+
+const SolarEnergyHarvester::Counters&
+SolarEnergyHarvester::GetCounters (void) const
+{
+  return m_counters;
+}
+
+uint64_t
+SolarEnergyHarvester::GetPsaEvaluations (void) const
+{
+  return m_counters.psaEvaluations;
+}
+
+uint64_t
+SolarEnergyHarvester::GetUpdates (void) const
+{
+  return m_counters.updates;
+}
+
+uint64_t
+SolarEnergyHarvester::GetNightUpdates (void) const
+{
+  return m_counters.nightUpdates;
+}
+
+uint64_t
+SolarEnergyHarvester::GetEnergySourceNotifications (void) const
+{
+  return m_counters.sourceNotifications;
+}
+
+uint64_t
+SolarEnergyHarvester::GetTraceFirings (void) const
+{
+  return m_counters.traceFirings;
+}
+
+SolarEnergyHarvester::Counters
+SolarEnergyHarvester::GetGlobalCounters (void)
+{
+  uint64_t values[N_COUNTERS];
+  for (uint32_t i = 0; i < N_COUNTERS; ++i)
+    {
+      values[i] = HarvesterPerThreadCounters::Get (i);
+    }
+  Counters counters;
+  memcpy (&counters, values, sizeof (counters));
+  return counters;
+}
+
+void
+SolarEnergyHarvester::ResetGlobalCounters (void)
+{
+  HarvesterPerThreadCounters::Reset ();
+}
+
 /*
  * Private functions start here.
  */
 
+Ptr<SolarEnergyProfile>
+SolarEnergyHarvester::GetProfile (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // the profile follows the panel: e.g., a MobilityAware harvester that
+  // moved, or a changed attribute, gets the profile of the new parameters
+  Panel panel = GetPanel ();
+  if (m_profile == 0 || !m_profile->Matches (panel))
+    {
+      // the first profile starts at StartAt, to be shared by the harvesters
+      // with the same parameters; the next ones at the last update, so that
+      // they are not rebuilt from StartAt after every change
+      m_profileOrigin = 0;
+      if (m_profile != 0 && m_started)
+        {
+          m_profileOrigin = (Simulator::Now () - m_initializationTime).GetTimeStep ()
+            / m_harvestedPowerUpdateInterval.GetTimeStep ();
+        }
+      tm date = m_startDate;
+      Sun::AddSeconds (&date, (int64_t) m_profileOrigin * (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+      m_profile = SolarEnergyProfile::Get (panel, date, m_harvestedPowerUpdateInterval,
+                                           m_profileFormat, m_profileBlockSamples);
+    }
+  return m_profile;
+}
+
+void
+SolarEnergyHarvester::Count (uint64_t Counters::*counter)
+{
+  ++(m_counters.*counter);
+  HarvesterPerThreadCounters::Increment (&(m_counters.*counter) - reinterpret_cast<uint64_t *> (&m_counters));
+}
+
 void
 SolarEnergyHarvester::UpdateHarvestedPower (void)
 {
@@ -258,28 +718,240 @@ SolarEnergyHarvester::UpdateHarvestedPower (void)
       return;
     }
 
+  if (SUN_HARVESTER_PROBE_ENABLED (update_entry))
+    {
+      SUN_HARVESTER_PROBE2 (update_entry, GetNode ()->GetId (), Simulator::Now ().GetNanoSeconds ());
+    }
+
   m_energyHarvestingUpdateEvent.Cancel ();
 
+  double previousPower = m_harvestedPower;
+
   CalculateHarvestedPower ();
 
+  Count (&Counters::updates);
+  if (m_harvestedPower == 0)
+    {
+      Count (&Counters::nightUpdates);
+    }
+  if (m_harvestedPower != previousPower)
+    {
+      Count (&Counters::traceFirings);
+    }
+
   energyHarvested = duration.GetSeconds () * m_harvestedPower;
 
   // update total energy harvested
   m_totalEnergyHarvestedJ += energyHarvested;
+  if (energyHarvested != 0)
+    {
+      Count (&Counters::traceFirings);
+    }
 
   // notify energy source
   GetEnergySource ()->UpdateEnergySource ();
+  Count (&Counters::sourceNotifications);
 
   // update last harvesting time stamp
   m_lastHarvestingUpdateTime = Simulator::Now ();
 
-  m_date.tm_sec = m_date.tm_sec + m_harvestedPowerUpdateInterval.GetSeconds ();
-  time_t when = mktime (&m_date);
-  m_date = *localtime (&when);
+  Sun::AddSeconds (&m_date, (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+  ++m_sample;
 
   m_energyHarvestingUpdateEvent = Simulator::Schedule (m_harvestedPowerUpdateInterval,
                                                        &SolarEnergyHarvester::UpdateHarvestedPower,
                                                        this);
+
+  if (SUN_HARVESTER_PROBE_ENABLED (update_exit))
+    {
+      // power in micro Watt
+      SUN_HARVESTER_PROBE3 (update_exit, GetNode ()->GetId (), Simulator::Now ().GetNanoSeconds (),
+                            (int64_t) llround (m_harvestedPower * 1e6));
+    }
+}
+
+void
+SolarEnergyHarvester::UpdatePowerSegment (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // do not update if simulation has finished
+  if (Simulator::IsFinished ())
+    {
+      NS_LOG_DEBUG ("SolarEnergyHarvester: Simulation Finished.");
+      return;
+    }
+
+  m_energyHarvestingUpdateEvent.Cancel ();
+
+  // the energy of the segment ending now
+  double energyHarvested = m_powerSegment.GetEnergy (m_lastHarvestingUpdateTime, Simulator::Now ());
+  m_totalEnergyHarvestedJ += energyHarvested;
+  if (energyHarvested != 0)
+    {
+      Count (&Counters::traceFirings);
+    }
+
+  double previousPower = m_harvestedPower;
+  uint64_t samples = BuildPowerSegment ();
+  m_harvestedPower = m_powerSegment.GetPower (Simulator::Now ());
+  NS_LOG_DEBUG (Simulator::Now ().GetSeconds () << "s SolarEnergyHarvester: segment of " << samples
+                << " updates, from " << m_harvestedPower << " W to " << m_powerSegment.GetPower (m_powerSegment.GetEnd ()) << " W");
+
+  Count (&Counters::updates);
+  if (m_harvestedPower == 0)
+    {
+      Count (&Counters::nightUpdates);
+    }
+  if (m_harvestedPower != previousPower)
+    {
+      Count (&Counters::traceFirings);
+    }
+
+  // notify energy source
+  m_segmentSink->NotifyPowerSegment (Ptr<EnergyHarvester> (this), m_powerSegment);
+  Count (&Counters::sourceNotifications);
+  m_powerSegmentTrace (m_powerSegment);
+
+  m_lastHarvestingUpdateTime = Simulator::Now ();
+
+  Sun::AddSeconds (&m_date, (int64_t) samples * (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+  m_sample += samples;
+
+  m_energyHarvestingUpdateEvent = Simulator::Schedule (m_powerSegment.GetEnd () - Simulator::Now (),
+                                                       &SolarEnergyHarvester::UpdatePowerSegment,
+                                                       this);
+}
+
+uint64_t
+SolarEnergyHarvester::BuildPowerSegment (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  int64_t interval = std::max<int64_t> (m_harvestedPowerUpdateInterval.GetTimeStep (), 1);
+  uint64_t samples = std::max<int64_t> (m_powerSegmentLength.GetTimeStep () / interval, 1);
+
+  if (m_irradianceDataset != 0)
+    {
+      // the segment ends by the last record, past which the updates abort
+      int64_t time = Sun::GetUnixTime (&m_date);
+      NS_ABORT_MSG_IF (time > m_irradianceDataset->GetLast (),
+                       "SolarEnergyHarvester: the date is outside the IrradianceDataset");
+      int64_t seconds = std::max<int64_t> ((int64_t) m_harvestedPowerUpdateInterval.GetSeconds (), 1);
+      uint64_t left = (m_irradianceDataset->GetLast () - time) / seconds;
+      if (left == 0)
+        {
+          // the last record: its power up to the next update
+          m_powerSegment = SolarPowerSegment (now, now + TimeStep (interval), CalculateSegmentPower (0));
+          return 1;
+        }
+      samples = std::min (samples, left);
+    }
+
+  // the power is not smooth at sunrise and sunset, so the segments end there
+  uint64_t first = 0;
+  if (CalculateSegmentPower (0) == 0)
+    {
+      // night: no power up to the update before the sunrise, which starts
+      // the next segment
+      uint64_t sunrise = FindPowerTransition (1, samples, false);
+      if (sunrise >= 2)
+        {
+          samples = std::min (samples, sunrise - 1);
+          m_powerSegment = SolarPowerSegment (now, now + TimeStep (interval * samples), 0);
+          return samples;
+        }
+      first = 1;
+    }
+
+  // day: up to the sunset update, back to zero power
+  samples = std::min (samples, FindPowerTransition (first, samples, true));
+
+  // the cubic through four updates equally spaced over the segment, or
+  // fewer if the segment is shorter
+  uint64_t nodes = std::min<uint64_t> (samples, 3) + 1;
+  std::vector<double> offsets;
+  std::vector<double> power;
+  for (uint64_t i = 0; i < nodes; ++i)
+    {
+      uint64_t sample = samples * i / (nodes - 1);
+      offsets.push_back (TimeStep (interval * sample).GetSeconds ());
+      power.push_back (CalculateSegmentPower (sample));
+    }
+  m_powerSegment = SolarPowerSegment (now, now + TimeStep (interval * samples), offsets, power);
+  return samples;
+}
+
+double
+SolarEnergyHarvester::CalculateSegmentPower (uint64_t sample)
+{
+  tm date = m_date;
+  Sun::AddSeconds (&date, (int64_t) sample * (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+  if (m_irradianceDataset != 0)
+    {
+      Count (&Counters::psaEvaluations);
+      return CalculateMeasuredPower (&date);
+    }
+
+  // the approximations of the updates (PrefetchChunk, SunTrackKnotSpacing,
+  // SharedProfileSegment, ProfileReplay) are not used: the segment already
+  // interpolates the power between its nodes
+  double power;
+  if (m_irradianceField != 0)
+    {
+      // the harvesters of the field share the segment nodes: cache them
+      power = CalculateFieldPower (&date);
+    }
+  else
+    {
+      Count (&Counters::psaEvaluations);
+      power = CalculateExactPower (&date);
+    }
+  if (m_cloudModel != 0)
+    {
+      power *= m_cloudModel->GetClearSkyIndex (Simulator::Now () + TimeStep (m_harvestedPowerUpdateInterval.GetTimeStep () * sample));
+    }
+  return power;
+}
+
+uint64_t
+SolarEnergyHarvester::FindPowerTransition (uint64_t first, uint64_t last, bool zero)
+{
+  if ((CalculateSegmentPower (first) == 0) == zero)
+    {
+      return first;
+    }
+
+  // the interpolation nodes, then a bisection between the last one before
+  // the transition and the first one after it
+  uint64_t low = first;
+  for (uint64_t i = 1; i <= 3; ++i)
+    {
+      uint64_t high = first + (last - first) * i / 3;
+      if (high == low)
+        {
+          continue;
+        }
+      if ((CalculateSegmentPower (high) == 0) == zero)
+        {
+          while (high - low > 1)
+            {
+              uint64_t middle = low + (high - low) / 2;
+              if ((CalculateSegmentPower (middle) == 0) == zero)
+                {
+                  high = middle;
+                }
+              else
+                {
+                  low = middle;
+                }
+            }
+          return high;
+        }
+      low = high;
+    }
+  return last + 1;
 }
 
 void
@@ -287,8 +959,57 @@ SolarEnergyHarvester::DoInitialize (void)
 {
   NS_LOG_FUNCTION (this);
 
+  if (!m_deferredStart)
+    {
+      Start ();
+    }
+}
+
+void
+SolarEnergyHarvester::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_started)
+    {
+      return;
+    }
+
+  if (m_mobilityAware)
+    {
+      m_mobility = GetNode ()->GetObject<MobilityModel> ();
+      NS_ABORT_MSG_UNLESS (m_mobility, "SolarEnergyHarvester: MobilityAware requires a MobilityModel aggregated to the node");
+      m_mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&SolarEnergyHarvester::CourseChanged, this));
+      UpdateLocation (m_mobility->GetPosition ());
+      CourseChanged (m_mobility);
+    }
+
+  m_initializationTime = Simulator::Now ();
   m_lastHarvestingUpdateTime = Simulator::Now ();
-  UpdateHarvestedPower ();        // start periodic harvesting update
+
+  // the initial location is not a change: the thresholds are scanned below,
+  // once the first update has run
+  m_started = true;
+
+  // the sources that do not understand power segments get the periodic updates
+  if (m_powerSegmentLength.IsStrictlyPositive ())
+    {
+      m_segmentSink = dynamic_cast<SolarPowerSegmentSink *> (PeekPointer (GetEnergySource ()));
+    }
+  if (m_segmentSink != 0)
+    {
+      UpdatePowerSegment ();
+    }
+  else
+    {
+      UpdateHarvestedPower ();        // start periodic harvesting update
+    }
+
+  for (std::map<uint32_t, ThresholdWatch>::iterator i = m_thresholdWatches.begin (); i != m_thresholdWatches.end (); ++i)
+    {
+      i->second.above = m_harvestedPower >= i->second.threshold;
+      ScheduleThresholdCrossing (i->first);
+    }
 }
 
 void
@@ -296,6 +1017,123 @@ SolarEnergyHarvester::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   m_energyHarvestingUpdateEvent.Cancel ();
+  m_locationUpdateEvent.Cancel ();
+  if (m_mobility != 0)
+    {
+      m_mobility->TraceDisconnectWithoutContext ("CourseChange", MakeCallback (&SolarEnergyHarvester::CourseChanged, this));
+    }
+  m_mobility = 0;
+  m_profile = 0;
+  m_irradianceField = 0;
+  m_cloudModel = 0;
+  m_irradianceDataset = 0;
+  m_window = 0;
+  m_sunTrack = 0;
+  m_sharedProfile = 0;
+  m_segmentSink = 0;
+  for (std::map<uint32_t, ThresholdWatch>::iterator i = m_thresholdWatches.begin (); i != m_thresholdWatches.end (); ++i)
+    {
+      i->second.event.Cancel ();
+    }
+  m_thresholdWatches.clear ();
+}
+
+void
+SolarEnergyHarvester::UpdateLocationTerms (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_airMass = Sun::GetAirMass (m_latitude, m_altitude);
+  m_sunLocation = Sun::GetLocation (m_latitude, m_longitude);
+  if (m_started)
+    {
+      RescheduleThresholds ();
+    }
+}
+
+void
+SolarEnergyHarvester::UpdateLocation (const Vector &position)
+{
+  NS_LOG_FUNCTION (this << position);
+
+  // WGS84 ellipsoid
+  const double a = 6378137.0;
+  const double e2 = 6.69437999014e-3;
+  const double b = a * sqrt (1 - e2);
+  const double ep2 = (a * a - b * b) / (b * b);
+
+  double sinLat0 = sin (m_originLatitude * rad);
+  double cosLat0 = cos (m_originLatitude * rad);
+  double sinLon0 = sin (m_originLongitude * rad);
+  double cosLon0 = cos (m_originLongitude * rad);
+
+  // origin in Earth-Centered Earth-Fixed coordinates
+  double n0 = a / sqrt (1 - e2 * sinLat0 * sinLat0);
+  double x0 = (n0 + m_originAltitude) * cosLat0 * cosLon0;
+  double y0 = (n0 + m_originAltitude) * cosLat0 * sinLon0;
+  double z0 = (n0 * (1 - e2) + m_originAltitude) * sinLat0;
+
+  // East, North, Up offset rotated into ECEF
+  double x = x0 - sinLon0 * position.x - sinLat0 * cosLon0 * position.y + cosLat0 * cosLon0 * position.z;
+  double y = y0 + cosLon0 * position.x - sinLat0 * sinLon0 * position.y + cosLat0 * sinLon0 * position.z;
+  double z = z0 + cosLat0 * position.y + sinLat0 * position.z;
+
+  // ECEF to geodetic, Bowring's method
+  double p = sqrt (x * x + y * y);
+  double theta = atan2 (z * a, p * b);
+  double sinTheta = sin (theta);
+  double cosTheta = cos (theta);
+  double latitude = atan2 (z + ep2 * b * sinTheta * sinTheta * sinTheta,
+                           p - e2 * a * cosTheta * cosTheta * cosTheta);
+  double sinLat = sin (latitude);
+  double n = a / sqrt (1 - e2 * sinLat * sinLat);
+
+  m_latitude = latitude / rad;
+  m_longitude = atan2 (y, x) / rad;
+  m_altitude = p / cos (latitude) - n;
+  m_lastPosition = position;
+
+  UpdateLocationTerms ();
+
+  NS_LOG_DEBUG ("Location updated: latitude=" << m_latitude << ", longitude=" << m_longitude << ", altitude=" << m_altitude);
+}
+
+void
+SolarEnergyHarvester::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+
+  Vector position = mobility->GetPosition ();
+  double distance = CalculateDistance (position, m_lastPosition);
+  if (distance >= m_mobilityUpdateDistance)
+    {
+      UpdateLocation (position);
+      distance = 0;
+    }
+
+  // Instead of polling the position, wake up only when the node, moving
+  // straight at its current speed, reaches MobilityUpdateDistance meters
+  // from the last location update; any earlier CourseChange reschedules it.
+  m_locationUpdateEvent.Cancel ();
+  Vector velocity = mobility->GetVelocity ();
+  double speed = sqrt (velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z);
+  if (speed > 0 && m_mobilityUpdateDistance > 0)
+    {
+      // at least one time step, so that a distance left short by the
+      // rounding of the delay does not wake up again at the same time
+      Time delay = std::max (Seconds ((m_mobilityUpdateDistance - distance) / speed), TimeStep (1));
+      m_locationUpdateEvent = Simulator::Schedule (delay, &SolarEnergyHarvester::LocationUpdateDue, this, mobility);
+    }
+}
+
+void
+SolarEnergyHarvester::LocationUpdateDue (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+
+  // the delay is rounded to whole time steps, so the node may be a few
+  // nanometers short of MobilityUpdateDistance: update anyway
+  UpdateLocation (mobility->GetPosition ());
+  CourseChanged (mobility);
 }
 
 void
@@ -303,35 +1141,395 @@ SolarEnergyHarvester::CalculateHarvestedPower (void)
 {
   NS_LOG_FUNCTION (this);
 
+  if (SUN_HARVESTER_PROBE_ENABLED (calculate_entry))
+    {
+      SUN_HARVESTER_PROBE2 (calculate_entry, GetNode ()->GetId (), Simulator::Now ().GetNanoSeconds ());
+    }
+
+  if (m_latencySamplingPeriod == 0 || ++m_latencySamplingCounter < m_latencySamplingPeriod)
+    {
+      m_harvestedPower = CalculateCurrentPower ();
+    }
+  else
+    {
+      m_latencySamplingCounter = 0;
+
+      struct timespec begin;
+      struct timespec end;
+      clock_gettime (CLOCK_MONOTONIC, &begin);
+      m_harvestedPower = CalculateCurrentPower ();
+      clock_gettime (CLOCK_MONOTONIC, &end);
+
+      uint64_t latency = (end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec;
+      uint32_t bucket = 0;
+      while (bucket < 63 && (latency >> (bucket + 1)) != 0)
+        {
+          ++bucket;
+        }
+      ++m_counters.latencyHistogram[bucket];
+      HarvesterPerThreadCounters::Increment (offsetof (Counters, latencyHistogram) / sizeof (uint64_t) + bucket);
+    }
+
+  if (SUN_HARVESTER_PROBE_ENABLED (calculate_exit))
+    {
+      SUN_HARVESTER_PROBE3 (calculate_exit, GetNode ()->GetId (), Simulator::Now ().GetNanoSeconds (),
+                            (int64_t) llround (m_harvestedPower * 1e6));
+    }
+
+  NS_LOG_DEBUG (Simulator::Now ().GetSeconds () << "s SolarEnergyHarvester:Harvested energy = " << m_harvestedPower);
+
+}
+
+double
+SolarEnergyHarvester::CalculateCurrentPower (void)
+{
+  if (m_irradianceDataset != 0)
+    {
+      // the measured irradiance has its own clouds
+      Count (&Counters::psaEvaluations);
+      return CalculateMeasuredPower (&m_date);
+    }
+
+  double power;
+  if (m_irradianceField != 0)
+    {
+      power = CalculateFieldPower (&m_date);
+    }
+  else if (m_prefetchChunk.IsStrictlyPositive ())
+    {
+      power = CalculatePrefetchedPower ();
+    }
+  else if (m_sunTrackKnotSpacing.IsStrictlyPositive ())
+    {
+      power = CalculateTrackPower ();
+    }
+  else if (!m_sharedProfilePrefix.empty () && !m_mobilityAware)
+    {
+      power = CalculateSharedPower ();
+    }
+  else if (m_profileReplay)
+    {
+      Ptr<SolarEnergyProfile> profile = GetProfile ();
+      power = profile->GetPower (m_sample - m_profileOrigin);
+    }
+  else
+    {
+      Count (&Counters::psaEvaluations);
+      power = CalculateExactPower (&m_date);
+    }
+
+  if (m_cloudModel != 0)
+    {
+      power *= m_cloudModel->GetClearSkyIndex (Simulator::Now ());
+    }
+  return power;
+}
+
+double
+SolarEnergyHarvester::CalculateExactPower (const tm *date)
+{
+  if (m_sunPositionAlgorithm != Sun::PSA_ALGORITHM)
+    {
+      return CalculateHarvestedPower (date);
+    }
+
+  // the same result of CalculateHarvestedPower, but only the per-location
+  // stage of PSA is evaluated by every harvester
+  Sun::Coordinates coordinates;
+  Sun::PSA (Sun::GetSharedCelestialState (date), m_sunLocation, &coordinates);
+  double insolation = GetPanelInsolation (coordinates, m_airMass, m_panelTiltAngle, m_panelAzimuthAngle, m_diffusePercentage);
+  return insolation * (m_solarCellEfficiency / 100) * (m_DCDCefficiency / 100) * m_panelDimension;
+}
+
+double
+SolarEnergyHarvester::CalculateMeasuredPower (const tm *date)
+{
+  SolarIrradianceDataset::Record record;
+  NS_ABORT_MSG_UNLESS (m_irradianceDataset->GetIrradiance (Sun::GetUnixTime (date), record),
+                       "SolarEnergyHarvester: the date is outside the IrradianceDataset");
+
+  // the data are time stamped in UTC, while DecimalHours reads the dates
+  // one hour ahead: the transposition needs the sun of the time stamp
+  tm sunDate = *date;
+  Sun::AddSeconds (&sunDate, -SECONDS_IN_HOUR);
+  Sun::Coordinates coordinates;
+  if (m_sunPositionAlgorithm == Sun::PSA_ALGORITHM)
+    {
+      Sun::PSA (Sun::GetSharedCelestialState (&sunDate), m_sunLocation, &coordinates);
+    }
+  else
+    {
+      Sun::GetPosition (m_sunPositionAlgorithm, &sunDate, m_latitude, m_longitude, &coordinates);
+    }
+
+  double irradiance = SolarIrradianceDataset::GetPlaneOfArrayIrradiance (record, coordinates, m_panelTiltAngle,
+                                                                         m_panelAzimuthAngle, m_albedo);
+  return irradiance * (m_solarCellEfficiency / 100) * (m_DCDCefficiency / 100) * m_panelDimension;
+}
+
+double
+SolarEnergyHarvester::CalculatePrefetchedPower (void)
+{
+  // the window follows the panel, as the energy profile
+  Panel panel = GetPanel ();
+  if (m_window == 0 || !m_window->Matches (panel))
+    {
+      uint64_t chunkSamples = std::max<int64_t> (1, m_prefetchChunk.GetTimeStep () / m_harvestedPowerUpdateInterval.GetTimeStep ());
+      m_window = SolarPowerWindow::Get (panel, m_startDate, m_harvestedPowerUpdateInterval, chunkSamples);
+    }
+
+  double power;
+  if (!m_window->GetPower (m_sample, power))
+    {
+      Count (&Counters::prefetchFallbacks);
+      Count (&Counters::psaEvaluations);
+      power = CalculateHarvestedPower (&m_date);
+    }
+  return power;
+}
+
+double
+SolarEnergyHarvester::CalculateTrackPower (void)
+{
+  // the track follows the panel, as the energy profile
+  Panel panel = GetPanel ();
+  int64_t knotSpacing = std::max<int64_t> (1, m_sunTrackKnotSpacing.GetSeconds ());
+  if (m_sunTrack == 0 || !m_sunTrack->Matches (panel, knotSpacing))
+    {
+      m_sunTrack = Create<SolarSunTrack> (panel, m_startDate, knotSpacing);
+    }
+  // the same offset of m_date from the starting date
+  return m_sunTrack->GetPower ((double) m_sample * (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+}
+
+double
+SolarEnergyHarvester::CalculateSharedPower (void)
+{
+  // the shared profile follows the panel, as the energy profile
+  Panel panel = GetPanel ();
+  if (m_sharedProfile == 0 || !m_sharedProfile->Matches (panel))
+    {
+      uint64_t samples = std::max<int64_t> (1, m_sharedProfileDuration.GetTimeStep () / m_harvestedPowerUpdateInterval.GetTimeStep ());
+      m_sharedProfile = SolarSharedProfile::Get (m_sharedProfilePrefix, panel, m_startDate, m_harvestedPowerUpdateInterval, samples,
+                                                 m_sharedProfileKeep);
+    }
+
+  double power;
+  if (!m_sharedProfile->GetPower (m_sample, power))
+    {
+      Count (&Counters::psaEvaluations);
+      power = CalculateExactPower (&m_date);
+    }
+  return power;
+}
+
+double
+SolarEnergyHarvester::CalculateFieldPower (const tm *date, bool lookAhead)
+{
+  if (m_panelTiltAngle != m_fieldWeightsTilt || m_panelAzimuthAngle != m_fieldWeightsAzimuth
+      || m_diffusePercentage != m_fieldWeightsDiffuse)
+    {
+      m_fieldWeights = SolarIrradianceField::GetPanelWeights (m_panelTiltAngle, m_panelAzimuthAngle, m_diffusePercentage);
+      m_fieldWeightsTilt = m_panelTiltAngle;
+      m_fieldWeightsAzimuth = m_panelAzimuthAngle;
+      m_fieldWeightsDiffuse = m_diffusePercentage;
+    }
+
+  double insolation = m_irradianceField->GetPanelInsolation (date, m_latitude, m_longitude, m_fieldWeights, lookAhead);
+  return insolation * (m_solarCellEfficiency / 100) * (m_DCDCefficiency / 100) * m_panelDimension;
+}
+
+double
+SolarEnergyHarvester::CalculateHarvestedPower (const tm *date) const
+{
+  NS_LOG_FUNCTION (this);
+  return CalculateHarvestedPower (date, GetPanel ());
+}
+
+double
+SolarEnergyHarvester::CalculateHarvestedPower (const tm *date, const Panel &panel)
+{
   Sun::Coordinates coordinates;
-  Sun::PSA (&m_date, m_latitude, m_longitude, &coordinates);
+  Sun::GetPosition (panel.sunPositionAlgorithm, date, panel.latitude, panel.longitude, &coordinates);
 
   NS_LOG_DEBUG ("Zenith Angle =" << coordinates.dZenithAngle);
   NS_LOG_DEBUG ("Elevation Angle =" << coordinates.dElevationAngle);
 
-  if (coordinates.dElevationAngle > 0)
+  double insolation = GetPanelInsolation (coordinates, panel.airMass, panel.panelTiltAngle, panel.panelAzimuthAngle, panel.diffusePercentage);
+
+  return insolation * (panel.solarCellEfficiency / 100) * (panel.dcdcEfficiency / 100) * panel.panelDimension;
+}
+
+double
+SolarEnergyHarvester::GetSamplePower (uint64_t sample)
+{
+  // the same dates and times UpdateHarvestedPower steps through
+  tm date = m_startDate;
+  Sun::AddSeconds (&date, (int64_t) sample * (int64_t) m_harvestedPowerUpdateInterval.GetSeconds ());
+  if (m_irradianceDataset != 0)
     {
-      double incidentInsolation = 2 * Sun::GetIncidentInsolation (&m_date, m_latitude, m_longitude, m_altitude);
+      // no power outside the series, where the updates abort
+      int64_t time = Sun::GetUnixTime (&date);
+      if (time < m_irradianceDataset->GetStart () || time > m_irradianceDataset->GetLast ())
+        {
+          return 0;
+        }
+      return CalculateMeasuredPower (&date);
+    }
+
+  double power = m_irradianceField != 0 ? CalculateFieldPower (&date, true) : CalculateExactPower (&date);
+  if (m_cloudModel != 0)
+    {
+      power *= m_cloudModel->GetClearSkyIndex (m_initializationTime + TimeStep (m_harvestedPowerUpdateInterval.GetTimeStep () * sample));
+    }
+  return power;
+}
+
+void
+SolarEnergyHarvester::ScheduleThresholdCrossing (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
 
-      double directInsolation = incidentInsolation * (cos (coordinates.dElevationAngle * rad) * sin (m_panelTiltAngle * rad) * cos ((m_panelAzimuthAngle - coordinates.dZenithAngle) * rad) + sin (coordinates.dElevationAngle * rad) * cos (m_panelTiltAngle * rad));
+  ThresholdWatch &watch = m_thresholdWatches[id];
+  watch.event.Cancel ();
 
-      double insolation = ((double)m_diffusePercentage / 100) * incidentInsolation + directInsolation;
+  uint64_t interval = std::max<int64_t> (m_harvestedPowerUpdateInterval.GetTimeStep (), 1);
+  uint64_t step = std::max<uint64_t> (m_thresholdScanStep.GetTimeStep () / interval, 1);
+  uint64_t horizon = std::max<uint64_t> (m_thresholdScanHorizon.GetTimeStep () / interval, step);
 
-      m_harvestedPower = insolation * (m_solarCellEfficiency / 100) * (m_DCDCefficiency / 100) * m_panelDimension;
+  // m_sample - 1 is the current update, on the watch.above side by
+  // definition, unless a power segment runs ahead of it
+  uint64_t current = std::min<uint64_t> (m_sample - 1, (Simulator::Now () - m_initializationTime).GetTimeStep () / interval);
+  uint64_t end = current + horizon;
+  uint64_t next = end; // if not crossed, scan again from there
+  uint64_t low = current;
+  while (low < end)
+    {
+      uint64_t high = std::min (low + step, end);
+      if ((GetSamplePower (high) >= watch.threshold) != watch.above)
+        {
+          // the first crossing update is in (low, high]
+          while (high - low > 1)
+            {
+              uint64_t middle = low + (high - low) / 2;
+              if ((GetSamplePower (middle) >= watch.threshold) != watch.above)
+                {
+                  high = middle;
+                }
+              else
+                {
+                  low = middle;
+                }
+            }
+          next = high;
+          break;
+        }
+      low = high;
     }
-  else
+  NS_LOG_DEBUG ("Threshold " << watch.threshold << ": next check at update " << next);
+
+  Time when = m_initializationTime + TimeStep (interval * next);
+  watch.event = Simulator::Schedule (std::max (when - Simulator::Now (), Seconds (0)),
+                                     &SolarEnergyHarvester::ThresholdCrossed, this, id, next);
+}
+
+void
+SolarEnergyHarvester::ThresholdCrossed (uint32_t id, uint64_t sample)
+{
+  NS_LOG_FUNCTION (this << id << sample);
+
+  std::map<uint32_t, ThresholdWatch>::iterator i = m_thresholdWatches.find (id);
+  NS_ASSERT (i != m_thresholdWatches.end ());
+  if (m_sample <= sample)
     {
-      m_harvestedPower = 0;
+      // the update of this sample, at this same time, has not run yet
+      i->second.event = Simulator::ScheduleNow (&SolarEnergyHarvester::ThresholdCrossed, this, id, sample);
+      return;
     }
 
-  NS_LOG_DEBUG (Simulator::Now ().GetSeconds () << "s SolarEnergyHarvester:Harvested energy = " << m_harvestedPower);
+  bool above = GetSamplePower (sample) >= i->second.threshold;
+  if (above != i->second.above)
+    {
+      i->second.above = above;
+      Callback<void, bool> callback = i->second.callback;
+      callback (above);
+      // the callback may have cancelled the watch
+      if (m_thresholdWatches.find (id) == m_thresholdWatches.end ())
+        {
+          return;
+        }
+    }
+  ScheduleThresholdCrossing (id);
+}
 
+void
+SolarEnergyHarvester::RescheduleThresholds (void)
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<uint32_t, ThresholdWatch>::iterator i = m_thresholdWatches.begin (); i != m_thresholdWatches.end (); ++i)
+    {
+      ScheduleThresholdCrossing (i->first);
+    }
+}
+
+SolarEnergyHarvester::Panel
+SolarEnergyHarvester::GetPanel (void) const
+{
+  Panel panel;
+  panel.latitude = m_latitude;
+  panel.longitude = m_longitude;
+  panel.altitude = m_altitude;
+  panel.airMass = m_airMass;
+  panel.solarCellEfficiency = m_solarCellEfficiency;
+  panel.dcdcEfficiency = m_DCDCefficiency;
+  panel.panelAzimuthAngle = m_panelAzimuthAngle;
+  panel.panelTiltAngle = m_panelTiltAngle;
+  panel.panelDimension = m_panelDimension;
+  panel.diffusePercentage = m_diffusePercentage;
+  panel.sunPositionAlgorithm = m_sunPositionAlgorithm;
+  return panel;
+}
+
+bool
+SolarEnergyHarvester::Panel::operator== (const Panel &other) const
+{
+  return latitude == other.latitude
+         && longitude == other.longitude
+         && altitude == other.altitude
+         && airMass == other.airMass
+         && solarCellEfficiency == other.solarCellEfficiency
+         && dcdcEfficiency == other.dcdcEfficiency
+         && panelAzimuthAngle == other.panelAzimuthAngle
+         && panelTiltAngle == other.panelTiltAngle
+         && panelDimension == other.panelDimension
+         && diffusePercentage == other.diffusePercentage
+         && sunPositionAlgorithm == other.sunPositionAlgorithm;
+}
+
+double
+SolarEnergyHarvester::GetPanelInsolation (const Sun::Coordinates &coordinates, double airMass,
+                                          double panelTiltAngle, double panelAzimuthAngle, double diffusePercentage)
+{
+  if (coordinates.dElevationAngle > 0)
+    {
+      double incidentInsolation = 2 * Sun::GetIncidentInsolation (coordinates, airMass);
+
+      double directInsolation = incidentInsolation * (cos (coordinates.dElevationAngle * rad) * sin (panelTiltAngle * rad) * cos ((panelAzimuthAngle - coordinates.dZenithAngle) * rad) + sin (coordinates.dElevationAngle * rad) * cos (panelTiltAngle * rad));
+
+      return ((double)diffusePercentage / 100) * incidentInsolation + directInsolation;
+    }
+
+  return 0;
 }
 
 double
 SolarEnergyHarvester::DoGetPower (void) const
 {
   NS_LOG_FUNCTION (this);
+  if (m_segmentSink != 0)
+    {
+      return m_powerSegment.GetPower (Simulator::Now ());
+    }
   return m_harvestedPower;
 }
 
@@ -23,6 +23,10 @@
 #define SUN_HARVESTER_H
 
 #include "ns3/sun.h"
+#include "ns3/solar-irradiance-field.h"
+#include "ns3/solar-cloud-model.h"
+#include "ns3/solar-irradiance-dataset.h"
+#include "ns3/solar-power-segment.h"
 #include "ns3/log.h"
 #include "ns3/assert.h"
 #include "ns3/pointer.h"
@@ -32,12 +36,24 @@
 #include "ns3/simulator.h"
 #include "ns3/energy-harvester.h"
 #include "ns3/traced-value.h"
+#include "ns3/traced-callback.h"
 #include "ns3/nstime.h"
 #include "ns3/event-id.h"
 #include "ns3/device-energy-model.h"
+#include "ns3/mobility-model.h"
+#include "ns3/vector.h"
+#include "ns3/callback.h"
+
+#include <map>
+#include <vector>
 
 namespace ns3 {
 
+class SolarEnergyProfile;
+class SolarPowerWindow;
+class SolarSharedProfile;
+class SolarSunTrack;
+
 /**
  * \ingroup SolarEnergyHarvester
  *
@@ -47,11 +63,61 @@ namespace ns3 {
  * Unit of power is chosen as Watt since energy models typically calculate
  * energy as (time in seconds * power in Watt).
  *
+ * When the MobilityAware attribute is set, the harvester location is derived
+ * from the position of the node MobilityModel, interpreted as local East,
+ * North, Up coordinates (in meters) around the configured origin.
  */
 
 class SolarEnergyHarvester : public EnergyHarvester
 {
 public:
+  /**
+   * Hot-path counters, kept both per harvester and globally (all the
+   * harvesters of the program). They are all uint64_t, in this order, to
+   * be kept per thread.
+   */
+  struct Counters
+  {
+    uint64_t psaEvaluations; //!< Sun position evaluations of the periodic updates
+    uint64_t updates; //!< Harvested power updates
+    uint64_t nightUpdates; //!< Updates that yielded zero power
+    uint64_t sourceNotifications; //!< Energy source notifications
+    uint64_t traceFirings; //!< HarvestedPower and TotalEnergyHarvested trace firings
+    uint64_t prefetchFallbacks; //!< Updates computed synchronously because the prefetched chunk was not ready
+    uint64_t latencyHistogram[64]; //!< Sampled CalculateHarvestedPower latencies: bucket i counts [2^i, 2^(i+1)) ns
+  };
+
+  /**
+   * The site and panel parameters, i.e., everything the harvested power
+   * depends on besides the date.
+   */
+  struct Panel
+  {
+    double latitude;
+    double longitude;
+    double altitude;
+    double airMass; //!< Sun::GetAirMass (latitude, altitude)
+    double solarCellEfficiency;
+    double dcdcEfficiency;
+    double panelAzimuthAngle;
+    double panelTiltAngle;
+    double panelDimension;
+    double diffusePercentage;
+    Sun::PositionAlgorithm sunPositionAlgorithm;
+
+    bool operator== (const Panel &other) const;
+  };
+
+  /**
+   * The storage of the energy profiles, see SolarEnergyProfile
+   */
+  enum ProfileFormat
+  {
+    DOUBLE_PROFILE, //!< The cumulative energy of every update, in double precision
+    QUANTIZED_16_PROFILE, //!< The power of every update in 16 bits, with a scale per block
+    QUANTIZED_8_PROFILE //!< The power of every update in 8 bits, with a scale per block
+  };
+
   static TypeId GetTypeId (void);
 
   SolarEnergyHarvester (void);
@@ -59,7 +125,35 @@ public:
   virtual ~SolarEnergyHarvester (void);
 
   void SetDate (const std::string& s);
+
+  /**
+   * Take the irradiance from a measured dataset, instead of the sun model.
+   *
+   * \param filename a dataset written by utils/sun-harvester-irradiance,
+   * shared with the other harvesters reading it; empty to use the sun model
+   */
+  void SetIrradianceDataset (const std::string &filename);
+
+  /**
+   * Same as SetDate, with an already parsed date.
+   *
+   * \param date the starting date, in local time, already normalized
+   * (e.g., as returned by localtime_r)
+   */
+  void SetStartDate (const tm &date);
+
+  /**
+   * Set all the site and panel parameters at once, without going through
+   * the attribute system. The Air Mass factor is recomputed, panel.airMass
+   * is ignored.
+   *
+   * \param panel the site and panel parameters
+   */
+  void SetPanel (const Panel &panel);
   void SetHarvestedPowerUpdateInterval (const Time harvestedPowerUpdateInterval);
+  void SetLatitude (double latitude);
+  void SetLongitude (double longitude);
+  void SetAltitude (double altitude);
 
   const tm GetDate (void) const;
 
@@ -75,6 +169,119 @@ public:
   double GetPanelDimension (void) const;
   double GetPanelTiltAngle (void) const;
 
+  /**
+   * The insolation reaching a tilted panel, i.e., the model used by the
+   * harvester without the panel efficiencies and dimension. It needs no
+   * simulator, so it can be reused by standalone tools.
+   *
+   * \param coordinates the sun position returned by Sun::PSA
+   * \param airMass the Air Mass factor returned by Sun::GetAirMass
+   * \param panelTiltAngle the panel tilt angle in degrees
+   * \param panelAzimuthAngle the panel azimuth angle in degrees
+   * \param diffusePercentage the diffuse energy percentage
+   * \return the insolation on the panel plane in [W/m^2]
+   */
+  static double GetPanelInsolation (const Sun::Coordinates &coordinates, double airMass,
+                                    double panelTiltAngle, double panelAzimuthAngle, double diffusePercentage);
+
+  /**
+   * \param date the date, in the same format returned by GetDate
+   * \return the power harvested at date by this harvester, in Watt
+   */
+  double CalculateHarvestedPower (const tm *date) const;
+
+  /**
+   * \param date the date, in the same format returned by GetDate
+   * \param panel the site and panel parameters
+   * \return the power harvested at date by a harvester configured as panel, in Watt
+   */
+  static double CalculateHarvestedPower (const tm *date, const Panel &panel);
+
+  /**
+   * \return the current site and panel parameters of this harvester
+   */
+  Panel GetPanel (void) const;
+
+  /**
+   * The energy that this harvester provides to its energy source between two
+   * simulation times, given the current site and panel parameters.
+   * The answer comes from a cumulative energy profile, built lazily and
+   * shared by all the harvesters with the same parameters, so that repeated
+   * queries cost O(1). After a parameter change, e.g., a move, the profile
+   * restarts at the last update; only the intervals starting before it
+   * need a profile from StartAt.
+   *
+   * The profile is the clear-sky forecast of the sun model: the CloudModel,
+   * the IrradianceField and the IrradianceDataset are not applied, so with
+   * any of them the answer is the energy the panel would harvest under a
+   * clear sky, not the energy the updates provide.
+   *
+   * \param t0 the beginning of the interval
+   * \param t1 the end of the interval
+   * \return the harvested energy in Joule
+   */
+  double GetEnergyBetween (Time t0, Time t1);
+
+  /**
+   * The clear-sky forecast of the next slots, from the same profile of
+   * GetEnergyBetween.
+   *
+   * \param horizon the forecast length, starting from now
+   * \param resolution the length of every forecast slot
+   * \return the energy, in Joule, harvested in each slot; the last one may be shorter
+   */
+  std::vector<double> GetForecast (Time horizon, Time resolution);
+
+  /**
+   * Call callback every time the harvested power crosses threshold, without
+   * inspecting every update. The crossings are found ahead of time on the
+   * power of the current panel, from the IrradianceField or the sun model
+   * and the CloudModel as the updates (the faster paths are replaced by the
+   * sun model they approximate): a scan every ThresholdScanStep, refined by
+   * bisection to the update where the power crosses. One event is scheduled per crossing, right after
+   * that update; if no crossing is found within ThresholdScanHorizon, the
+   * scan resumes from there.
+   *
+   * \param threshold the power threshold, in Watt
+   * \param callback called with true when the power rises to threshold or
+   * above, with false when it falls below it
+   * \return the id to pass to CancelPowerThreshold
+   */
+  uint32_t ScheduleOnPowerThreshold (double threshold, Callback<void, bool> callback);
+
+  /**
+   * \param id the id returned by ScheduleOnPowerThreshold
+   */
+  void CancelPowerThreshold (uint32_t id);
+
+  /**
+   * Start the periodic harvested power updates. It is called by DoInitialize,
+   * unless the start is deferred.
+   */
+  void Start (void);
+
+  /**
+   * \param deferred if true, DoInitialize does not start the periodic
+   * updates and Start has to be called explicitly, e.g., by
+   * SolarEnergyHarvesterHelper::BulkInstall, which starts all its harvesters
+   * from a single event
+   */
+  void SetDeferredStart (bool deferred);
+
+  const Counters& GetCounters (void) const;
+  uint64_t GetPsaEvaluations (void) const;
+  uint64_t GetUpdates (void) const;
+  uint64_t GetNightUpdates (void) const;
+  uint64_t GetEnergySourceNotifications (void) const;
+  uint64_t GetTraceFirings (void) const;
+
+  /**
+   * \return the counters summed over all the harvesters of the program,
+   * kept per thread so that concurrent simulations do not contend for them
+   */
+  static Counters GetGlobalCounters (void);
+  static void ResetGlobalCounters (void);
+
 
 private:
   /// Defined in ns3::Object
@@ -97,6 +304,155 @@ private:
    */
   void UpdateHarvestedPower (void);
 
+  /**
+   * Called at the end of every power segment, instead of
+   * UpdateHarvestedPower, when the energy source is a
+   * SolarPowerSegmentSink: build the next segment and notify the source.
+   */
+  void UpdatePowerSegment (void);
+
+  /**
+   * \return the number of updates covered by m_powerSegment, rebuilt from
+   * the current update
+   */
+  uint64_t BuildPowerSegment (void);
+
+  /**
+   * \param sample an update, relative to the current one
+   * \return the power harvested at that update, from the measured dataset
+   * if set, otherwise from the irradiance field, or the exact sun model,
+   * attenuated by the CloudModel; the other power sources of the updates
+   * are not used
+   */
+  double CalculateSegmentPower (uint64_t sample);
+
+  /**
+   * \param first an update, relative to the current one
+   * \param last a later update
+   * \param zero look for a zero power update, or for a non-zero one
+   * \return the first update in [first, last] with zero, or non-zero, power,
+   * assuming a single transition, or last + 1 if none
+   */
+  uint64_t FindPowerTransition (uint64_t first, uint64_t last, bool zero);
+
+  /**
+   * Recompute the sun terms that only depend on the harvester location.
+   */
+  void UpdateLocationTerms (void);
+
+  /**
+   * Convert a local ENU position, relative to the configured origin, into
+   * geodetic coordinates and update the harvester location accordingly.
+   *
+   * \param position the node position in meters
+   */
+  void UpdateLocation (const Vector &position);
+
+  /**
+   * Called on every CourseChange of the node MobilityModel.
+   *
+   * \param mobility the node MobilityModel
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  /**
+   * Called when the node is expected to have travelled
+   * MobilityUpdateDistance meters since the last location update.
+   *
+   * \param mobility the node MobilityModel
+   */
+  void LocationUpdateDue (Ptr<const MobilityModel> mobility);
+
+  /**
+   * \return the power harvested at m_date, from the measured dataset if
+   * set, otherwise from the IrradianceField, the prefetched window, the sun
+   * track, the shared memory profile or the energy profile if set,
+   * attenuated by the CloudModel if set
+   */
+  double CalculateCurrentPower (void);
+
+  /**
+   * \return the power harvested at date from the sun model, sharing the
+   * time-only stage of PSA with the other harvesters at the same date
+   */
+  double CalculateExactPower (const tm *date);
+
+  /**
+   * \return the power harvested at date, from the irradiance of the
+   * measured dataset transposed to the panel plane
+   */
+  double CalculateMeasuredPower (const tm *date);
+
+  /**
+   * \param date the date
+   * \param lookAhead true for a date ahead of the updates, which must not
+   * evict the cached grids of the field (see SolarIrradianceField::Sample)
+   * \return the power harvested at date, interpolated from the IrradianceField
+   */
+  double CalculateFieldPower (const tm *date, bool lookAhead = false);
+
+  /**
+   * \return the power harvested at m_date, read from the prefetched window
+   */
+  double CalculatePrefetchedPower (void);
+
+  /**
+   * \return the power harvested at m_date, interpolated from the sun track
+   */
+  double CalculateTrackPower (void);
+
+  /**
+   * \return the power harvested at m_date, read from the shared memory
+   * profile, or computed beyond its end
+   */
+  double CalculateSharedPower (void);
+
+  /**
+   * A ScheduleOnPowerThreshold registration.
+   */
+  struct ThresholdWatch
+  {
+    double threshold;
+    Callback<void, bool> callback;
+    bool above; //!< The power was at or above threshold at the last crossing
+    EventId event; //!< The next crossing, or the next scan
+  };
+
+  /**
+   * \param sample the index of an update
+   * \return the power of the update sample, from the IrradianceDataset if
+   * set, otherwise from the IrradianceField or the sun model, attenuated by
+   * the CloudModel if set
+   */
+  double GetSamplePower (uint64_t sample);
+
+  /**
+   * Find the next crossing of a watch, from the current update on, and
+   * schedule it.
+   */
+  void ScheduleThresholdCrossing (uint32_t id);
+
+  /**
+   * Notify the crossing of a watch at update sample, if still there with
+   * the current panel, and schedule the next one.
+   */
+  void ThresholdCrossed (uint32_t id, uint64_t sample);
+
+  /**
+   * Scan again all the watches, e.g., because the panel moved.
+   */
+  void RescheduleThresholds (void);
+
+  /**
+   * \return the energy profile of the current site and panel parameters
+   */
+  Ptr<SolarEnergyProfile> GetProfile (void);
+
+  /**
+   * Increment a counter of this harvester and the global one.
+   */
+  void Count (uint64_t Counters::*counter);
+
 private:
   /** Input Parameter */
   double m_latitude;
@@ -109,6 +465,13 @@ private:
   double m_panelDimension; // <- The panel Dimension in m.
   double m_harvestablePower; // <- This is the harvestable power from the sun.
   double m_diffusePercentage; // <- The diffused energy percentage
+  Sun::PositionAlgorithm m_sunPositionAlgorithm; // <- The sun position algorithm
+
+  bool m_mobilityAware; // <- Derive the location from the node MobilityModel
+  double m_mobilityUpdateDistance; // <- Distance in m that triggers a location update
+  double m_originLatitude; // <- Latitude of the ENU origin
+  double m_originLongitude; // <- Longitude of the ENU origin
+  double m_originAltitude; // <- Altitude of the ENU origin, in m
 
   tm m_startDate;
   tm m_date;
@@ -116,11 +479,54 @@ private:
   /** Traced Parameter */
   TracedValue<double> m_harvestedPower; // <-The current harvested power, in Watt
   TracedValue<double> m_totalEnergyHarvestedJ; //<- the total harvested energy, in Joule
+  TracedCallback<const SolarPowerSegment &> m_powerSegmentTrace; // <- The power segments, at their start
 
   /** Internal Parameter */
   EventId m_energyHarvestingUpdateEvent; // <- Energy harvesting event
   Time m_lastHarvestingUpdateTime; // <- This is last harvesting time
   Time m_harvestedPowerUpdateInterval; // <- This is  the harvestable energy update interval
+  double m_airMass; // <- The Air Mass factor at the current location
+  Sun::Location m_sunLocation; // <- The PSA location terms of the current location
+  Ptr<MobilityModel> m_mobility; // <- The node MobilityModel, if MobilityAware
+  Vector m_lastPosition; // <- The position used for the last location update
+  EventId m_locationUpdateEvent; // <- Event expected to move the node MobilityUpdateDistance meters away
+  Time m_initializationTime; // <- The simulation time of the first harvesting update
+  Ptr<SolarEnergyProfile> m_profile; // <- The energy profile of the current panel, if built
+  uint64_t m_profileOrigin; // <- The update m_profile starts at
+  Ptr<SolarIrradianceField> m_irradianceField; // <- The shared irradiance grid, if any
+  SolarIrradianceField::PanelWeights m_fieldWeights; // <- The field weights of the panel orientation
+  double m_fieldWeightsTilt; // <- The tilt angle m_fieldWeights were computed for
+  double m_fieldWeightsAzimuth; // <- The azimuth angle m_fieldWeights were computed for
+  double m_fieldWeightsDiffuse; // <- The diffuse percentage m_fieldWeights were computed for
+  Ptr<SolarCloudModel> m_cloudModel; // <- The clear-sky index of the area, if any
+  Ptr<SolarIrradianceDataset> m_irradianceDataset; // <- The measured irradiance of the station, if any
+  double m_albedo; // <- The ground reflectance, for the measured irradiance
+  Time m_prefetchChunk; // <- The length of the prefetched chunks, 0 disables prefetching
+  Ptr<SolarPowerWindow> m_window; // <- The prefetched power, if enabled
+  Time m_sunTrackKnotSpacing; // <- The spacing of the sun track knots, 0 disables the interpolation
+  Ptr<SolarSunTrack> m_sunTrack; // <- The interpolated sun track, if enabled
+  bool m_profileReplay; // <- The updates read the power from the energy profile
+  ProfileFormat m_profileFormat; // <- The storage of the energy profile
+  uint32_t m_profileBlockSamples; // <- The updates sharing a scale in a quantized energy profile
+  std::string m_sharedProfilePrefix; // <- The shared memory profile segment prefix, empty disables them
+  Time m_sharedProfileDuration; // <- The updates held by a shared memory profile
+  bool m_sharedProfileKeep; // <- The shared memory profile segments outlive their last process
+  Ptr<SolarSharedProfile> m_sharedProfile; // <- The shared memory profile of the current panel, if enabled
+  Time m_powerSegmentLength; // <- The maximum length of the power segments, 0 disables them
+  SolarPowerSegmentSink *m_segmentSink; // <- The energy source, if it accepts power segments
+  SolarPowerSegment m_powerSegment; // <- The current power segment
+  uint64_t m_sample; // <- The index of the current update, 0 being the first one
+  bool m_deferredStart; // <- Start is not called by DoInitialize
+  bool m_started; // <- The periodic updates are running
+  std::map<uint32_t, ThresholdWatch> m_thresholdWatches; // <- The ScheduleOnPowerThreshold registrations, by id
+  uint32_t m_nextThresholdId; // <- The id of the next registration
+  Time m_thresholdScanStep; // <- The coarse step of the threshold crossing scan
+  Time m_thresholdScanHorizon; // <- How far a threshold crossing scan looks ahead
+
+  /** Instrumentation */
+  Counters m_counters; // <- The counters of this harvester
+  uint32_t m_latencySamplingPeriod; // <- Sample one CalculateHarvestedPower latency every m_latencySamplingPeriod, 0 disables
+  uint32_t m_latencySamplingCounter; // <- Updates since the last latency sample
 };  //end class
 
 /**
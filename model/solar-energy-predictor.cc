@@ -0,0 +1,251 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-energy-predictor.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarEnergyPredictor");
+
+NS_OBJECT_ENSURE_REGISTERED (SolarEnergyPredictor);
+
+TypeId
+SolarEnergyPredictor::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SolarEnergyPredictor")
+    .SetParent<Object> ()
+    .AddConstructor<SolarEnergyPredictor> ()
+    .AddAttribute ("Algorithm",
+                   "The prediction algorithm, by default WCMA",
+                   EnumValue (SolarEnergyPredictor::WCMA),
+                   MakeEnumAccessor (&SolarEnergyPredictor::m_algorithm),
+                   MakeEnumChecker (SolarEnergyPredictor::EWMA, "EWMA",
+                                    SolarEnergyPredictor::WCMA, "WCMA"))
+    .AddAttribute ("SlotsPerDay",
+                   "The number of slots a day is split into, by default 48",
+                   UintegerValue (48),
+                   MakeUintegerAccessor (&SolarEnergyPredictor::m_slotsPerDay),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Alpha",
+                   "The weight of the last observation, by default 0.5",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&SolarEnergyPredictor::m_alpha),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("Days",
+                   "The number of past days averaged by WCMA, by default 4",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&SolarEnergyPredictor::m_days),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("K",
+                   "The number of past slots conditioning the WCMA prediction, by default 2",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&SolarEnergyPredictor::m_k),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("PredictedEnergy",
+                     "The energy predicted for the current slot, in Joule.",
+                     MakeTraceSourceAccessor (&SolarEnergyPredictor::m_prediction),
+                     "ns3::TracedValue::DoubleCallback")
+  ;
+  return tid;
+}
+
+SolarEnergyPredictor::SolarEnergyPredictor (void)
+  : m_prediction (0),
+    m_slot (0),
+    m_slotEnergy (0),
+    m_power (0),
+    m_segments (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SolarEnergyPredictor::~SolarEnergyPredictor (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SolarEnergyPredictor::SetHarvester (Ptr<SolarEnergyHarvester> harvester)
+{
+  NS_LOG_FUNCTION (this << harvester);
+  NS_ASSERT (harvester != 0);
+  NS_ASSERT_MSG (m_harvester == 0, "The predictor is already attached to a harvester");
+
+  m_harvester = harvester;
+  m_harvester->TraceConnectWithoutContext ("HarvestedPower",
+                                           MakeCallback (&SolarEnergyPredictor::HarvestedPowerChanged, this));
+  m_harvester->TraceConnectWithoutContext ("PowerSegment",
+                                           MakeCallback (&SolarEnergyPredictor::PowerSegmentChanged, this));
+
+  // all the state is allocated once, the updates never allocate
+  m_history.assign ((size_t) m_days * m_slotsPerDay, 0);
+  m_slotSum.assign (m_slotsPerDay, 0);
+  m_ewma.assign (m_slotsPerDay, 0);
+  m_eta.assign (m_k, 1);
+
+  m_slotDuration = NanoSeconds ((int64_t) SECONDS_IN_DAY * 1000000000 / m_slotsPerDay);
+  m_power = m_harvester->GetPower ();
+  m_lastPowerChange = Simulator::Now ();
+  m_slotEvent = Simulator::Schedule (m_slotDuration, &SolarEnergyPredictor::EndSlot, this);
+}
+
+double
+SolarEnergyPredictor::GetPrediction (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_prediction;
+}
+
+Time
+SolarEnergyPredictor::GetSlotDuration (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_slotDuration;
+}
+
+void
+SolarEnergyPredictor::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_slotEvent.Cancel ();
+  if (m_harvester != 0)
+    {
+      // the harvester may outlive the predictor
+      m_harvester->TraceDisconnectWithoutContext ("HarvestedPower",
+                                                  MakeCallback (&SolarEnergyPredictor::HarvestedPowerChanged, this));
+      m_harvester->TraceDisconnectWithoutContext ("PowerSegment",
+                                                  MakeCallback (&SolarEnergyPredictor::PowerSegmentChanged, this));
+    }
+  m_harvester = 0;
+}
+
+void
+SolarEnergyPredictor::HarvestedPowerChanged (double oldValue, double newValue)
+{
+  NS_LOG_FUNCTION (this << oldValue << newValue);
+
+  Integrate ();
+  m_power = newValue;
+}
+
+void
+SolarEnergyPredictor::PowerSegmentChanged (const SolarPowerSegment &segment)
+{
+  NS_LOG_FUNCTION (this << segment.GetStart () << segment.GetEnd ());
+
+  // the HarvestedPower step of the segment start has already closed the
+  // previous segment
+  Integrate ();
+  m_segment = segment;
+  m_segments = true;
+}
+
+void
+SolarEnergyPredictor::Integrate (void)
+{
+  Time now = Simulator::Now ();
+  if (m_segments)
+    {
+      m_slotEnergy += m_segment.GetEnergy (m_lastPowerChange, now);
+    }
+  else
+    {
+      m_slotEnergy += m_power * (now - m_lastPowerChange).GetSeconds ();
+    }
+  m_lastPowerChange = now;
+}
+
+double
+SolarEnergyPredictor::GetMean (uint32_t slot) const
+{
+  // number of closed slots with this index, at most m_days
+  if (m_slot <= slot)
+    {
+      return 0;
+    }
+  uint64_t n = std::min<uint64_t> (m_days, (m_slot - slot - 1) / m_slotsPerDay + 1);
+  return m_slotSum[slot] / n;
+}
+
+void
+SolarEnergyPredictor::EndSlot (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Integrate ();
+  double energy = m_slotEnergy;
+  m_slotEnergy = 0;
+
+  uint32_t slot = m_slot % m_slotsPerDay;
+  uint64_t day = m_slot / m_slotsPerDay;
+
+  // WCMA: ratio between the energy of this slot and its mean over the past days
+  double mean = GetMean (slot);
+  m_eta[m_slot % m_k] = mean > 0 ? energy / mean : 1;
+
+  // EWMA: the first day initializes the averages
+  m_ewma[slot] = day == 0 ? energy : m_alpha * m_ewma[slot] + (1 - m_alpha) * energy;
+
+  double &oldest = m_history[(day % m_days) * m_slotsPerDay + slot];
+  m_slotSum[slot] += energy - oldest;
+  oldest = energy;
+
+  ++m_slot;
+  uint32_t next = m_slot % m_slotsPerDay;
+
+  double prediction;
+  if (m_algorithm == EWMA)
+    {
+      prediction = m_ewma[next];
+    }
+  else
+    {
+      // weighted mean of the last K ratios, the most recent one weighs 1
+      uint32_t k = std::min<uint64_t> (m_k, m_slot);
+      double gap = 0;
+      double weights = 0;
+      for (uint32_t j = 0; j < k; ++j)
+        {
+          double theta = double (m_k - j) / m_k;
+          gap += theta * m_eta[(m_slot - 1 - j) % m_k];
+          weights += theta;
+        }
+      gap /= weights;
+      prediction = m_alpha * energy + (1 - m_alpha) * GetMean (next) * gap;
+    }
+
+  NS_LOG_DEBUG ("Slot " << slot << " of day " << day << ": harvested " << energy
+                        << " J, predicted " << prediction << " J for the next slot");
+
+  m_prediction = prediction;
+  m_slotEvent = Simulator::Schedule (m_slotDuration, &SolarEnergyPredictor::EndSlot, this);
+}
+
+} // namespace ns3
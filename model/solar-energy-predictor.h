@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_ENERGY_PREDICTOR_H
+#define SOLAR_ENERGY_PREDICTOR_H
+
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-value.h"
+#include "ns3/solar-energy-harvester.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * Online predictor of the energy harvested in the next time slot, as run by
+ * real energy-harvesting nodes. The day is split into SlotsPerDay slots; the
+ * energy of every slot is accumulated from the HarvestedPower trace of the
+ * harvester, or from its PowerSegment trace when its PowerSegmentLength is
+ * positive, since the HarvestedPower steps then hold the power of a segment
+ * start for the whole segment. At the end of the slot, the energy of the
+ * next one is predicted with either:
+ *
+ * - EWMA: for every slot, an exponentially weighted moving average of the
+ *   energy of the same slot in the previous days (Kansal et al.);
+ * - WCMA: the Weather-Conditioned Moving Average, i.e., Alpha times the
+ *   energy of the current slot plus (1 - Alpha) times the mean of the next
+ *   slot over the last Days days, scaled by the weighted ratio of the last K
+ *   slots to their means (Piorno et al.).
+ *
+ * The history is a fixed-size ring buffer of Days x SlotsPerDay slots, with
+ * the per-slot sums kept up to date, so updates and predictions cost O(1)
+ * (O(K) for WCMA) and never allocate.
+ */
+class SolarEnergyPredictor : public Object
+{
+public:
+  enum Algorithm
+  {
+    EWMA,
+    WCMA
+  };
+
+  static TypeId GetTypeId (void);
+
+  SolarEnergyPredictor (void);
+  virtual ~SolarEnergyPredictor (void);
+
+  /**
+   * Start predicting the energy harvested by harvester.
+   */
+  void SetHarvester (Ptr<SolarEnergyHarvester> harvester);
+
+  /**
+   * \return the energy, in Joule, predicted for the current slot
+   */
+  double GetPrediction (void) const;
+
+  Time GetSlotDuration (void) const;
+
+private:
+  /// Defined in ns3::Object
+  void DoDispose (void);
+
+  void HarvestedPowerChanged (double oldValue, double newValue);
+
+  void PowerSegmentChanged (const SolarPowerSegment &segment);
+
+  /**
+   * Add the energy harvested since the last call to the current slot.
+   */
+  void Integrate (void);
+
+  /**
+   * Close the current slot: store its energy and predict the next one.
+   */
+  void EndSlot (void);
+
+  double GetMean (uint32_t slot) const;
+
+private:
+  /** Input Parameter */
+  Algorithm m_algorithm;
+  uint32_t m_slotsPerDay;
+  uint32_t m_days; // <- WCMA history depth, in days
+  uint32_t m_k; // <- WCMA number of past slots for the weather conditioning
+  double m_alpha;
+
+  /** Traced Parameter */
+  TracedValue<double> m_prediction; // <- The energy predicted for the current slot, in Joule
+
+  /** Internal Parameter */
+  Ptr<SolarEnergyHarvester> m_harvester;
+  Time m_slotDuration;
+  EventId m_slotEvent;
+  uint64_t m_slot; // <- Slots since the start
+  double m_slotEnergy; // <- Energy harvested in the current slot
+  double m_power; // <- The current harvested power
+  bool m_segments; // <- The harvester publishes power segments
+  SolarPowerSegment m_segment; // <- The current power segment
+  Time m_lastPowerChange; // <- The time of the last Integrate
+
+  std::vector<double> m_history; // <- Ring buffer of m_days days of slot energies
+  std::vector<double> m_slotSum; // <- Sum of every slot energy over the history
+  std::vector<double> m_ewma; // <- EWMA of every slot energy
+  std::vector<double> m_eta; // <- Ring buffer of the last m_k slot energy to mean ratios
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_ENERGY_PREDICTOR_H */
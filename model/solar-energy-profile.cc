@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-energy-profile.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarEnergyProfile");
+
+typedef std::map<std::string, Ptr<SolarEnergyProfile> > ProfileCache;
+
+static ProfileCache g_profiles;
+static std::mutex g_profilesMutex;
+
+std::string
+SolarEnergyProfile::GetKey (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                            SolarEnergyHarvester::ProfileFormat format, uint32_t blockSamples)
+{
+  std::ostringstream oss;
+  oss.precision (17);
+  oss << panel.latitude << " " << panel.longitude << " " << panel.altitude << " "
+      << panel.solarCellEfficiency << " " << panel.dcdcEfficiency << " "
+      << panel.panelAzimuthAngle << " " << panel.panelTiltAngle << " "
+      << panel.panelDimension << " " << panel.diffusePercentage << " "
+      << panel.sunPositionAlgorithm << " "
+      << Sun::GetUnixTime (&startDate) << " " << step.GetTimeStep ();
+  if (format != SolarEnergyHarvester::DOUBLE_PROFILE)
+    {
+      oss << " " << format << " " << blockSamples;
+    }
+  return oss.str ();
+}
+
+Ptr<SolarEnergyProfile>
+SolarEnergyProfile::Get (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                         SolarEnergyHarvester::ProfileFormat format, uint32_t blockSamples)
+{
+  NS_LOG_FUNCTION (step << format << blockSamples);
+
+  std::string key = GetKey (panel, startDate, step, format, blockSamples);
+  std::lock_guard<std::mutex> lock (g_profilesMutex);
+  ProfileCache::iterator i = g_profiles.find (key);
+  if (i != g_profiles.end ())
+    {
+      return i->second;
+    }
+
+  // e.g., every move of a MobilityAware harvester needs another profile
+  if (g_profiles.size () >= CACHE_SIZE)
+    {
+      DropUnused ();
+    }
+  NS_LOG_DEBUG ("New profile " << key);
+  Ptr<SolarEnergyProfile> profile = Create<SolarEnergyProfile> (panel, startDate, step, format, blockSamples);
+  g_profiles[key] = profile;
+  return profile;
+}
+
+void
+SolarEnergyProfile::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  std::lock_guard<std::mutex> lock (g_profilesMutex);
+  DropUnused ();
+}
+
+void
+SolarEnergyProfile::DropUnused (void)
+{
+  for (ProfileCache::iterator i = g_profiles.begin (); i != g_profiles.end (); )
+    {
+      if (i->second->GetReferenceCount () == 1)
+        {
+          g_profiles.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+SolarEnergyProfile::SolarEnergyProfile (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                                        SolarEnergyHarvester::ProfileFormat format, uint32_t blockSamples)
+  : m_panel (panel),
+    m_count (1),
+    m_startDate (startDate),
+    m_step (step),
+    m_dateStepS ((int) step.GetSeconds ()),
+    m_format (format),
+    m_blockSamples (blockSamples)
+{
+  NS_ASSERT (step.IsStrictlyPositive ());
+  NS_ASSERT (format == SolarEnergyHarvester::DOUBLE_PROFILE || blockSamples > 0);
+  if (m_format == SolarEnergyHarvester::DOUBLE_PROFILE)
+    {
+      m_cumulative.push_back (0);
+    }
+}
+
+bool
+SolarEnergyProfile::Matches (const SolarEnergyHarvester::Panel &panel) const
+{
+  return m_panel == panel;
+}
+
+double
+SolarEnergyProfile::GetEnergy (Time offset)
+{
+  NS_ASSERT (!offset.IsNegative ());
+
+  // the power of update i is accounted over [i - 1, i], as the harvester
+  // does, instead of [i, i + 1]: the profile is stored forward, shifted by
+  // one update, and the power of the first update is dropped
+  std::lock_guard<std::mutex> lock (m_mutex);
+  return GetForwardEnergy (offset + m_step) - GetForwardEnergy (m_step);
+}
+
+double
+SolarEnergyProfile::GetForwardEnergy (Time offset)
+{
+  uint64_t sample = offset.GetTimeStep () / m_step.GetTimeStep ();
+  int64_t remainder = offset.GetTimeStep () - sample * m_step.GetTimeStep ();
+  if (m_format != SolarEnergyHarvester::DOUBLE_PROFILE)
+    {
+      ExtendBlocks (sample);
+      const Block &block = m_blocks[sample / m_blockSamples];
+      double power = 0;
+      if (block.scale > 0)
+        {
+          for (uint64_t i = sample - sample % m_blockSamples; i < sample; ++i)
+            {
+              power += DecodePower (i);
+            }
+        }
+      double energy = block.energy + power * m_step.GetSeconds ();
+      if (remainder > 0)
+        {
+          energy += DecodePower (sample) * m_step.GetSeconds () * remainder / m_step.GetTimeStep ();
+        }
+      return energy;
+    }
+  Extend (sample + 1);
+
+  double energy = m_cumulative[sample];
+  if (remainder > 0)
+    {
+      energy += (m_cumulative[sample + 1] - m_cumulative[sample]) * remainder / m_step.GetTimeStep ();
+    }
+  return energy;
+}
+
+double
+SolarEnergyProfile::GetPower (uint64_t sample)
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  if (m_format != SolarEnergyHarvester::DOUBLE_PROFILE)
+    {
+      ExtendBlocks (sample);
+      return DecodePower (sample);
+    }
+  Extend (sample + 1);
+  return (m_cumulative[sample + 1] - m_cumulative[sample]) / m_step.GetSeconds ();
+}
+
+Time
+SolarEnergyProfile::GetStep (void) const
+{
+  return m_step;
+}
+
+SolarEnergyHarvester::ProfileFormat
+SolarEnergyProfile::GetFormat (void) const
+{
+  return m_format;
+}
+
+uint64_t
+SolarEnergyProfile::GetMemoryUsage (void)
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  return m_cumulative.size () * sizeof (double) + m_blocks.size () * sizeof (Block)
+         + m_quanta16.size () * sizeof (uint16_t) + m_quanta8.size () * sizeof (uint8_t);
+}
+
+void
+SolarEnergyProfile::Ref (void) const
+{
+  m_count.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+SolarEnergyProfile::Unref (void) const
+{
+  if (m_count.fetch_sub (1, std::memory_order_acq_rel) == 1)
+    {
+      delete this;
+    }
+}
+
+uint32_t
+SolarEnergyProfile::GetReferenceCount (void) const
+{
+  return m_count.load (std::memory_order_relaxed);
+}
+
+void
+SolarEnergyProfile::Extend (uint64_t sample)
+{
+  if (sample < m_cumulative.size ())
+    {
+      return;
+    }
+
+  // one day of updates at a time
+  uint64_t last = std::max<uint64_t> (sample, m_cumulative.size () - 1 + std::max<int64_t> (1, SECONDS_IN_DAY / std::max (m_dateStepS, 1)));
+  NS_LOG_DEBUG ("Extending profile to " << last << " updates");
+
+  m_cumulative.reserve (last + 1);
+  double stepS = m_step.GetSeconds ();
+  for (uint64_t i = m_cumulative.size () - 1; i < last; ++i)
+    {
+      tm date = m_startDate;
+      Sun::AddSeconds (&date, (int64_t) i * m_dateStepS);
+      m_cumulative.push_back (m_cumulative.back () + SolarEnergyHarvester::CalculateHarvestedPower (&date, m_panel) * stepS);
+    }
+}
+
+void
+SolarEnergyProfile::ExtendBlocks (uint64_t sample)
+{
+  uint64_t built = (uint64_t) m_blocks.size () * m_blockSamples;
+  if (sample < built)
+    {
+      return;
+    }
+
+  // one day of updates at a time, rounded up to whole blocks
+  uint64_t last = std::max<uint64_t> (sample + 1, built + std::max<int64_t> (1, SECONDS_IN_DAY / std::max (m_dateStepS, 1)));
+  NS_LOG_DEBUG ("Extending quantized profile to " << last << " updates");
+
+  uint32_t levels = m_format == SolarEnergyHarvester::QUANTIZED_8_PROFILE ? 0xff : 0xffff;
+  double stepS = m_step.GetSeconds ();
+  double energy = m_blocks.empty () ? 0 : m_blocks.back ().energy;
+  if (!m_blocks.empty ())
+    {
+      // the energy after the last block, from its quantized power
+      for (uint64_t i = built - m_blockSamples; i < built; ++i)
+        {
+          energy += DecodePower (i) * stepS;
+        }
+    }
+
+  std::vector<double> power (m_blockSamples);
+  for (uint64_t first = built; first < last; first += m_blockSamples)
+    {
+      double peak = 0;
+      for (uint32_t i = 0; i < m_blockSamples; ++i)
+        {
+          tm date = m_startDate;
+          Sun::AddSeconds (&date, (int64_t) (first + i) * m_dateStepS);
+          power[i] = SolarEnergyHarvester::CalculateHarvestedPower (&date, m_panel);
+          peak = std::max (peak, power[i]);
+        }
+
+      Block block;
+      block.energy = energy;
+      block.scale = (float) (peak / levels);
+      block.offset = m_format == SolarEnergyHarvester::QUANTIZED_8_PROFILE ? m_quanta8.size () : m_quanta16.size ();
+      if (block.scale > 0)
+        {
+          for (uint32_t i = 0; i < m_blockSamples; ++i)
+            {
+              // the float scale may be rounded down: clamp to the top level
+              uint32_t quantum = std::min<uint32_t> (levels, (uint32_t) lround (power[i] / block.scale));
+              if (m_format == SolarEnergyHarvester::QUANTIZED_8_PROFILE)
+                {
+                  m_quanta8.push_back ((uint8_t) quantum);
+                }
+              else
+                {
+                  m_quanta16.push_back ((uint16_t) quantum);
+                }
+              energy += quantum * (double) block.scale * stepS;
+            }
+        }
+      m_blocks.push_back (block);
+    }
+}
+
+double
+SolarEnergyProfile::DecodePower (uint64_t sample) const
+{
+  const Block &block = m_blocks[sample / m_blockSamples];
+  if (block.scale == 0)
+    {
+      return 0;
+    }
+  uint64_t index = block.offset + sample % m_blockSamples;
+  uint32_t quantum = m_format == SolarEnergyHarvester::QUANTIZED_8_PROFILE ? m_quanta8[index] : m_quanta16[index];
+  return quantum * (double) block.scale;
+}
+
+} // namespace ns3
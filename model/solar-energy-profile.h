@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_ENERGY_PROFILE_H
+#define SOLAR_ENERGY_PROFILE_H
+
+#include "ns3/solar-energy-harvester.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The cumulative energy provided by a SolarEnergyHarvester, sampled at
+ * every harvested power update, for a given site and panel, starting date
+ * and update interval.
+ *
+ * As the harvester and BasicEnergySource, the profile accounts the power
+ * computed at every update over the interval before it, i.e., since the
+ * previous update. The profile is extended lazily, one day of updates at a
+ * time, when a later time is queried; profiles are shared through Get by
+ * all the harvesters with the same parameters, and the cache drops the
+ * profiles not in use by any harvester once it holds CACHE_SIZE of them.
+ *
+ * In the DOUBLE_PROFILE format, the cumulative energy before every update
+ * is stored in double precision, 8 bytes per update. The quantized formats
+ * store the power of every update in 16 or 8 bits, as a multiple of a scale
+ * shared by a block of updates, i.e., the block peak divided by the number
+ * of levels; blocks without power, e.g., at night, store no samples. The
+ * error of every power is below half the scale, and the energy is the
+ * integral of the quantized power, so the profile is consistent with
+ * itself; GetPower decodes one sample, GetEnergy adds the samples of one
+ * block at most.
+ *
+ * Profiles can be shared by simulations running in different threads: the
+ * cache and the lazy extension are protected by mutexes, and the reference
+ * count, used by Ptr in place of the one of SimpleRefCount, is atomic.
+ */
+class SolarEnergyProfile
+{
+public:
+  /// The profiles cached by Get before the ones not in use are dropped
+  static const uint32_t CACHE_SIZE = 64;
+
+  /**
+   * \param panel the site and panel parameters
+   * \param startDate the date of the first update
+   * \param step the harvested power update interval
+   * \param format the storage of the profile
+   * \param blockSamples the updates sharing a scale, in the quantized formats
+   * \return the shared profile of these parameters, created if needed
+   */
+  static Ptr<SolarEnergyProfile> Get (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                                      SolarEnergyHarvester::ProfileFormat format = SolarEnergyHarvester::DOUBLE_PROFILE,
+                                      uint32_t blockSamples = 256);
+
+  /**
+   * \return a string identifying the parameters, used to share profiles
+   */
+  static std::string GetKey (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                             SolarEnergyHarvester::ProfileFormat format = SolarEnergyHarvester::DOUBLE_PROFILE,
+                             uint32_t blockSamples = 256);
+
+  /**
+   * Release the profiles not in use by any harvester.
+   */
+  static void ClearCache (void);
+
+  SolarEnergyProfile (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step,
+                      SolarEnergyHarvester::ProfileFormat format = SolarEnergyHarvester::DOUBLE_PROFILE,
+                      uint32_t blockSamples = 256);
+
+  /**
+   * \return true if the profile has been built for these parameters
+   */
+  bool Matches (const SolarEnergyHarvester::Panel &panel) const;
+
+  /**
+   * \param offset the time elapsed since the first update
+   * \return the energy harvested from the first update until offset, in Joule
+   */
+  double GetEnergy (Time offset);
+
+  /**
+   * \param sample the update index, 0 being the first update
+   * \return the power computed at that update, in Watt
+   */
+  double GetPower (uint64_t sample);
+
+  Time GetStep (void) const;
+
+  SolarEnergyHarvester::ProfileFormat GetFormat (void) const;
+
+  /**
+   * \return the bytes holding the updates built so far
+   */
+  uint64_t GetMemoryUsage (void);
+
+  /// Used by Ptr
+  void Ref (void) const;
+  /// Used by Ptr
+  void Unref (void) const;
+  uint32_t GetReferenceCount (void) const;
+
+private:
+  /**
+   * Release the cached profiles not in use, g_profilesMutex being held.
+   */
+  static void DropUnused (void);
+
+  /**
+   * \param offset the time elapsed since the first update
+   * \return the energy until offset, accounting the power of every update
+   * over the interval after it, in Joule; m_mutex must be held
+   */
+  double GetForwardEnergy (Time offset);
+
+  /**
+   * Build the profile until the cumulative energy after the given update.
+   */
+  void Extend (uint64_t sample);
+
+  /**
+   * Build and quantize the blocks until the given update.
+   */
+  void ExtendBlocks (uint64_t sample);
+
+  /**
+   * \return the quantized power of an update already built, in Watt
+   */
+  double DecodePower (uint64_t sample) const;
+
+  /**
+   * A block of quantized updates
+   */
+  struct Block
+  {
+    double energy; //!< Energy harvested before the first update of the block, in Joule
+    float scale; //!< Watt per quantization level, 0 if the block has no power
+    uint32_t offset; //!< Index of the first sample of the block in m_quanta16 or m_quanta8
+  };
+
+  SolarEnergyHarvester::Panel m_panel;
+  mutable std::atomic<uint32_t> m_count; // <- The reference count
+  std::mutex m_mutex; // <- Protects m_cumulative
+  tm m_startDate; // <- The date of the first update
+  Time m_step; // <- The harvested power update interval
+  int m_dateStepS; // <- Seconds added to the date at every update, truncated as the harvester does
+  SolarEnergyHarvester::ProfileFormat m_format; // <- The storage of the profile
+  uint32_t m_blockSamples; // <- The updates of every block, in the quantized formats
+  std::vector<double> m_cumulative; // <- Energy harvested before every update, in Joule, in the DOUBLE_PROFILE format
+  std::vector<Block> m_blocks; // <- The blocks built so far, in the quantized formats
+  std::vector<uint16_t> m_quanta16; // <- The samples of the blocks with power, in the QUANTIZED_16_PROFILE format
+  std::vector<uint8_t> m_quanta8; // <- The samples of the blocks with power, in the QUANTIZED_8_PROFILE format
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_ENERGY_PROFILE_H */
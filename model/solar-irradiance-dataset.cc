@@ -0,0 +1,237 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-irradiance-dataset.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarIrradianceDataset");
+
+static_assert (sizeof (SolarIrradianceDataset::Header) == 64, "The dataset header has a fixed layout");
+static_assert (sizeof (SolarIrradianceDataset::Record) == 12, "The dataset records have a fixed stride");
+
+const char SolarIrradianceDataset::MAGIC[8] = "SHIRRAD";
+
+typedef std::map<std::string, Ptr<SolarIrradianceDataset> > DatasetCache;
+
+static DatasetCache g_datasets;
+static std::mutex g_datasetsMutex;
+
+Ptr<SolarIrradianceDataset>
+SolarIrradianceDataset::Get (const std::string &filename)
+{
+  NS_LOG_FUNCTION (filename);
+
+  std::lock_guard<std::mutex> lock (g_datasetsMutex);
+  Ptr<SolarIrradianceDataset> &dataset = g_datasets[filename];
+  if (dataset == 0)
+    {
+      dataset = Create<SolarIrradianceDataset> (filename);
+    }
+  return dataset;
+}
+
+void
+SolarIrradianceDataset::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  std::lock_guard<std::mutex> lock (g_datasetsMutex);
+  for (DatasetCache::iterator i = g_datasets.begin (); i != g_datasets.end (); )
+    {
+      if (i->second->GetReferenceCount () == 1)
+        {
+          g_datasets.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+SolarIrradianceDataset::SolarIrradianceDataset (const std::string &filename)
+  : m_count (1),
+    m_filename (filename),
+    m_map (MAP_FAILED),
+    m_mapSize (0),
+    m_header (0),
+    m_records (0)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  int fd = open (filename.c_str (), O_RDONLY);
+  NS_ABORT_MSG_IF (fd < 0, "SolarIrradianceDataset: cannot open " << filename << ": " << strerror (errno));
+  struct stat st;
+  NS_ABORT_MSG_IF (fstat (fd, &st) != 0, "SolarIrradianceDataset: cannot stat " << filename);
+  NS_ABORT_MSG_IF ((size_t) st.st_size < sizeof (Header), "SolarIrradianceDataset: " << filename << " is too short");
+
+  m_mapSize = st.st_size;
+  m_map = mmap (0, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  NS_ABORT_MSG_IF (m_map == MAP_FAILED, "SolarIrradianceDataset: cannot map " << filename << ": " << strerror (errno));
+
+  m_header = static_cast<const Header *> (m_map);
+  m_records = reinterpret_cast<const Record *> (m_header + 1);
+  NS_ABORT_MSG_UNLESS (memcmp (m_header->magic, MAGIC, sizeof (MAGIC)) == 0 && m_header->version == VERSION,
+                       "SolarIrradianceDataset: " << filename << " is not a version " << VERSION
+                       << " dataset, convert it with sun-harvester-irradiance");
+  NS_ABORT_MSG_UNLESS (m_header->recordSize == sizeof (Record) && m_header->step > 0
+                       && m_header->records <= (m_mapSize - sizeof (Header)) / sizeof (Record),
+                       "SolarIrradianceDataset: " << filename << " is truncated or corrupted");
+
+  // the harvesters read forward in time
+  madvise (m_map, m_mapSize, MADV_SEQUENTIAL);
+
+  NS_LOG_DEBUG ("Mapped " << filename << ": " << m_header->records << " records every " << m_header->step
+                          << " s from " << m_header->start);
+}
+
+SolarIrradianceDataset::~SolarIrradianceDataset ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_map != MAP_FAILED)
+    {
+      munmap (m_map, m_mapSize);
+    }
+}
+
+const SolarIrradianceDataset::Header&
+SolarIrradianceDataset::GetHeader (void) const
+{
+  return *m_header;
+}
+
+int64_t
+SolarIrradianceDataset::GetStart (void) const
+{
+  return m_header->start;
+}
+
+int64_t
+SolarIrradianceDataset::GetEnd (void) const
+{
+  return m_header->start + (int64_t) m_header->records * m_header->step;
+}
+
+int64_t
+SolarIrradianceDataset::GetLast (void) const
+{
+  return m_header->start + ((int64_t) m_header->records - 1) * m_header->step;
+}
+
+const SolarIrradianceDataset::Record&
+SolarIrradianceDataset::GetRecord (uint64_t i) const
+{
+  NS_ASSERT (i < m_header->records);
+  return m_records[i];
+}
+
+bool
+SolarIrradianceDataset::GetIrradiance (double time, Record &record) const
+{
+  double position = (time - m_header->start) / m_header->step;
+  if (m_header->records == 0 || position < 0 || position > m_header->records - 1)
+    {
+      return false;
+    }
+
+  uint64_t i = (uint64_t) position;
+  const Record &first = m_records[i];
+  const Record &second = i + 1 < m_header->records ? m_records[i + 1] : first;
+  float fraction = position - i;
+
+  // a missing sample weighs nothing, a missing pair yields nothing
+  float *fields[3] = { &record.ghi, &record.dni, &record.dhi };
+  const float *firstFields[3] = { &first.ghi, &first.dni, &first.dhi };
+  const float *secondFields[3] = { &second.ghi, &second.dni, &second.dhi };
+  for (int f = 0; f < 3; ++f)
+    {
+      float a = *firstFields[f];
+      float b = *secondFields[f];
+      if (isnan (a))
+        {
+          a = b;
+        }
+      if (isnan (b))
+        {
+          b = a;
+        }
+      *fields[f] = isnan (a) ? 0 : a + (b - a) * fraction;
+    }
+  return true;
+}
+
+double
+SolarIrradianceDataset::GetPlaneOfArrayIrradiance (const Record &record, const Sun::Coordinates &coordinates,
+                                                   double panelTiltAngle, double panelAzimuthAngle, double albedo)
+{
+  double cosTilt = cos (panelTiltAngle * rad);
+  double sky = record.dhi * (1 + cosTilt) / 2;
+  double ground = record.ghi * albedo * (1 - cosTilt) / 2;
+
+  double beam = 0;
+  if (coordinates.dElevationAngle > 0)
+    {
+      // the sun azimuth is clockwise from north, the panel one from south
+      double zenith = coordinates.dZenithAngle * rad;
+      double cosIncidence = cos (zenith) * cosTilt
+        - sin (zenith) * sin (panelTiltAngle * rad) * cos ((coordinates.dAzimuth - panelAzimuthAngle) * rad);
+      beam = record.dni * std::max (cosIncidence, 0.0);
+    }
+  return beam + sky + ground;
+}
+
+void
+SolarIrradianceDataset::Ref (void) const
+{
+  m_count.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+SolarIrradianceDataset::Unref (void) const
+{
+  if (m_count.fetch_sub (1, std::memory_order_acq_rel) == 1)
+    {
+      delete this;
+    }
+}
+
+uint32_t
+SolarIrradianceDataset::GetReferenceCount (void) const
+{
+  return m_count.load (std::memory_order_relaxed);
+}
+
+} // namespace ns3
@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_IRRADIANCE_DATASET_H
+#define SOLAR_IRRADIANCE_DATASET_H
+
+#include "ns3/sun.h"
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * A measured irradiance series of one station: the global horizontal
+ * (GHI), direct normal (DNI) and diffuse horizontal (DHI) irradiance, in
+ * W/m^2, at a fixed step from a starting UTC time.
+ *
+ * The series is read from the binary format written by
+ * utils/sun-harvester-irradiance from CSV, TMY3 or EPW files: a Header
+ * followed by one Record per step, in the byte order of the host. The file
+ * is memory-mapped read-only, so only the pages in use are loaded, and they
+ * are shared by all the harvesters of the station through Get, and with
+ * the other processes reading the same file through the page cache.
+ *
+ * Samples the converter could not fill are NaN, and yield no irradiance.
+ *
+ * Datasets can be shared by simulations running in different threads: the
+ * data are never written, the cache is protected by a mutex and the
+ * reference count, used by Ptr, is atomic.
+ */
+class SolarIrradianceDataset
+{
+public:
+  /**
+   * The file header
+   */
+  struct Header
+  {
+    char magic[8]; //!< "SHIRRAD", NUL terminated
+    uint32_t version; //!< 1
+    uint32_t recordSize; //!< sizeof (Record)
+    int64_t start; //!< The UTC time of the first record, in seconds since the Epoch
+    uint32_t step; //!< Seconds between two records
+    uint32_t reserved; //!< 0
+    uint64_t records; //!< The number of records
+    double latitude; //!< The station latitude, NaN if unknown
+    double longitude; //!< The station longitude, NaN if unknown
+    double altitude; //!< The station altitude [m], NaN if unknown
+  };
+
+  /**
+   * One sample of the series, in W/m^2
+   */
+  struct Record
+  {
+    float ghi; //!< Global horizontal irradiance
+    float dni; //!< Direct normal irradiance
+    float dhi; //!< Diffuse horizontal irradiance
+  };
+
+  static const char MAGIC[8];
+  static const uint32_t VERSION = 1;
+
+  /**
+   * \param filename the binary dataset
+   * \return the shared dataset of filename, mapped if needed
+   */
+  static Ptr<SolarIrradianceDataset> Get (const std::string &filename);
+
+  /**
+   * Unmap the datasets not in use by any harvester.
+   */
+  static void ClearCache (void);
+
+  /**
+   * Map filename, aborting if it is not a valid dataset.
+   */
+  explicit SolarIrradianceDataset (const std::string &filename);
+  ~SolarIrradianceDataset ();
+
+  const Header& GetHeader (void) const;
+
+  /**
+   * \return the UTC time of the first record, in seconds since the Epoch
+   */
+  int64_t GetStart (void) const;
+
+  /**
+   * \return the UTC time following the last record, in seconds since the Epoch
+   */
+  int64_t GetEnd (void) const;
+
+  /**
+   * \return the UTC time of the last record, in seconds since the Epoch: the
+   * last time GetIrradiance covers
+   */
+  int64_t GetLast (void) const;
+
+  /**
+   * \param i the record index, below GetHeader ().records
+   */
+  const Record& GetRecord (uint64_t i) const;
+
+  /**
+   * The irradiance at time, linearly interpolated between the two records
+   * around it.
+   *
+   * \param time the UTC time in seconds since the Epoch
+   * \param record the interpolated irradiance, with no NaN
+   * \return false if time is outside the series
+   */
+  bool GetIrradiance (double time, Record &record) const;
+
+  /**
+   * The plane of array transposition of a measured sample: the beam, from
+   * DNI and the angle of incidence, the sky diffuse, from DHI and the
+   * isotropic sky model (Liu and Jordan), and the ground reflected
+   * irradiance, from GHI and the albedo.
+   *
+   * \param record the measured irradiance
+   * \param coordinates the sun position at the time of record
+   * \param panelTiltAngle the panel tilt angle in degrees
+   * \param panelAzimuthAngle the panel azimuth angle in degrees, 0 facing
+   * south, positive toward west
+   * \param albedo the ground reflectance
+   * \return the irradiance on the panel plane in [W/m^2]
+   */
+  static double GetPlaneOfArrayIrradiance (const Record &record, const Sun::Coordinates &coordinates,
+                                           double panelTiltAngle, double panelAzimuthAngle, double albedo);
+
+  /// Used by Ptr
+  void Ref (void) const;
+  /// Used by Ptr
+  void Unref (void) const;
+  uint32_t GetReferenceCount (void) const;
+
+private:
+  mutable std::atomic<uint32_t> m_count; // <- The reference count
+  std::string m_filename; // <- The mapped file
+  void *m_map; // <- The mapped file
+  size_t m_mapSize; // <- The mapped bytes
+  const Header *m_header; // <- The header, at the beginning of m_map
+  const Record *m_records; // <- The records, right after the header
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_IRRADIANCE_DATASET_H */
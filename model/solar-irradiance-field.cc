@@ -0,0 +1,290 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-irradiance-field.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarIrradianceField");
+
+NS_OBJECT_ENSURE_REGISTERED (SolarIrradianceField);
+
+TypeId
+SolarIrradianceField::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SolarIrradianceField")
+    .SetParent<Object> ()
+    .AddConstructor<SolarIrradianceField> ()
+    .AddAttribute ("MinLatitude",
+                   "The latitude of the southern grid edge",
+                   DoubleValue (38.0),
+                   MakeDoubleAccessor (&SolarIrradianceField::m_minLatitude),
+                   MakeDoubleChecker<double> (-90, 90))
+    .AddAttribute ("MaxLatitude",
+                   "The latitude of the northern grid edge",
+                   DoubleValue (38.2),
+                   MakeDoubleAccessor (&SolarIrradianceField::m_maxLatitude),
+                   MakeDoubleChecker<double> (-90, 90))
+    .AddAttribute ("MinLongitude",
+                   "The longitude of the western grid edge",
+                   DoubleValue (15.5),
+                   MakeDoubleAccessor (&SolarIrradianceField::m_minLongitude),
+                   MakeDoubleChecker<double> (-180, 180))
+    .AddAttribute ("MaxLongitude",
+                   "The longitude of the eastern grid edge",
+                   DoubleValue (15.8),
+                   MakeDoubleAccessor (&SolarIrradianceField::m_maxLongitude),
+                   MakeDoubleChecker<double> (-180, 180))
+    .AddAttribute ("LatitudePoints",
+                   "The number of grid points along the latitude, by default 5",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&SolarIrradianceField::m_latitudePoints),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("LongitudePoints",
+                   "The number of grid points along the longitude, by default 5",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&SolarIrradianceField::m_longitudePoints),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("Altitude",
+                   "The altitude from the sea level [m] used for the Air Mass factor of the grid",
+                   DoubleValue (31),
+                   MakeDoubleAccessor (&SolarIrradianceField::m_altitude),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CachedDates",
+                   "The number of dates whose grid is kept, least recently used first out, by default 8",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&SolarIrradianceField::m_cachedDates),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+SolarIrradianceField::SolarIrradianceField (void)
+  : m_uses (0),
+    m_evaluations (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SolarIrradianceField::~SolarIrradianceField (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SolarIrradianceField::PanelWeights
+SolarIrradianceField::GetPanelWeights (double panelTiltAngle, double panelAzimuthAngle, double diffusePercentage)
+{
+  PanelWeights weights;
+  weights.incident = diffusePercentage / 100;
+  weights.horizontalCos = sin (panelTiltAngle * rad) * cos (panelAzimuthAngle * rad);
+  weights.horizontalSin = sin (panelTiltAngle * rad) * sin (panelAzimuthAngle * rad);
+  weights.vertical = cos (panelTiltAngle * rad);
+  return weights;
+}
+
+SolarIrradianceField::Irradiance
+SolarIrradianceField::Sample (const tm *date, double latitude, double longitude, bool lookAhead)
+{
+  double y = (latitude - m_minLatitude) / (m_maxLatitude - m_minLatitude) * (m_latitudePoints - 1);
+  double x = (longitude - m_minLongitude) / (m_maxLongitude - m_minLongitude) * (m_longitudePoints - 1);
+  y = std::min (std::max (y, 0.0), double (m_latitudePoints - 1));
+  x = std::min (std::max (x, 0.0), double (m_longitudePoints - 1));
+  uint32_t row = std::min<uint32_t> (y, m_latitudePoints - 2);
+  uint32_t column = std::min<uint32_t> (x, m_longitudePoints - 2);
+  double v = y - row;
+  double u = x - column;
+
+  size_t k[4] = { row * m_longitudePoints + column, row * m_longitudePoints + column + 1,
+                  (row + 1) * m_longitudePoints + column, (row + 1) * m_longitudePoints + column + 1 };
+  Irradiance corners[4];
+  Grid *grid = lookAhead ? Find (date) : Update (date);
+  if (grid != 0)
+    {
+      for (int c = 0; c < 4; ++c)
+        {
+          corners[c] = grid->points[k[c]];
+        }
+    }
+  else
+    {
+      // the same values the grid would hold, at the four points only
+      Setup ();
+      Sun::CelestialState state;
+      Sun::GetCelestialState (date, &state);
+      for (int c = 0; c < 4; ++c)
+        {
+          corners[c] = Evaluate (state, m_locations[k[c]], m_airMass[k[c] / m_longitudePoints]);
+        }
+    }
+
+  const Irradiance &a = corners[0];
+  const Irradiance &b = corners[1];
+  const Irradiance &c = corners[2];
+  const Irradiance &d = corners[3];
+  double wa = (1 - u) * (1 - v);
+  double wb = u * (1 - v);
+  double wc = (1 - u) * v;
+  double wd = u * v;
+
+  Irradiance irradiance;
+  irradiance.incident = wa * a.incident + wb * b.incident + wc * c.incident + wd * d.incident;
+  irradiance.horizontalCos = wa * a.horizontalCos + wb * b.horizontalCos + wc * c.horizontalCos + wd * d.horizontalCos;
+  irradiance.horizontalSin = wa * a.horizontalSin + wb * b.horizontalSin + wc * c.horizontalSin + wd * d.horizontalSin;
+  irradiance.vertical = wa * a.vertical + wb * b.vertical + wc * c.vertical + wd * d.vertical;
+  return irradiance;
+}
+
+double
+SolarIrradianceField::GetPanelInsolation (const tm *date, double latitude, double longitude, const PanelWeights &weights,
+                                          bool lookAhead)
+{
+  Irradiance irradiance = Sample (date, latitude, longitude, lookAhead);
+  return weights.incident * irradiance.incident + weights.horizontalCos * irradiance.horizontalCos
+         + weights.horizontalSin * irradiance.horizontalSin + weights.vertical * irradiance.vertical;
+}
+
+uint64_t
+SolarIrradianceField::GetEvaluations (void) const
+{
+  return m_evaluations;
+}
+
+void
+SolarIrradianceField::Setup (void)
+{
+  if (!m_locations.empty ())
+    {
+      return;
+    }
+
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_maxLatitude > m_minLatitude && m_maxLongitude > m_minLongitude);
+
+  m_airMass.resize (m_latitudePoints);
+  m_locations.resize ((size_t) m_latitudePoints * m_longitudePoints);
+  for (uint32_t i = 0; i < m_latitudePoints; ++i)
+    {
+      double latitude = m_minLatitude + (m_maxLatitude - m_minLatitude) * i / (m_latitudePoints - 1);
+      m_airMass[i] = Sun::GetAirMass (latitude, m_altitude);
+      for (uint32_t j = 0; j < m_longitudePoints; ++j)
+        {
+          double longitude = m_minLongitude + (m_maxLongitude - m_minLongitude) * j / (m_longitudePoints - 1);
+          m_locations[i * m_longitudePoints + j] = Sun::GetLocation (latitude, longitude);
+        }
+    }
+}
+
+SolarIrradianceField::Grid*
+SolarIrradianceField::Find (const tm *date)
+{
+  for (std::vector<Grid>::iterator i = m_grids.begin (); i != m_grids.end (); ++i)
+    {
+      if (date->tm_sec == i->date.tm_sec && date->tm_min == i->date.tm_min
+          && date->tm_hour == i->date.tm_hour && date->tm_mday == i->date.tm_mday
+          && date->tm_mon == i->date.tm_mon && date->tm_year == i->date.tm_year
+          && date->tm_gmtoff == i->date.tm_gmtoff)
+        {
+          i->lastUse = ++m_uses;
+          return &*i;
+        }
+    }
+  return 0;
+}
+
+SolarIrradianceField::Grid*
+SolarIrradianceField::Update (const tm *date)
+{
+  Grid *grid = Find (date);
+  if (grid != 0)
+    {
+      return grid;
+    }
+
+  NS_LOG_FUNCTION (this);
+  Setup ();
+
+  if (m_grids.size () < m_cachedDates)
+    {
+      m_grids.push_back (Grid ());
+      grid = &m_grids.back ();
+      grid->points.resize (m_locations.size ());
+    }
+  else
+    {
+      grid = &m_grids[0];
+      for (std::vector<Grid>::iterator i = m_grids.begin (); i != m_grids.end (); ++i)
+        {
+          if (i->lastUse < grid->lastUse)
+            {
+              grid = &*i;
+            }
+        }
+    }
+
+  // the time-only stage of PSA is the same for all the grid points
+  Sun::CelestialState state;
+  Sun::GetCelestialState (date, &state);
+  for (uint32_t i = 0; i < m_latitudePoints; ++i)
+    {
+      for (uint32_t j = 0; j < m_longitudePoints; ++j)
+        {
+          size_t k = i * m_longitudePoints + j;
+          grid->points[k] = Evaluate (state, m_locations[k], m_airMass[i]);
+        }
+    }
+
+  grid->date = *date;
+  grid->lastUse = ++m_uses;
+  ++m_evaluations;
+  return grid;
+}
+
+SolarIrradianceField::Irradiance
+SolarIrradianceField::Evaluate (const Sun::CelestialState &state, const Sun::Location &location, double airMass)
+{
+  Irradiance irradiance;
+  memset (&irradiance, 0, sizeof (irradiance));
+
+  Sun::Coordinates coordinates;
+  Sun::PSA (state, location, &coordinates);
+  if (coordinates.dElevationAngle > 0)
+    {
+      // the same terms of SolarEnergyHarvester::GetPanelInsolation
+      double incident = 2 * Sun::GetIncidentInsolation (coordinates, airMass);
+      double elevation = coordinates.dElevationAngle * rad;
+      double zenith = coordinates.dZenithAngle * rad;
+      irradiance.incident = incident;
+      irradiance.horizontalCos = incident * cos (elevation) * cos (zenith);
+      irradiance.horizontalSin = incident * cos (elevation) * sin (zenith);
+      irradiance.vertical = incident * sin (elevation);
+    }
+  return irradiance;
+}
+
+} // namespace ns3
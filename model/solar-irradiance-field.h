@@ -0,0 +1,177 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_IRRADIANCE_FIELD_H
+#define SOLAR_IRRADIANCE_FIELD_H
+
+#include "ns3/object.h"
+#include "ns3/sun.h"
+
+#include <ctime>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The clear-sky irradiance over a regular latitude/longitude grid, shared by
+ * the harvesters of a dense deployment.
+ *
+ * The sun model (Sun::PSA and the incident insolation) is evaluated at every
+ * grid point once per date, lazily, when the first harvester samples a new
+ * date; every other harvester interpolates it bilinearly from its location.
+ * Each grid point stores the incident insolation I and its horizontal and
+ * vertical components, so that the power of any tilted panel is a linear
+ * combination of four interpolated values:
+ *
+ *   insolation = diffuse * I + sin(tilt) cos(azimuth) * I cos(el) cos(zen)
+ *              + sin(tilt) sin(azimuth) * I cos(el) sin(zen) + cos(tilt) * I sin(el)
+ *
+ * which is the SolarEnergyHarvester model. The cost per harvester is then
+ * constant, and the cost per tick scales with the grid size. Locations
+ * outside the grid take the value of the nearest edge; the Air Mass factor
+ * is computed at the grid latitudes for the field Altitude.
+ *
+ * The grids of the last CachedDates dates are kept, least recently used
+ * first out: the harvesters sharing a field are expected to share StartAt
+ * and PeriodicHarvestedPowerUpdateInterval, so that they sample the same
+ * dates. A look-ahead sample (e.g., the threshold crossing scan) reads a
+ * cached grid if there is one, and otherwise evaluates only the four grid
+ * points around the location, without evicting the current date. The grid
+ * attributes have to be set before the first sample.
+ */
+class SolarIrradianceField : public Object
+{
+public:
+  /**
+   * The irradiance terms of one location.
+   */
+  struct Irradiance
+  {
+    double incident; //!< I, the incident insolation [W/m^2]
+    double horizontalCos; //!< I cos(elevation) cos(zenith)
+    double horizontalSin; //!< I cos(elevation) sin(zenith)
+    double vertical; //!< I sin(elevation)
+  };
+
+  /**
+   * The weights of the Irradiance terms for a given panel orientation.
+   */
+  struct PanelWeights
+  {
+    double incident;
+    double horizontalCos;
+    double horizontalSin;
+    double vertical;
+  };
+
+  static TypeId GetTypeId (void);
+
+  SolarIrradianceField (void);
+  virtual ~SolarIrradianceField (void);
+
+  /**
+   * \param panelTiltAngle the panel tilt angle in degrees
+   * \param panelAzimuthAngle the panel azimuth angle in degrees
+   * \param diffusePercentage the diffuse energy percentage
+   * \return the weights turning an Irradiance into the insolation of the panel
+   */
+  static PanelWeights GetPanelWeights (double panelTiltAngle, double panelAzimuthAngle, double diffusePercentage);
+
+  /**
+   * \param date the date
+   * \param latitude the latitude
+   * \param longitude the longitude
+   * \param lookAhead if true, and date is not cached, evaluate the four grid
+   * points around the location instead of caching the grid of date
+   * \return the irradiance terms interpolated at the location
+   */
+  Irradiance Sample (const tm *date, double latitude, double longitude, bool lookAhead = false);
+
+  /**
+   * \param date the date
+   * \param latitude the latitude
+   * \param longitude the longitude
+   * \param weights the panel weights returned by GetPanelWeights
+   * \param lookAhead as in Sample
+   * \return the insolation on the panel plane in [W/m^2]
+   */
+  double GetPanelInsolation (const tm *date, double latitude, double longitude, const PanelWeights &weights,
+                             bool lookAhead = false);
+
+  /**
+   * \return the number of grid evaluations, i.e., of dates cached
+   */
+  uint64_t GetEvaluations (void) const;
+
+private:
+  /**
+   * A cached grid.
+   */
+  struct Grid
+  {
+    tm date; //!< The evaluated date
+    uint64_t lastUse; //!< The m_uses count of the last sample
+    std::vector<Irradiance> points; //!< Row-major, one row per latitude
+  };
+
+  /**
+   * Compute the grid latitudes, Air Mass factors and locations, once.
+   */
+  void Setup (void);
+
+  /**
+   * \return the cached grid of date, or 0
+   */
+  Grid* Find (const tm *date);
+
+  /**
+   * Evaluate the sun model at every grid point for date, in place of the
+   * least recently used grid, if date is not cached.
+   *
+   * \return the grid of date
+   */
+  Grid* Update (const tm *date);
+
+  static Irradiance Evaluate (const Sun::CelestialState &state, const Sun::Location &location, double airMass);
+
+private:
+  /** Input Parameter */
+  double m_minLatitude;
+  double m_maxLatitude;
+  double m_minLongitude;
+  double m_maxLongitude;
+  uint32_t m_latitudePoints;
+  uint32_t m_longitudePoints;
+  double m_altitude;
+  uint32_t m_cachedDates;
+
+  /** Internal Parameter */
+  std::vector<Grid> m_grids; // <- The cached grids, at most m_cachedDates
+  std::vector<double> m_airMass; // <- The Air Mass factor of every grid latitude
+  std::vector<Sun::Location> m_locations; // <- The PSA location terms of every grid point, row-major
+  uint64_t m_uses; // <- The number of samples of a cached grid
+  uint64_t m_evaluations;
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_IRRADIANCE_FIELD_H */
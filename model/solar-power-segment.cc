@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-power-segment.h"
+
+#include "ns3/assert.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+SolarPowerSegment::SolarPowerSegment ()
+{
+  std::fill (m_coefficients, m_coefficients + 4, 0.0);
+}
+
+SolarPowerSegment::SolarPowerSegment (Time start, Time end, double power)
+  : m_start (start),
+    m_end (end)
+{
+  NS_ASSERT (start <= end);
+  std::fill (m_coefficients, m_coefficients + 4, 0.0);
+  m_coefficients[0] = power;
+}
+
+SolarPowerSegment::SolarPowerSegment (Time start, Time end, const std::vector<double> &offsets,
+                                      const std::vector<double> &power)
+  : m_start (start),
+    m_end (end)
+{
+  NS_ASSERT (start <= end);
+  NS_ASSERT (offsets.size () == power.size () && !power.empty () && power.size () <= 4);
+  std::fill (m_coefficients, m_coefficients + 4, 0.0);
+
+  // Newton divided differences, then the Newton form expanded by Horner
+  size_t n = power.size ();
+  std::vector<double> difference (power);
+  for (size_t j = 1; j < n; ++j)
+    {
+      for (size_t i = n - 1; i >= j; --i)
+        {
+          difference[i] = (difference[i] - difference[i - 1]) / (offsets[i] - offsets[i - j]);
+        }
+    }
+
+  m_coefficients[0] = difference[n - 1];
+  for (size_t i = n - 1; i-- > 0; )
+    {
+      // multiply by (s - offsets[i]) and add difference[i]
+      for (size_t k = n - 1 - i; k > 0; --k)
+        {
+          m_coefficients[k] = m_coefficients[k - 1] - offsets[i] * m_coefficients[k];
+        }
+      m_coefficients[0] = difference[i] - offsets[i] * m_coefficients[0];
+    }
+}
+
+Time
+SolarPowerSegment::GetStart (void) const
+{
+  return m_start;
+}
+
+Time
+SolarPowerSegment::GetEnd (void) const
+{
+  return m_end;
+}
+
+double
+SolarPowerSegment::GetCoefficient (uint32_t i) const
+{
+  NS_ASSERT (i < 4);
+  return m_coefficients[i];
+}
+
+double
+SolarPowerSegment::GetPower (Time t) const
+{
+  double s = (std::min (std::max (t, m_start), m_end) - m_start).GetSeconds ();
+  return m_coefficients[0] + s * (m_coefficients[1] + s * (m_coefficients[2] + s * m_coefficients[3]));
+}
+
+double
+SolarPowerSegment::GetEnergy (Time t0, Time t1) const
+{
+  t0 = std::max (t0, m_start);
+  t1 = std::min (t1, m_end);
+  if (t1 <= t0)
+    {
+      return 0;
+    }
+  return GetIntegral ((t1 - m_start).GetSeconds ()) - GetIntegral ((t0 - m_start).GetSeconds ());
+}
+
+double
+SolarPowerSegment::GetIntegral (double seconds) const
+{
+  return seconds * (m_coefficients[0] + seconds * (m_coefficients[1] / 2
+                                                   + seconds * (m_coefficients[2] / 3 + seconds * m_coefficients[3] / 4)));
+}
+
+SolarPowerSegmentSink::~SolarPowerSegmentSink ()
+{
+}
+
+} // namespace ns3
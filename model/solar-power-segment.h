@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_POWER_SEGMENT_H
+#define SOLAR_POWER_SEGMENT_H
+
+#include "ns3/energy-harvester.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The power a harvester provides between two simulation times, as a
+ * polynomial, up to cubic, of the seconds elapsed since the start of the
+ * segment, so that its energy over any part of the segment is integrated
+ * exactly instead of summing constant power steps.
+ */
+class SolarPowerSegment
+{
+public:
+  /**
+   * An empty segment, providing no power
+   */
+  SolarPowerSegment ();
+
+  /**
+   * A segment of constant power
+   * \param start the start of the segment
+   * \param end the end of the segment
+   * \param power the power, in Watt
+   */
+  SolarPowerSegment (Time start, Time end, double power);
+
+  /**
+   * The polynomial interpolating the power at up to four instants of the segment
+   * \param start the start of the segment
+   * \param end the end of the segment
+   * \param offsets the distinct seconds elapsed since start of the instants
+   * \param power the power at the instants, in Watt
+   */
+  SolarPowerSegment (Time start, Time end, const std::vector<double> &offsets, const std::vector<double> &power);
+
+  /**
+   * TracedCallback signature for the power segments.
+   *
+   * \param segment the power from now to the end of the segment
+   */
+  typedef void (* TracedCallback)(const SolarPowerSegment &segment);
+
+  Time GetStart (void) const;
+  Time GetEnd (void) const;
+
+  /**
+   * \param i the degree of the term, up to 3
+   * \return the coefficient of the term, in W/s^i
+   */
+  double GetCoefficient (uint32_t i) const;
+
+  /**
+   * \param t a time, clamped to the segment
+   * \return the power at t, in Watt
+   */
+  double GetPower (Time t) const;
+
+  /**
+   * \param t0 the beginning of the interval
+   * \param t1 the end of the interval
+   * \return the energy provided in the part of [t0, t1] within the segment, in Joule
+   */
+  double GetEnergy (Time t0, Time t1) const;
+
+private:
+  /**
+   * \return the energy from the start of the segment to seconds after it, in Joule
+   */
+  double GetIntegral (double seconds) const;
+
+  Time m_start; // <- The start of the segment
+  Time m_end; // <- The end of the segment
+  double m_coefficients[4]; // <- The power is the sum of m_coefficients[i] * s^i, s being the seconds since m_start
+};
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The interface of the energy sources that understand power segments: a
+ * SolarEnergyHarvester whose PowerSegmentLength is positive notifies such a
+ * source once per segment, instead of calling UpdateEnergySource at every
+ * update, and keeps the periodic updates with any other source.
+ */
+class SolarPowerSegmentSink
+{
+public:
+  virtual ~SolarPowerSegmentSink ();
+
+  /**
+   * Called by harvester at the start of each of its segments, i.e., at the
+   * end of the previous one; the source accounts the energy of the previous
+   * segment up to now before replacing it.
+   *
+   * \param harvester the harvester
+   * \param segment the power of harvester from now to the end of the segment
+   */
+  virtual void NotifyPowerSegment (Ptr<EnergyHarvester> harvester, const SolarPowerSegment &segment) = 0;
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_POWER_SEGMENT_H */
@@ -0,0 +1,278 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-power-window.h"
+#include "solar-energy-profile.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarPowerWindow");
+
+/**
+ * The background worker filling the chunks requested by all the windows,
+ * in request order.
+ */
+class SolarPowerPrefetcher
+{
+public:
+  static SolarPowerPrefetcher& Instance (void)
+  {
+    static SolarPowerPrefetcher prefetcher;
+    return prefetcher;
+  }
+
+  void Request (SolarPowerWindow *window, int64_t chunk)
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_requests.push_back (std::make_pair (window, chunk));
+    m_wakeUp.notify_one ();
+  }
+
+  /**
+   * Drop the requests of window and wait until the worker is done with it.
+   */
+  void Cancel (SolarPowerWindow *window)
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    for (std::deque<Request_t>::iterator i = m_requests.begin (); i != m_requests.end (); )
+      {
+        i = i->first == window ? m_requests.erase (i) : i + 1;
+      }
+    while (m_busy == window)
+      {
+        m_done.wait (lock);
+      }
+  }
+
+private:
+  typedef std::pair<SolarPowerWindow *, int64_t> Request_t;
+
+  SolarPowerPrefetcher (void)
+    : m_busy (0),
+      m_stop (false)
+  {
+    m_thread = std::thread (&SolarPowerPrefetcher::Run, this);
+  }
+
+  ~SolarPowerPrefetcher (void)
+  {
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_stop = true;
+      m_wakeUp.notify_one ();
+    }
+    m_thread.join ();
+  }
+
+  void Run (void)
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    while (true)
+      {
+        while (!m_stop && m_requests.empty ())
+          {
+            m_wakeUp.wait (lock);
+          }
+        if (m_stop)
+          {
+            return;
+          }
+        Request_t request = m_requests.front ();
+        m_requests.pop_front ();
+        m_busy = request.first;
+
+        lock.unlock ();
+        request.first->Fill (request.second);
+        lock.lock ();
+
+        m_busy = 0;
+        m_done.notify_all ();
+      }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeUp; // <- A request arrived, or stop
+  std::condition_variable m_done; // <- A request has been processed
+  std::deque<Request_t> m_requests;
+  SolarPowerWindow *m_busy; // <- The window being filled
+  bool m_stop;
+  std::thread m_thread;
+};
+
+typedef std::map<std::string, Ptr<SolarPowerWindow> > WindowCache;
+
+/**
+ * The shared windows. The prefetcher is created first, so that it is
+ * destroyed after the cached windows, which cancel their requests.
+ */
+static WindowCache&
+GetWindowCache (void)
+{
+  SolarPowerPrefetcher::Instance ();
+  // a window has a single reader: windows are shared by the harvesters of
+  // a simulation, not across threads
+  static thread_local WindowCache windows;
+  return windows;
+}
+
+Ptr<SolarPowerWindow>
+SolarPowerWindow::Get (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step, uint64_t chunkSamples)
+{
+  NS_LOG_FUNCTION (step << chunkSamples);
+
+  std::ostringstream oss;
+  oss << SolarEnergyProfile::GetKey (panel, startDate, step) << " " << chunkSamples;
+
+  Ptr<SolarPowerWindow> &window = GetWindowCache ()[oss.str ()];
+  if (window == 0)
+    {
+      NS_LOG_DEBUG ("New window " << oss.str ());
+      window = Create<SolarPowerWindow> (panel, startDate, step, chunkSamples);
+    }
+  return window;
+}
+
+void
+SolarPowerWindow::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  WindowCache &windows = GetWindowCache ();
+  for (WindowCache::iterator i = windows.begin (); i != windows.end (); )
+    {
+      if (i->second->GetReferenceCount () == 1)
+        {
+          windows.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+SolarPowerWindow::SolarPowerWindow (const SolarEnergyHarvester::Panel &panel, const tm &startDate,
+                                    Time step, uint64_t chunkSamples)
+  : m_panel (panel),
+    m_dateStepS ((int) step.GetSeconds ()),
+    m_chunkSamples (chunkSamples),
+    m_current (-1),
+    m_fallbacks (0)
+{
+  NS_LOG_FUNCTION (this << step << chunkSamples);
+  NS_ASSERT (chunkSamples > 0);
+
+  SolarPowerPrefetcher::Instance ();
+
+  m_startDate = startDate;
+  for (int i = 0; i < 2; ++i)
+    {
+      m_buffer[i].resize (chunkSamples);
+      m_ready[i] = -1;
+    }
+}
+
+SolarPowerWindow::~SolarPowerWindow (void)
+{
+  NS_LOG_FUNCTION (this);
+  SolarPowerPrefetcher::Instance ().Cancel (this);
+}
+
+bool
+SolarPowerWindow::Matches (const SolarEnergyHarvester::Panel &panel) const
+{
+  return m_panel == panel;
+}
+
+bool
+SolarPowerWindow::GetPower (uint64_t sample, double &power)
+{
+  int64_t chunk = sample / m_chunkSamples;
+  int64_t current = m_current.load (std::memory_order_relaxed);
+
+  if (chunk > current)
+    {
+      // entering a new chunk: make sure it is coming, and prefetch the next
+      // one into the buffer of the previous chunk, no longer read
+      m_current.store (chunk, std::memory_order_relaxed);
+      if (chunk != current + 1 || m_ready[chunk % 2].load (std::memory_order_acquire) != chunk)
+        {
+          SolarPowerPrefetcher::Instance ().Request (this, chunk);
+        }
+      SolarPowerPrefetcher::Instance ().Request (this, chunk + 1);
+    }
+  else if (chunk < current)
+    {
+      // only the latest chunk is protected from the worker
+      ++m_fallbacks;
+      return false;
+    }
+
+  if (m_ready[chunk % 2].load (std::memory_order_acquire) != chunk)
+    {
+      ++m_fallbacks;
+      return false;
+    }
+  power = m_buffer[chunk % 2][sample % m_chunkSamples];
+  return true;
+}
+
+uint64_t
+SolarPowerWindow::GetFallbacks (void) const
+{
+  return m_fallbacks;
+}
+
+void
+SolarPowerWindow::Fill (int64_t chunk)
+{
+  int slot = chunk % 2;
+
+  // already there, or the reader has moved past it
+  if (m_ready[slot].load (std::memory_order_relaxed) == chunk
+      || chunk < m_current.load (std::memory_order_relaxed))
+    {
+      return;
+    }
+
+  m_ready[slot].store (-1, std::memory_order_relaxed);
+
+  std::vector<double> &buffer = m_buffer[slot];
+  uint64_t first = chunk * m_chunkSamples;
+  for (uint64_t i = 0; i < m_chunkSamples; ++i)
+    {
+      tm date = m_startDate;
+      Sun::AddSeconds (&date, (int64_t) (first + i) * m_dateStepS);
+      buffer[i] = SolarEnergyHarvester::CalculateHarvestedPower (&date, m_panel);
+    }
+
+  m_ready[slot].store (chunk, std::memory_order_release);
+}
+
+} // namespace ns3
@@ -0,0 +1,112 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_POWER_WINDOW_H
+#define SOLAR_POWER_WINDOW_H
+
+#include "ns3/solar-energy-harvester.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <ctime>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * A double-buffered window of the power a SolarEnergyHarvester provides at
+ * every update, for a given site and panel, starting date and update
+ * interval. Only two chunks of ChunkSamples updates are held: the current
+ * one, read by the simulator thread without locks, and the next one, filled
+ * by a background worker thread shared by all the windows as soon as the
+ * reader enters the current chunk.
+ *
+ * If the worker falls behind, GetPower fails and the caller computes the
+ * power synchronously; GetFallbacks counts these misses.
+ *
+ * Windows are shared through Get by all the harvesters with the same
+ * parameters; the reference count is only handled by the simulator thread.
+ * Only the latest chunk is readable, so the harvesters sharing a window
+ * should be started at the same time.
+ */
+class SolarPowerWindow : public SimpleRefCount<SolarPowerWindow>
+{
+public:
+  /**
+   * \param panel the site and panel parameters
+   * \param startDate the date of the first update
+   * \param step the harvested power update interval
+   * \param chunkSamples the number of updates of every chunk
+   * \return the shared window of these parameters, created if needed
+   */
+  static Ptr<SolarPowerWindow> Get (const SolarEnergyHarvester::Panel &panel, const tm &startDate,
+                                    Time step, uint64_t chunkSamples);
+
+  /**
+   * Release the windows not in use by any harvester.
+   */
+  static void ClearCache (void);
+
+  SolarPowerWindow (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step, uint64_t chunkSamples);
+  ~SolarPowerWindow (void);
+
+  /**
+   * \return true if the window has been built for these parameters
+   */
+  bool Matches (const SolarEnergyHarvester::Panel &panel) const;
+
+  /**
+   * \param sample the update index, 0 being the first update
+   * \param power the power provided after that update, in Watt
+   * \return false if the sample is not ready yet, or it precedes the latest
+   * chunk read
+   */
+  bool GetPower (uint64_t sample, double &power);
+
+  /**
+   * \return the number of GetPower calls that found the sample not ready
+   */
+  uint64_t GetFallbacks (void) const;
+
+  /**
+   * Fill the buffer of chunk; called by the worker thread.
+   */
+  void Fill (int64_t chunk);
+
+private:
+  SolarEnergyHarvester::Panel m_panel;
+  tm m_startDate; // <- The date of the first update
+  int m_dateStepS; // <- The date step of every update, as done by the harvester
+  uint64_t m_chunkSamples;
+
+  std::vector<double> m_buffer[2]; // <- Chunk c is stored in m_buffer[c % 2]
+  std::atomic<int64_t> m_ready[2]; // <- The chunk held by each buffer, -1 while being filled
+
+  std::atomic<int64_t> m_current; // <- The latest chunk read by GetPower
+  uint64_t m_fallbacks;
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_POWER_WINDOW_H */
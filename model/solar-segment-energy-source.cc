@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-segment-energy-source.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarSegmentEnergySource");
+
+NS_OBJECT_ENSURE_REGISTERED (SolarSegmentEnergySource);
+
+TypeId
+SolarSegmentEnergySource::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SolarSegmentEnergySource")
+    .SetParent<EnergySource> ()
+    .AddConstructor<SolarSegmentEnergySource> ()
+    .AddAttribute ("InitialEnergyJ",
+                   "The initial energy stored in the source, in Joule, by default 10 J",
+                   DoubleValue (10),
+                   MakeDoubleAccessor (&SolarSegmentEnergySource::SetInitialEnergy,
+                                       &SolarSegmentEnergySource::GetInitialEnergy),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("SupplyVoltageV",
+                   "The supply voltage, in Volt, by default 3 V",
+                   DoubleValue (3.0),
+                   MakeDoubleAccessor (&SolarSegmentEnergySource::SetSupplyVoltage,
+                                       &SolarSegmentEnergySource::GetSupplyVoltage),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("LowBatteryThreshold",
+                   "The fraction of the initial energy below which the source is depleted, by default 0.10",
+                   DoubleValue (0.10),
+                   MakeDoubleAccessor (&SolarSegmentEnergySource::m_lowBatteryTh),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("HighBatteryThreshold",
+                   "The fraction of the initial energy above which a depleted source is recharged, by default 0.15",
+                   DoubleValue (0.15),
+                   MakeDoubleAccessor (&SolarSegmentEnergySource::m_highBatteryTh),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddTraceSource ("RemainingEnergy",
+                     "The remaining energy, in Joule.",
+                     MakeTraceSourceAccessor (&SolarSegmentEnergySource::m_remainingEnergyJ),
+                     "ns3::TracedValue::DoubleCallback")
+  ;
+  return tid;
+}
+
+SolarSegmentEnergySource::SolarSegmentEnergySource ()
+  : m_initialEnergyJ (0),
+    m_supplyVoltageV (0),
+    m_lowBatteryTh (0.10),
+    m_highBatteryTh (0.15),
+    m_depleted (false),
+    m_lastUpdateTime (Seconds (0)),
+    m_updates (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+SolarSegmentEnergySource::~SolarSegmentEnergySource ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+SolarSegmentEnergySource::SetInitialEnergy (double initialEnergyJ)
+{
+  NS_LOG_FUNCTION (this << initialEnergyJ);
+  m_initialEnergyJ = initialEnergyJ;
+  m_remainingEnergyJ = initialEnergyJ;
+}
+
+void
+SolarSegmentEnergySource::SetSupplyVoltage (double supplyVoltageV)
+{
+  NS_LOG_FUNCTION (this << supplyVoltageV);
+  m_supplyVoltageV = supplyVoltageV;
+}
+
+double
+SolarSegmentEnergySource::GetInitialEnergy (void) const
+{
+  return m_initialEnergyJ;
+}
+
+double
+SolarSegmentEnergySource::GetSupplyVoltage (void) const
+{
+  return m_supplyVoltageV;
+}
+
+double
+SolarSegmentEnergySource::GetRemainingEnergy (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the energy up to now
+  UpdateEnergySource ();
+  return m_remainingEnergyJ;
+}
+
+double
+SolarSegmentEnergySource::GetEnergyFraction (void)
+{
+  NS_LOG_FUNCTION (this);
+  return GetRemainingEnergy () / m_initialEnergyJ;
+}
+
+uint64_t
+SolarSegmentEnergySource::GetUpdates (void) const
+{
+  return m_updates;
+}
+
+void
+SolarSegmentEnergySource::UpdateEnergySource (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // do not update if simulation has finished
+  if (Simulator::IsFinished ())
+    {
+      return;
+    }
+
+  CalculateRemainingEnergy ();
+
+  // a device calls UpdateEnergySource before changing state, so the next
+  // crossing is found once the state, at this same time, has changed
+  m_energyUpdateEvent.Cancel ();
+  m_energyUpdateEvent = Simulator::ScheduleNow (&SolarSegmentEnergySource::ScheduleThresholdCrossing, this);
+}
+
+void
+SolarSegmentEnergySource::NotifyPowerSegment (Ptr<EnergyHarvester> harvester, const SolarPowerSegment &segment)
+{
+  NS_LOG_FUNCTION (this << harvester << segment.GetStart () << segment.GetEnd ());
+
+  // the previous segment up to now, then the new one
+  UpdateEnergySource ();
+  m_segments[PeekPointer (harvester)] = segment;
+}
+
+void
+SolarSegmentEnergySource::DoInitialize (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lastUpdateTime = Simulator::Now ();
+  UpdateEnergySource ();
+}
+
+void
+SolarSegmentEnergySource::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_energyUpdateEvent.Cancel ();
+  m_segments.clear ();
+  BreakDeviceEnergyModelRefCycle ();
+}
+
+void
+SolarSegmentEnergySource::CalculateRemainingEnergy (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  NS_ASSERT (now >= m_lastUpdateTime);
+
+  // as BasicEnergySource, the power of the devices at the update holds since the last one
+  double energyJ = GetConstantPower () * (now - m_lastUpdateTime).GetSeconds ();
+  for (std::map<const EnergyHarvester *, SolarPowerSegment>::const_iterator i = m_segments.begin ();
+       i != m_segments.end (); ++i)
+    {
+      energyJ += i->second.GetEnergy (m_lastUpdateTime, now);
+    }
+  m_lastUpdateTime = now;
+  ++m_updates;
+
+  // as BasicEnergySource, never below zero
+  double remainingEnergyJ = m_remainingEnergyJ;
+  m_remainingEnergyJ = std::max (m_remainingEnergyJ + energyJ, 0.0);
+  NS_LOG_DEBUG ("SolarSegmentEnergySource: remaining energy = " << m_remainingEnergyJ);
+
+  if (!m_depleted && m_remainingEnergyJ <= m_lowBatteryTh * m_initialEnergyJ)
+    {
+      m_depleted = true;
+      NS_LOG_DEBUG ("SolarSegmentEnergySource: energy depleted");
+      NotifyEnergyDrained ();
+    }
+  else if (m_depleted && m_remainingEnergyJ > m_highBatteryTh * m_initialEnergyJ)
+    {
+      m_depleted = false;
+      NS_LOG_DEBUG ("SolarSegmentEnergySource: energy recharged");
+      NotifyEnergyRecharged ();
+    }
+  else if (m_remainingEnergyJ != remainingEnergyJ)
+    {
+      NotifyEnergyChanged ();
+    }
+}
+
+double
+SolarSegmentEnergySource::GetConstantPower (void)
+{
+  // CalculateTotalCurrent subtracts the power of all the harvesters: the
+  // ones publishing segments are added back, being integrated separately
+  double power = -CalculateTotalCurrent () * m_supplyVoltageV;
+  for (std::map<const EnergyHarvester *, SolarPowerSegment>::const_iterator i = m_segments.begin ();
+       i != m_segments.end (); ++i)
+    {
+      power -= i->first->GetPower ();
+    }
+  return power;
+}
+
+double
+SolarSegmentEnergySource::GetEnergyAfter (double seconds, double constantPower) const
+{
+  Time now = Simulator::Now ();
+  Time then = now + Seconds (seconds);
+  double energyJ = m_remainingEnergyJ + constantPower * seconds;
+  for (std::map<const EnergyHarvester *, SolarPowerSegment>::const_iterator i = m_segments.begin ();
+       i != m_segments.end (); ++i)
+    {
+      energyJ += i->second.GetEnergy (now, then);
+    }
+  return energyJ;
+}
+
+void
+SolarSegmentEnergySource::ScheduleThresholdCrossing (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  double constantPower = GetConstantPower ();
+  double threshold = (m_depleted ? m_highBatteryTh : m_lowBatteryTh) * m_initialEnergyJ;
+
+  // the crossing is looked for up to the end of the first segment to end,
+  // whose harvester notifies a new one then
+  Time end = Time::Max ();
+  for (std::map<const EnergyHarvester *, SolarPowerSegment>::const_iterator i = m_segments.begin ();
+       i != m_segments.end (); ++i)
+    {
+      if (i->second.GetEnd () > now)
+        {
+          end = std::min (end, i->second.GetEnd ());
+        }
+    }
+
+  double seconds = -1;
+  if (end == Time::Max ())
+    {
+      // constant power
+      double energyJ = m_remainingEnergyJ;
+      if ((m_depleted && constantPower > 0) || (!m_depleted && constantPower < 0))
+        {
+          seconds = (threshold - energyJ) / constantPower;
+        }
+    }
+  else
+    {
+      // a coarse scan, refined by bisection
+      const int steps = 16;
+      double horizon = (end - now).GetSeconds ();
+      double low = 0;
+      for (int k = 1; k <= steps && seconds < 0; ++k)
+        {
+          double high = horizon * k / steps;
+          double energyJ = GetEnergyAfter (high, constantPower);
+          if (m_depleted ? energyJ > threshold : energyJ <= threshold)
+            {
+              for (int j = 0; j < 50; ++j)
+                {
+                  double middle = (low + high) / 2;
+                  energyJ = GetEnergyAfter (middle, constantPower);
+                  if (m_depleted ? energyJ > threshold : energyJ <= threshold)
+                    {
+                      high = middle;
+                    }
+                  else
+                    {
+                      low = middle;
+                    }
+                }
+              seconds = high;
+            }
+          else
+            {
+              low = high;
+            }
+        }
+    }
+
+  if (seconds >= 0)
+    {
+      // rounded up, so that the update finds the threshold crossed
+      Time delay = NanoSeconds ((int64_t) ceil (seconds * 1e9) + 1);
+      NS_LOG_DEBUG ("SolarSegmentEnergySource: threshold " << threshold << " J crossed in " << delay);
+      m_energyUpdateEvent = Simulator::Schedule (delay, &SolarSegmentEnergySource::UpdateEnergySource, this);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_SEGMENT_ENERGY_SOURCE_H
+#define SOLAR_SEGMENT_ENERGY_SOURCE_H
+
+#include "ns3/solar-power-segment.h"
+#include "ns3/energy-source.h"
+#include "ns3/traced-value.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * An ideal energy source, as BasicEnergySource, that integrates the power
+ * segments of its harvesters exactly. The devices and the harvesters that
+ * do not publish segments are accounted as by BasicEnergySource, i.e., at
+ * constant power between two UpdateEnergySource calls.
+ *
+ * Instead of updating periodically, the source finds ahead of time, on
+ * the current segments, when the remaining energy crosses the low battery
+ * threshold (or the high one, once depleted), and updates only then, at
+ * the segment boundaries and when a device changes state.
+ */
+class SolarSegmentEnergySource : public EnergySource, public SolarPowerSegmentSink
+{
+public:
+  static TypeId GetTypeId (void);
+
+  SolarSegmentEnergySource ();
+  virtual ~SolarSegmentEnergySource ();
+
+  /// Defined in ns3::EnergySource
+  virtual double GetInitialEnergy (void) const;
+  /// Defined in ns3::EnergySource
+  virtual double GetSupplyVoltage (void) const;
+  /// Defined in ns3::EnergySource
+  virtual double GetRemainingEnergy (void);
+  /// Defined in ns3::EnergySource
+  virtual double GetEnergyFraction (void);
+  /// Defined in ns3::EnergySource
+  virtual void UpdateEnergySource (void);
+
+  /// Defined in ns3::SolarPowerSegmentSink
+  virtual void NotifyPowerSegment (Ptr<EnergyHarvester> harvester, const SolarPowerSegment &segment);
+
+  void SetInitialEnergy (double initialEnergyJ);
+  void SetSupplyVoltage (double supplyVoltageV);
+
+  /**
+   * \return the number of updates of the remaining energy
+   */
+  uint64_t GetUpdates (void) const;
+
+private:
+  /// Defined in ns3::Object
+  void DoInitialize (void);
+
+  /// Defined in ns3::Object
+  void DoDispose (void);
+
+  /**
+   * Account the energy from the last update to now, and notify the
+   * devices if a battery threshold has been crossed.
+   */
+  void CalculateRemainingEnergy (void);
+
+  /**
+   * \return the power of the devices and of the harvesters without segments, in Watt, negative if drawn
+   */
+  double GetConstantPower (void);
+
+  /**
+   * \param seconds the time from now
+   * \param constantPower the result of GetConstantPower
+   * \return the remaining energy at seconds from now, in Joule
+   */
+  double GetEnergyAfter (double seconds, double constantPower) const;
+
+  /**
+   * Schedule an update at the next battery threshold crossing, if any
+   * before the end of the current segments.
+   */
+  void ScheduleThresholdCrossing (void);
+
+  double m_initialEnergyJ; // <- The initial energy, in Joule
+  double m_supplyVoltageV; // <- The supply voltage, in Volt
+  double m_lowBatteryTh; // <- The low battery threshold, as a fraction of the initial energy
+  double m_highBatteryTh; // <- The high battery threshold, as a fraction of the initial energy
+  bool m_depleted; // <- The remaining energy went below the low battery threshold and not yet above the high one
+  TracedValue<double> m_remainingEnergyJ; // <- The remaining energy, in Joule
+  std::map<const EnergyHarvester *, SolarPowerSegment> m_segments; // <- The current segment of every harvester publishing them
+  EventId m_energyUpdateEvent; // <- The update at the next threshold crossing
+  Time m_lastUpdateTime; // <- The time of the last update
+  uint64_t m_updates; // <- The number of updates
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_SEGMENT_ENERGY_SOURCE_H */
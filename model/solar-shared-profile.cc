@@ -0,0 +1,453 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-shared-profile.h"
+#include "solar-energy-profile.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarSharedProfile");
+
+static_assert (ATOMIC_INT_LOCK_FREE == 2, "The ready flag is shared among processes");
+static_assert (ATOMIC_LLONG_LOCK_FREE == 2, "The filled count is shared among processes");
+static_assert (sizeof (SolarSharedProfile::Header) % sizeof (double) == 0, "The power follows the header");
+
+const int SolarSharedProfile::STALE_TIMEOUT_S;
+const char SolarSharedProfile::MAGIC[8] = "SHPROF";
+
+typedef std::map<std::string, Ptr<SolarSharedProfile> > SharedProfileCache;
+
+static SharedProfileCache g_sharedProfiles;
+static std::mutex g_sharedProfilesMutex;
+
+/**
+ * \return the key of the parameters, stored in the segment
+ */
+static std::string
+GetSegmentKey (const SolarEnergyHarvester::Panel &panel, const tm &startDate, Time step, uint64_t samples)
+{
+  std::ostringstream oss;
+  oss << SolarEnergyProfile::GetKey (panel, startDate, step) << " " << samples;
+  return oss.str ();
+}
+
+/**
+ * \return the name of the segment of key
+ */
+static std::string
+GetSegmentName (const std::string &prefix, const std::string &key)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (std::string::const_iterator i = key.begin (); i != key.end (); ++i)
+    {
+      hash = (hash ^ (unsigned char) *i) * 1099511628211ULL;
+    }
+  char name[17];
+  snprintf (name, sizeof (name), "%016llx", (unsigned long long) hash);
+  return prefix + "-" + name;
+}
+
+std::string
+SolarSharedProfile::GetSegmentName (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                                    const tm &startDate, Time step, uint64_t samples)
+{
+  return ns3::GetSegmentName (prefix, GetSegmentKey (panel, startDate, step, samples));
+}
+
+Ptr<SolarSharedProfile>
+SolarSharedProfile::Get (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                         const tm &startDate, Time step, uint64_t samples, bool keep)
+{
+  NS_LOG_FUNCTION (prefix << step << samples << keep);
+
+  std::string name = GetSegmentName (prefix, panel, startDate, step, samples);
+  std::lock_guard<std::mutex> lock (g_sharedProfilesMutex);
+  Ptr<SolarSharedProfile> &profile = g_sharedProfiles[name];
+  if (profile == 0)
+    {
+      profile = Create<SolarSharedProfile> (prefix, panel, startDate, step, samples, keep);
+    }
+  return profile;
+}
+
+void
+SolarSharedProfile::Remove (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                            const tm &startDate, Time step, uint64_t samples)
+{
+  NS_LOG_FUNCTION (prefix << step << samples);
+  shm_unlink (GetSegmentName (prefix, panel, startDate, step, samples).c_str ());
+}
+
+void
+SolarSharedProfile::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  std::lock_guard<std::mutex> lock (g_sharedProfilesMutex);
+  for (SharedProfileCache::iterator i = g_sharedProfiles.begin (); i != g_sharedProfiles.end (); )
+    {
+      if (i->second->GetReferenceCount () == 1)
+        {
+          g_sharedProfiles.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+SolarSharedProfile::SolarSharedProfile (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                                        const tm &startDate, Time step, uint64_t samples, bool keep)
+  : m_panel (panel),
+    m_count (1),
+    m_startDate (startDate),
+    m_dateStepS ((int) step.GetSeconds ()),
+    m_samples (samples),
+    m_keep (keep),
+    m_fd (-1),
+    m_map (MAP_FAILED),
+    m_mapSize (sizeof (Header) + samples * sizeof (double)),
+    m_power (0),
+    m_blockSamples (std::max (1, SECONDS_IN_DAY / std::max (1, m_dateStepS))),
+    m_creator (false)
+{
+  NS_LOG_FUNCTION (this << prefix << step << samples << keep);
+  NS_ASSERT (step.IsStrictlyPositive ());
+  NS_ABORT_MSG_UNLESS (!prefix.empty () && prefix[0] == '/', "SolarSharedProfile: the segment prefix must start with '/'");
+
+  std::string key = GetSegmentKey (panel, startDate, step, samples);
+  NS_ABORT_MSG_UNLESS (key.size () < sizeof (Header::key), "SolarSharedProfile: key too long");
+  std::string name = ns3::GetSegmentName (prefix, key);
+  m_name = name;
+
+  // AttachSegment removes a stale segment, so that one more CreateSegment
+  // can replace it
+  for (int attempt = 0; attempt < 2 && m_power == 0; ++attempt)
+    {
+      if (!CreateSegment (name, key))
+        {
+          AttachSegment (name, key);
+        }
+    }
+
+  if (m_power == 0)
+    {
+      NS_LOG_WARN ("Shared memory segment " << name << " not available, computing the profile in private memory");
+      m_blocks.resize ((m_samples + m_blockSamples - 1) / m_blockSamples);
+    }
+}
+
+SolarSharedProfile::~SolarSharedProfile ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_map != MAP_FAILED)
+    {
+      munmap (m_map, m_mapSize);
+    }
+  if (m_fd < 0)
+    {
+      return;
+    }
+
+  // no other profile holds the segment: remove it, unless the name has
+  // been given to another segment in the meantime
+  if (!m_keep && flock (m_fd, LOCK_EX | LOCK_NB) == 0)
+    {
+      int fd = shm_open (m_name.c_str (), O_RDONLY, 0);
+      struct stat mine;
+      struct stat named;
+      if (fd >= 0 && fstat (m_fd, &mine) == 0 && fstat (fd, &named) == 0
+          && mine.st_dev == named.st_dev && mine.st_ino == named.st_ino)
+        {
+          NS_LOG_DEBUG ("Removing " << m_name << ", released by all the profiles");
+          shm_unlink (m_name.c_str ());
+        }
+      if (fd >= 0)
+        {
+          close (fd);
+        }
+    }
+  close (m_fd);
+}
+
+bool
+SolarSharedProfile::CreateSegment (const std::string &name, const std::string &key)
+{
+  NS_LOG_FUNCTION (this << name);
+
+  int fd = shm_open (name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    {
+      if (errno != EEXIST)
+        {
+          NS_LOG_WARN ("Cannot create " << name << ": " << strerror (errno));
+        }
+      return false;
+    }
+
+  // the pages are allocated up front: writing to a sparse segment on a
+  // full file system would raise SIGBUS
+  void *map = MAP_FAILED;
+  int error = posix_fallocate (fd, 0, m_mapSize);
+  if (error == 0)
+    {
+      map = mmap (0, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      error = errno;
+    }
+  if (map == MAP_FAILED)
+    {
+      close (fd);
+      NS_LOG_WARN ("Cannot allocate " << name << ": " << strerror (error));
+      shm_unlink (name.c_str ());
+      return false;
+    }
+  Hold (fd);
+
+  // the segment is zeroed on allocation, the ready flag and count included
+  Header *header = static_cast<Header *> (map);
+  memcpy (header->magic, MAGIC, sizeof (MAGIC));
+  header->version = VERSION;
+  header->samples = m_samples;
+  strncpy (header->key, key.c_str (), sizeof (header->key) - 1);
+  Fill (reinterpret_cast<double *> (header + 1), 0, m_samples, &header->filled);
+  header->ready.store (1, std::memory_order_release);
+  mprotect (map, m_mapSize, PROT_READ);
+
+  NS_LOG_DEBUG ("Created " << name << ", " << m_samples << " updates");
+  m_map = map;
+  m_power = reinterpret_cast<const double *> (header + 1);
+  m_creator = true;
+  return true;
+}
+
+bool
+SolarSharedProfile::AttachSegment (const std::string &name, const std::string &key)
+{
+  NS_LOG_FUNCTION (this << name);
+
+  int fd = shm_open (name.c_str (), O_RDONLY, 0);
+  if (fd < 0)
+    {
+      return false;
+    }
+
+  // the creator sizes the segment right after creating it: if it does not
+  // within the timeout, it died in between
+  struct stat st;
+  for (int wait = 0; fstat (fd, &st) == 0 && st.st_size == 0; ++wait)
+    {
+      if (wait == STALE_TIMEOUT_S * 1000)
+        {
+          NS_LOG_WARN ("Removing the stale segment " << name);
+          shm_unlink (name.c_str ());
+          close (fd);
+          return false;
+        }
+      usleep (1000);
+    }
+  if ((size_t) st.st_size != m_mapSize)
+    {
+      NS_LOG_WARN ("The segment " << name << " has not the expected size");
+      close (fd);
+      return false;
+    }
+
+  void *map = mmap (0, m_mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      close (fd);
+      return false;
+    }
+
+  // the creator may be in another PID namespace: it is alive as long as
+  // the filled count advances
+  const Header *header = static_cast<const Header *> (map);
+  uint64_t filled = header->filled.load (std::memory_order_relaxed);
+  std::chrono::steady_clock::time_point progress = std::chrono::steady_clock::now ();
+  while (header->ready.load (std::memory_order_acquire) == 0)
+    {
+      uint64_t now = header->filled.load (std::memory_order_relaxed);
+      if (now != filled)
+        {
+          filled = now;
+          progress = std::chrono::steady_clock::now ();
+        }
+      else if (std::chrono::steady_clock::now () - progress > std::chrono::seconds (STALE_TIMEOUT_S))
+        {
+          NS_LOG_WARN ("The creator of " << name << " stopped filling it, removing the segment");
+          shm_unlink (name.c_str ());
+          munmap (map, m_mapSize);
+          close (fd);
+          return false;
+        }
+      usleep (1000);
+    }
+
+  if (memcmp (header->magic, MAGIC, sizeof (MAGIC)) != 0 || header->version != VERSION
+      || header->samples != m_samples || key != header->key)
+    {
+      NS_LOG_WARN ("The segment " << name << " holds another profile");
+      munmap (map, m_mapSize);
+      close (fd);
+      return false;
+    }
+
+  NS_LOG_DEBUG ("Attached to " << name << ", " << m_samples << " updates");
+  Hold (fd);
+  m_map = map;
+  m_power = reinterpret_cast<const double *> (header + 1);
+  return true;
+}
+
+void
+SolarSharedProfile::Hold (int fd)
+{
+  // released by the destructor, or by the exit of the process
+  if (flock (fd, LOCK_SH) != 0)
+    {
+      NS_LOG_WARN ("Cannot lock " << m_name << ": " << strerror (errno));
+    }
+  m_fd = fd;
+}
+
+void
+SolarSharedProfile::Fill (double *power, uint64_t offset, uint64_t count, std::atomic<uint64_t> *filled) const
+{
+  // the same dates UpdateHarvestedPower steps through, split among the cores
+  uint64_t nThreads = std::max (1U, std::thread::hardware_concurrency ());
+  nThreads = std::min<uint64_t> (nThreads, count / 1024 + 1);
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < nThreads; ++t)
+    {
+      uint64_t first = count * t / nThreads;
+      uint64_t last = count * (t + 1) / nThreads;
+      threads.push_back (std::thread ([this, power, offset, filled, first, last] ()
+        {
+          tm date = m_startDate;
+          Sun::AddSeconds (&date, (int64_t) (offset + first) * m_dateStepS);
+          for (uint64_t i = first; i < last; ++i)
+            {
+              power[i] = SolarEnergyHarvester::CalculateHarvestedPower (&date, m_panel);
+              Sun::AddSeconds (&date, m_dateStepS);
+              if (filled != 0 && (i - first) % 1024 == 1023)
+                {
+                  filled->fetch_add (1024, std::memory_order_relaxed);
+                }
+            }
+        }));
+    }
+  for (uint64_t t = 0; t < nThreads; ++t)
+    {
+      threads[t].join ();
+    }
+}
+
+bool
+SolarSharedProfile::Matches (const SolarEnergyHarvester::Panel &panel) const
+{
+  return m_panel == panel;
+}
+
+bool
+SolarSharedProfile::GetPower (uint64_t sample, double &power) const
+{
+  if (sample >= m_samples)
+    {
+      return false;
+    }
+  if (m_power != 0)
+    {
+      power = m_power[sample];
+      return true;
+    }
+
+  // in private memory, the day of sample is computed when first read
+  std::lock_guard<std::mutex> lock (m_blocksMutex);
+  std::vector<double> &block = m_blocks[sample / m_blockSamples];
+  if (block.empty ())
+    {
+      uint64_t first = sample - sample % m_blockSamples;
+      block.resize (std::min (m_blockSamples, m_samples - first));
+      Fill (block.data (), first, block.size (), 0);
+    }
+  power = block[sample % m_blockSamples];
+  return true;
+}
+
+uint64_t
+SolarSharedProfile::GetSamples (void) const
+{
+  return m_samples;
+}
+
+bool
+SolarSharedProfile::IsShared (void) const
+{
+  return m_map != MAP_FAILED;
+}
+
+bool
+SolarSharedProfile::IsCreator (void) const
+{
+  return m_creator;
+}
+
+void
+SolarSharedProfile::Ref (void) const
+{
+  m_count.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+SolarSharedProfile::Unref (void) const
+{
+  if (m_count.fetch_sub (1, std::memory_order_acq_rel) == 1)
+    {
+      delete this;
+    }
+}
+
+uint32_t
+SolarSharedProfile::GetReferenceCount (void) const
+{
+  return m_count.load (std::memory_order_relaxed);
+}
+
+} // namespace ns3
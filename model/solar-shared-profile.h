@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_SHARED_PROFILE_H
+#define SOLAR_SHARED_PROFILE_H
+
+#include "ns3/solar-energy-harvester.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The power a SolarEnergyHarvester provides at every update, for a given
+ * site and panel, starting date and update interval, precomputed for a
+ * fixed number of updates in a named POSIX shared memory segment, so that
+ * the simulations running on the same host compute and hold it once.
+ *
+ * The segment name is the given prefix followed by a hash of the
+ * parameters. The first process creates the segment exclusively
+ * (O_CREAT | O_EXCL), which is the lock: it allocates it, fills it on all
+ * the cores, counting the updates filled as it goes, and then sets the
+ * ready flag. The other processes map it read-only and wait for the flag;
+ * if the count does not advance for StaleTimeout, the creating process is
+ * taken as dead (whatever its PID namespace), the stale segment is removed
+ * and the profile computed in private memory, as when shared memory is not
+ * available or full. In private memory, the power is computed one day of
+ * updates at a time, when first read, as in SolarEnergyProfile.
+ *
+ * Every profile mapping a segment holds a shared flock on it; the last one
+ * to release it, i.e., the one that gets the exclusive lock, removes the
+ * segment, unless the profile keeps it. Kept segments outlive the
+ * processes, so that later runs start without computing them, until Remove
+ * is called or the host is restarted (on Linux, they are the files under
+ * /dev/shm); so do the segments of the processes that did not exit
+ * cleanly. Within a process, profiles are shared through Get as the energy
+ * profiles.
+ */
+class SolarSharedProfile
+{
+public:
+  /**
+   * The segment header, followed by the power of every update, in Watt
+   */
+  struct Header
+  {
+    char magic[8]; //!< "SHPROF", NUL terminated
+    uint32_t version; //!< 2
+    std::atomic<uint32_t> ready; //!< Set when the power is filled
+    std::atomic<uint64_t> filled; //!< The updates filled so far, the heartbeat of the creator
+    uint64_t samples; //!< The number of updates
+    char key[512]; //!< SolarEnergyProfile::GetKey of the parameters and samples, NUL terminated
+  };
+
+  static const char MAGIC[8];
+  static const uint32_t VERSION = 2;
+  /// The seconds without progress of the creator after which a segment is stale
+  static const int STALE_TIMEOUT_S = 10;
+
+  /**
+   * \param prefix the segment name prefix, starting with '/'
+   * \param panel the site and panel parameters
+   * \param startDate the date of the first update
+   * \param step the harvested power update interval
+   * \param samples the number of updates
+   * \param keep if true, the segment is not removed when the last profile releases it
+   * \return the shared profile of these parameters, attached to or created if needed
+   */
+  static Ptr<SolarSharedProfile> Get (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                                      const tm &startDate, Time step, uint64_t samples, bool keep = false);
+
+  /**
+   * \return the name of the segment of these parameters
+   */
+  static std::string GetSegmentName (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                                     const tm &startDate, Time step, uint64_t samples);
+
+  /**
+   * Remove the segment of these parameters from the host. The processes
+   * attached to it keep their mapping.
+   */
+  static void Remove (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                      const tm &startDate, Time step, uint64_t samples);
+
+  /**
+   * Release the profiles not in use by any harvester of this process.
+   */
+  static void ClearCache (void);
+
+  SolarSharedProfile (const std::string &prefix, const SolarEnergyHarvester::Panel &panel,
+                      const tm &startDate, Time step, uint64_t samples, bool keep = false);
+  ~SolarSharedProfile ();
+
+  /**
+   * \return true if the profile has been built for these parameters
+   */
+  bool Matches (const SolarEnergyHarvester::Panel &panel) const;
+
+  /**
+   * \param sample the update index, 0 being the first update
+   * \param power the power provided after that update, in Watt
+   * \return false if sample is beyond the profile
+   */
+  bool GetPower (uint64_t sample, double &power) const;
+
+  uint64_t GetSamples (void) const;
+
+  /**
+   * \return true if the power is in a shared memory segment, false if it
+   * has been computed in private memory
+   */
+  bool IsShared (void) const;
+
+  /**
+   * \return true if this process filled the segment
+   */
+  bool IsCreator (void) const;
+
+  /// Used by Ptr
+  void Ref (void) const;
+  /// Used by Ptr
+  void Unref (void) const;
+  uint32_t GetReferenceCount (void) const;
+
+private:
+  /**
+   * Create and fill the segment
+   * \return false if it already exists, or cannot be allocated
+   */
+  bool CreateSegment (const std::string &name, const std::string &key);
+
+  /**
+   * Attach to the segment, waiting until it is ready
+   * \return false if it does not exist, or its creator stopped filling it
+   */
+  bool AttachSegment (const std::string &name, const std::string &key);
+
+  /**
+   * Take a shared lock on the segment, held until the profile is destroyed
+   * \param fd the segment descriptor, closed on destruction
+   */
+  void Hold (int fd);
+
+  /**
+   * Compute the power of some updates into power, on all the cores
+   * \param power the power of the updates
+   * \param offset the index of the first update
+   * \param count the number of updates
+   * \param filled if not null, incremented as the updates are filled
+   */
+  void Fill (double *power, uint64_t offset, uint64_t count, std::atomic<uint64_t> *filled) const;
+
+  SolarEnergyHarvester::Panel m_panel;
+  mutable std::atomic<uint32_t> m_count; // <- The reference count
+  tm m_startDate; // <- The date of the first update
+  int m_dateStepS; // <- Seconds added to the date at every update, truncated as the harvester does
+  uint64_t m_samples; // <- The number of updates
+  std::string m_name; // <- The segment name
+  bool m_keep; // <- The segment is not removed on release
+  int m_fd; // <- The segment descriptor holding the shared lock, or -1
+  void *m_map; // <- The mapped segment, if shared
+  size_t m_mapSize; // <- The mapped bytes
+  const double *m_power; // <- The power of every update in the segment, if shared
+  uint64_t m_blockSamples; // <- The updates of a private block, one day
+  mutable std::vector<std::vector<double> > m_blocks; // <- The power of every update, if not shared, filled per block on demand
+  mutable std::mutex m_blocksMutex; // <- Guards m_blocks, shared by the harvesters of all the threads
+  bool m_creator; // <- This process filled the segment
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_SHARED_PROFILE_H */
@@ -0,0 +1,192 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include "solar-sun-track.h"
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SolarSunTrack");
+
+SolarSunTrack::SolarSunTrack (const SolarEnergyHarvester::Panel &panel, const tm &startDate, int64_t knotSpacing)
+  : m_panel (panel),
+    m_startDate (startDate),
+    m_knotSpacing (knotSpacing),
+    m_day (-1),
+    m_segment (0)
+{
+  NS_LOG_FUNCTION (this << knotSpacing);
+  NS_ASSERT (knotSpacing > 0);
+
+  m_weights = SolarIrradianceField::GetPanelWeights (panel.panelTiltAngle, panel.panelAzimuthAngle, panel.diffusePercentage);
+  m_scale = (panel.solarCellEfficiency / 100) * (panel.dcdcEfficiency / 100) * panel.panelDimension;
+}
+
+bool
+SolarSunTrack::Matches (const SolarEnergyHarvester::Panel &panel, int64_t knotSpacing) const
+{
+  return m_panel == panel && m_knotSpacing == knotSpacing;
+}
+
+double
+SolarSunTrack::GetPower (double seconds)
+{
+  int64_t day = (int64_t) std::floor (seconds / SECONDS_IN_DAY);
+  if (day != m_day)
+    {
+      Build (day);
+    }
+
+  // the segment [m_knots[m_segment], m_knots[m_segment + 1]] holding seconds
+  if (seconds < m_knots[m_segment].time || seconds > m_knots[m_segment + 1].time)
+    {
+      m_segment = m_knots.size () - 2;
+      for (size_t i = 1; i < m_knots.size (); ++i)
+        {
+          if (seconds <= m_knots[i].time)
+            {
+              m_segment = i - 1;
+              break;
+            }
+        }
+    }
+
+  const Knot &a = m_knots[m_segment];
+  const Knot &b = m_knots[m_segment + 1];
+  double h = b.time - a.time;
+  double u = (seconds - a.time) / h;
+  double u2 = u * u;
+  double u3 = u2 * u;
+  double h00 = 2 * u3 - 3 * u2 + 1;
+  double h10 = (u3 - 2 * u2 + u) * h;
+  double h01 = -2 * u3 + 3 * u2;
+  double h11 = (u3 - u2) * h;
+
+  double terms[4];
+  for (int i = 0; i < 4; ++i)
+    {
+      terms[i] = h00 * a.terms[i] + h10 * a.slopes[i] + h01 * b.terms[i] + h11 * b.slopes[i];
+    }
+  if (terms[0] <= 0)
+    {
+      return 0;
+    }
+
+  double insolation = m_weights.incident * terms[0] + m_weights.horizontalCos * terms[1]
+    + m_weights.horizontalSin * terms[2] + m_weights.vertical * terms[3];
+  return insolation * m_scale;
+}
+
+void
+SolarSunTrack::Build (int64_t day)
+{
+  NS_LOG_FUNCTION (this << day);
+
+  int64_t begin = day * SECONDS_IN_DAY;
+  int64_t end = begin + SECONDS_IN_DAY;
+  int64_t first = (int64_t) std::floor ((double) begin / m_knotSpacing) - 1;
+  int64_t last = (int64_t) std::ceil ((double) end / m_knotSpacing) + 1;
+
+  m_knots.clear ();
+  for (int64_t k = first; k <= last; ++k)
+    {
+      Knot knot = Evaluate (k * m_knotSpacing);
+      if (!m_knots.empty () && (m_knots.back ().terms[0] > 0) != (knot.terms[0] > 0))
+        {
+          // sunrise or sunset: the first second on the side of knot
+          int64_t low = m_knots.back ().time;
+          int64_t high = knot.time;
+          while (high - low > 1)
+            {
+              int64_t middle = low + (high - low) / 2;
+              if ((Evaluate (middle).terms[0] > 0) == (knot.terms[0] > 0))
+                {
+                  high = middle;
+                }
+              else
+                {
+                  low = middle;
+                }
+            }
+          if (high != knot.time)
+            {
+              m_knots.push_back (Evaluate (high));
+            }
+        }
+      m_knots.push_back (knot);
+    }
+
+  // finite difference slopes, weighted for the uneven knots around sunrise
+  // and sunset; one-sided at the ends
+  size_t n = m_knots.size ();
+  for (size_t k = 0; k < n; ++k)
+    {
+      for (int i = 0; i < 4; ++i)
+        {
+          if (k == 0 || k == n - 1)
+            {
+              size_t a = k == 0 ? 0 : n - 2;
+              m_knots[k].slopes[i] = (m_knots[a + 1].terms[i] - m_knots[a].terms[i])
+                / (m_knots[a + 1].time - m_knots[a].time);
+              continue;
+            }
+          double h0 = m_knots[k].time - m_knots[k - 1].time;
+          double h1 = m_knots[k + 1].time - m_knots[k].time;
+          double d0 = (m_knots[k].terms[i] - m_knots[k - 1].terms[i]) / h0;
+          double d1 = (m_knots[k + 1].terms[i] - m_knots[k].terms[i]) / h1;
+          m_knots[k].slopes[i] = (h1 * d0 + h0 * d1) / (h0 + h1);
+        }
+    }
+
+  m_day = day;
+  m_segment = 0;
+  NS_LOG_DEBUG ("Day " << day << ": " << n << " knots");
+}
+
+SolarSunTrack::Knot
+SolarSunTrack::Evaluate (int64_t seconds) const
+{
+  tm date = m_startDate;
+  Sun::AddSeconds (&date, seconds);
+
+  Sun::Coordinates coordinates;
+  Sun::GetPosition (m_panel.sunPositionAlgorithm, &date, m_panel.latitude, m_panel.longitude, &coordinates);
+
+  // the terms of SolarIrradianceField, not clamped at night, so that they
+  // are smooth across sunrise and sunset
+  double elevation = coordinates.dElevationAngle * rad;
+  double zenith = coordinates.dZenithAngle * rad;
+  double incident = 2 * m_panel.airMass * (sin (elevation) / rad) * 1e3;
+
+  Knot knot;
+  knot.time = seconds;
+  knot.terms[0] = incident;
+  knot.terms[1] = incident * cos (elevation) * cos (zenith);
+  knot.terms[2] = incident * cos (elevation) * sin (zenith);
+  knot.terms[3] = incident * sin (elevation);
+  return knot;
+}
+
+} // namespace ns3
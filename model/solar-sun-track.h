@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SOLAR_SUN_TRACK_H
+#define SOLAR_SUN_TRACK_H
+
+#include "ns3/solar-energy-harvester.h"
+#include "ns3/solar-irradiance-field.h"
+#include "ns3/simple-ref-count.h"
+
+#include <ctime>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * The clear-sky power of a SolarEnergyHarvester interpolated from a coarse
+ * sun track, for a given site and panel and starting date.
+ *
+ * The sun model is evaluated exactly only at knots every KnotSpacing
+ * seconds, plus the sunrise and sunset instants (found by bisection to the
+ * second), and each knot stores the irradiance terms of
+ * SolarIrradianceField, i.e., the sun vector scaled by the incident
+ * insolation, not clamped at night. In between, every term is a cubic
+ * Hermite spline with finite difference slopes, so a sample costs a
+ * polynomial evaluation and no libm call; the power is zero where the
+ * interpolated incident term, proportional to the sine of the elevation,
+ * is not positive.
+ *
+ * The knots are built one day at a time and only the current day is kept,
+ * so the track follows a harvester moving forward in time.
+ */
+class SolarSunTrack : public SimpleRefCount<SolarSunTrack>
+{
+public:
+  /**
+   * \param panel the site and panel parameters
+   * \param startDate the date at 0 seconds
+   * \param knotSpacing the seconds between two regular knots
+   */
+  SolarSunTrack (const SolarEnergyHarvester::Panel &panel, const tm &startDate, int64_t knotSpacing);
+
+  /**
+   * \return true if the track has been built for these parameters
+   */
+  bool Matches (const SolarEnergyHarvester::Panel &panel, int64_t knotSpacing) const;
+
+  /**
+   * \param seconds the time elapsed since the starting date
+   * \return the interpolated clear-sky power, in Watt
+   */
+  double GetPower (double seconds);
+
+private:
+  /**
+   * A knot of the track: the exact irradiance terms at a given time, and
+   * their slopes.
+   */
+  struct Knot
+  {
+    int64_t time; //!< Seconds since the starting date
+    double terms[4]; //!< incident, horizontalCos, horizontalSin, vertical
+    double slopes[4]; //!< The derivatives of terms, per second
+  };
+
+  /**
+   * Build the knots of a day, plus one before and one after it.
+   */
+  void Build (int64_t day);
+
+  /**
+   * \return the knot at seconds, with the exact terms and no slopes
+   */
+  Knot Evaluate (int64_t seconds) const;
+
+  SolarEnergyHarvester::Panel m_panel;
+  tm m_startDate; // <- The date at 0 seconds
+  int64_t m_knotSpacing; // <- The seconds between two regular knots
+  SolarIrradianceField::PanelWeights m_weights; // <- The weights of the terms for the panel orientation
+  double m_scale; // <- From insolation to power: efficiencies and panel dimension
+  int64_t m_day; // <- The day covered by m_knots
+  std::vector<Knot> m_knots; // <- The knots of the current day
+  size_t m_segment; // <- The last segment used, as the next sample usually falls there
+};
+
+} // namespace ns3
+
+#endif /* SOLAR_SUN_TRACK_H */
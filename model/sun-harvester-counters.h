@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SUN_HARVESTER_COUNTERS_H
+#define SUN_HARVESTER_COUNTERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup SolarEnergyHarvester
+ *
+ * N program-wide counters, kept per thread: every thread increments its
+ * own block, in its thread-local storage, without read-modify-write
+ * instructions, and Get adds the blocks of all the threads; an exiting
+ * thread adds its block to the retired counts. Tag tells the sets of
+ * counters apart, each having its own blocks.
+ *
+ * Reset, or Get, while other threads are counting may miss their latest
+ * increments.
+ */
+template <typename Tag, uint32_t N>
+class PerThreadCounters
+{
+public:
+  /**
+   * \param i the counter, below N
+   * \param n the increment
+   */
+  static void Increment (uint32_t i, uint64_t n = 1)
+  {
+    // only this thread writes its block
+    static thread_local Block block;
+    std::atomic<uint64_t> &value = block.values[i];
+    value.store (value.load (std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  /**
+   * \param i the counter, below N
+   * \return the counter, summed over all the threads
+   */
+  static uint64_t Get (uint32_t i)
+  {
+    Registry &registry = GetRegistry ();
+    std::lock_guard<std::mutex> lock (registry.mutex);
+    uint64_t value = registry.retired[i];
+    for (typename std::vector<Block *>::const_iterator b = registry.blocks.begin (); b != registry.blocks.end (); ++b)
+      {
+        value += (*b)->values[i].load (std::memory_order_relaxed);
+      }
+    return value;
+  }
+
+  /**
+   * Set all the counters of all the threads to zero.
+   */
+  static void Reset (void)
+  {
+    Registry &registry = GetRegistry ();
+    std::lock_guard<std::mutex> lock (registry.mutex);
+    for (uint32_t i = 0; i < N; ++i)
+      {
+        registry.retired[i] = 0;
+      }
+    for (typename std::vector<Block *>::const_iterator b = registry.blocks.begin (); b != registry.blocks.end (); ++b)
+      {
+        for (uint32_t i = 0; i < N; ++i)
+          {
+            (*b)->values[i].store (0, std::memory_order_relaxed);
+          }
+      }
+  }
+
+private:
+  struct Block;
+
+  /**
+   * The counts of the threads, living and exited
+   */
+  struct Registry
+  {
+    Registry ()
+    {
+      for (uint32_t i = 0; i < N; ++i)
+        {
+          retired[i] = 0;
+        }
+    }
+
+    std::mutex mutex;
+    std::vector<Block *> blocks; // <- The blocks of the living threads
+    uint64_t retired[N]; // <- The counts of the exited threads
+  };
+
+  /**
+   * The counters of one thread, registered while the thread lives
+   */
+  struct Block
+  {
+    Block ()
+    {
+      for (uint32_t i = 0; i < N; ++i)
+        {
+          values[i].store (0, std::memory_order_relaxed);
+        }
+      Registry &registry = GetRegistry ();
+      std::lock_guard<std::mutex> lock (registry.mutex);
+      registry.blocks.push_back (this);
+    }
+
+    ~Block ()
+    {
+      Registry &registry = GetRegistry ();
+      std::lock_guard<std::mutex> lock (registry.mutex);
+      for (uint32_t i = 0; i < N; ++i)
+        {
+          registry.retired[i] += values[i].load (std::memory_order_relaxed);
+        }
+      registry.blocks.erase (std::find (registry.blocks.begin (), registry.blocks.end (), this));
+    }
+
+    std::atomic<uint64_t> values[N];
+  };
+
+  static Registry& GetRegistry (void)
+  {
+    // never destroyed, as the blocks of the threads still running at exit
+    static Registry *registry = new Registry;
+    return *registry;
+  }
+};
+
+} // namespace ns3
+
+#endif /* SUN_HARVESTER_COUNTERS_H */
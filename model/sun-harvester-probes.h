@@ -0,0 +1,71 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#ifndef SUN_HARVESTER_PROBES_H
+#define SUN_HARVESTER_PROBES_H
+
+/**
+ * USDT (static tracepoints) of the sun-harvester module, provider
+ * "sun_harvester", for external profilers such as bpftrace or perf.
+ *
+ * They are compiled in only when the module is configured with
+ * --enable-sun-harvester-probes and <sys/sdt.h> is available; otherwise all
+ * the macros expand to nothing. Every probe has a semaphore, incremented by
+ * the tracer when it attaches, so the probe arguments are computed only
+ * while somebody is listening:
+ *
+ * \code
+ *   if (SUN_HARVESTER_PROBE_ENABLED (update_exit))
+ *     {
+ *       SUN_HARVESTER_PROBE3 (update_exit, nodeId, timeNs, powerUw);
+ *     }
+ * \endcode
+ *
+ * Each probe needs one SUN_HARVESTER_PROBE_DEFINE, at global scope, in the
+ * translation unit that fires it.
+ */
+
+#ifdef SUN_HARVESTER_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SUN_HARVESTER_PROBE_DEFINE(name) \
+  extern "C" { unsigned short sun_harvester_ ## name ## _semaphore __attribute__ ((section (".probes"))) = 0; }
+
+#define SUN_HARVESTER_PROBE_ENABLED(name) \
+  __builtin_expect (sun_harvester_ ## name ## _semaphore != 0, 0)
+
+#define SUN_HARVESTER_PROBE2(name, a1, a2) \
+  STAP_PROBE2 (sun_harvester, name, a1, a2)
+
+#define SUN_HARVESTER_PROBE3(name, a1, a2, a3) \
+  STAP_PROBE3 (sun_harvester, name, a1, a2, a3)
+
+#else /* SUN_HARVESTER_PROBES */
+
+#define SUN_HARVESTER_PROBE_DEFINE(name)
+#define SUN_HARVESTER_PROBE_ENABLED(name) false
+#define SUN_HARVESTER_PROBE2(name, a1, a2)
+#define SUN_HARVESTER_PROBE3(name, a1, a2, a3)
+
+#endif /* SUN_HARVESTER_PROBES */
+
+#endif /* SUN_HARVESTER_PROBES_H */
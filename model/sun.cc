@@ -20,13 +20,42 @@
  */
 
 #include "sun.h"
+#include "sun-harvester-probes.h"
+#include "sun-harvester-counters.h"
 
-
+#include <algorithm>
 #include <ctime>
 #include <math.h>
 
+SUN_HARVESTER_PROBE_DEFINE (psa_entry)
+SUN_HARVESTER_PROBE_DEFINE (psa_exit)
+
 namespace ns3 {
 
+/// The tag of the sun model counters
+struct SunCounters
+{
+  enum
+  {
+    PSA_EVALUATIONS,
+    CELESTIAL_EVALUATIONS,
+    N
+  };
+};
+
+typedef PerThreadCounters<SunCounters, SunCounters::N> SunPerThreadCounters;
+
+std::atomic<bool> Sun::m_counting (false);
+
+void
+Sun::Count (uint32_t counter)
+{
+  if (m_counting.load (std::memory_order_relaxed))
+    {
+      SunPerThreadCounters::Increment (counter);
+    }
+}
+
 double
 Sun::GetIncidentInsolation (const tm *date, const double &latitude, const double &longitude, const double &altitude)
 {
@@ -34,8 +63,18 @@ Sun::GetIncidentInsolation (const tm *date, const double &latitude, const double
   Sun::PSA (date, latitude, longitude, &coordinates);
   if (coordinates.dElevationAngle > 0)
     {
-      return GetAirMass (latitude, altitude) * (sin (coordinates.dElevationAngle * rad) / rad) * 1e3;
-      //return GetAirMass (latitude);
+      return GetIncidentInsolation (coordinates, GetAirMass (latitude, altitude));
+    }
+
+  return 0;
+}
+
+double
+Sun::GetIncidentInsolation (const Sun::Coordinates &udtSunCoordinates, const double &airMass)
+{
+  if (udtSunCoordinates.dElevationAngle > 0)
+    {
+      return airMass * (sin (udtSunCoordinates.dElevationAngle * rad) / rad) * 1e3;
     }
 
   return 0;
@@ -44,12 +83,24 @@ Sun::GetIncidentInsolation (const tm *date, const double &latitude, const double
 double
 Sun::DecimalHours (const tm *date)
 {
-  return (double) ((date->tm_hour + 1 + (date->tm_min + date->tm_sec / SECONDS_IN_MINUTE ) / MINUTES_IN_HOUR) - date->tm_gmtoff / SECONDS_IN_HOUR);
+  // floating point division: the minutes, the seconds and the offsets that
+  // are not whole hours all count
+  return date->tm_hour + 1 + (date->tm_min + date->tm_sec / (double) SECONDS_IN_MINUTE) / MINUTES_IN_HOUR
+         - date->tm_gmtoff / (double) SECONDS_IN_HOUR;
 }
 
 void
 Sun::PSA (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates)
 {
+  Sun::CelestialState state;
+  GetCelestialState (date, &state);
+  PSA (state, GetLocation (latitude, longitude), udtSunCoordinates);
+}
+
+void
+Sun::GetCelestialState (const tm *date, Sun::CelestialState *state)
+{
+  Count (SunCounters::CELESTIAL_EVALUATIONS);
 
   double dDecimalHours = Sun::DecimalHours (date);
 
@@ -118,30 +169,75 @@ Sun::PSA (const tm *date, const double &latitude, const double &longitude, Sun::
     dDeclination = asin ( sin ( dEclipticObliquity ) * dSin_EclipticLongitude );
   }
 
+  state->dGreenwichMeanSiderealTime = 6.6974243242 +
+    0.0657098283 * dElapsedJulianDays
+    + dDecimalHours;
+  state->dRightAscension = dRightAscension;
+  state->dCos_Declination = cos (dDeclination);
+  state->dSin_Declination = sin (dDeclination);
+  state->dTan_Declination = tan (dDeclination);
+}
+
+Sun::Location
+Sun::GetLocation (const double &latitude, const double &longitude)
+{
+  Sun::Location location;
+  double dLatitudeInRadians = latitude * rad;
+  location.dLatitude = latitude;
+  location.dLongitude = longitude;
+  location.dCos_Latitude = cos ( dLatitudeInRadians );
+  location.dSin_Latitude = sin ( dLatitudeInRadians );
+  return location;
+}
+
+const Sun::CelestialState &
+Sun::GetSharedCelestialState (const tm *date)
+{
+  // one entry per thread: the callers at the same tick share the state,
+  // whatever their location
+  static thread_local tm lastDate;
+  static thread_local bool valid = false;
+  static thread_local Sun::CelestialState state;
+
+  if (!valid || date->tm_sec != lastDate.tm_sec || date->tm_min != lastDate.tm_min
+      || date->tm_hour != lastDate.tm_hour || date->tm_mday != lastDate.tm_mday
+      || date->tm_mon != lastDate.tm_mon || date->tm_year != lastDate.tm_year
+      || date->tm_gmtoff != lastDate.tm_gmtoff)
+    {
+      GetCelestialState (date, &state);
+      lastDate = *date;
+      valid = true;
+    }
+  return state;
+}
+
+void
+Sun::PSA (const Sun::CelestialState &state, const Sun::Location &location, Sun::Coordinates* udtSunCoordinates)
+{
+  Count (SunCounters::PSA_EVALUATIONS);
+
+  if (SUN_HARVESTER_PROBE_ENABLED (psa_entry))
+    {
+      // angles in micro degrees, as integer arguments are the most portable
+      SUN_HARVESTER_PROBE2 (psa_entry, (int64_t) llround (location.dLatitude * 1e6), (int64_t) llround (location.dLongitude * 1e6));
+    }
+
   // Calculate local coordinates ( azimuth and zenith angle ) in degrees
   {
-    double dGreenwichMeanSiderealTime;
+    double dY;
+    double dX;
     double dLocalMeanSiderealTime;
-    double dLatitudeInRadians;
     double dHourAngle;
-    double dCos_Latitude;
-    double dSin_Latitude;
     double dCos_HourAngle;
     double dParallax;
-    dGreenwichMeanSiderealTime = 6.6974243242 +
-      0.0657098283 * dElapsedJulianDays
-      + dDecimalHours;
-    dLocalMeanSiderealTime = (dGreenwichMeanSiderealTime * 15
-                              + longitude) * rad;
-    dHourAngle = dLocalMeanSiderealTime - dRightAscension;
-    dLatitudeInRadians = latitude * rad;
-    dCos_Latitude = cos ( dLatitudeInRadians );
-    dSin_Latitude = sin ( dLatitudeInRadians );
+    dLocalMeanSiderealTime = (state.dGreenwichMeanSiderealTime * 15
+                              + location.dLongitude) * rad;
+    dHourAngle = dLocalMeanSiderealTime - state.dRightAscension;
     dCos_HourAngle = cos ( dHourAngle );
-    udtSunCoordinates->dZenithAngle = (acos ( dCos_Latitude * dCos_HourAngle
-                                              * cos (dDeclination) + sin ( dDeclination ) * dSin_Latitude));
+    udtSunCoordinates->dZenithAngle = (acos ( location.dCos_Latitude * dCos_HourAngle
+                                              * state.dCos_Declination + state.dSin_Declination * location.dSin_Latitude));
     dY = -sin ( dHourAngle );
-    dX = tan ( dDeclination ) * dCos_Latitude - dSin_Latitude * dCos_HourAngle;
+    dX = state.dTan_Declination * location.dCos_Latitude - location.dSin_Latitude * dCos_HourAngle;
     udtSunCoordinates->dAzimuth = atan2 ( dY, dX );
     if ( udtSunCoordinates->dAzimuth < 0.0 )
       {
@@ -156,6 +252,452 @@ Sun::PSA (const tm *date, const double &latitude, const double &longitude, Sun::
 
     udtSunCoordinates->dElevationAngle = 90 - udtSunCoordinates->dZenithAngle;
   }
+
+  if (SUN_HARVESTER_PROBE_ENABLED (psa_exit))
+    {
+      SUN_HARVESTER_PROBE2 (psa_exit, (int64_t) llround (udtSunCoordinates->dElevationAngle * 1e6),
+                            (int64_t) llround (udtSunCoordinates->dAzimuth * 1e6));
+    }
+}
+
+Sun::PositionFunction
+Sun::GetPositionFunction (PositionAlgorithm algorithm)
+{
+  switch (algorithm)
+    {
+    case FAST_ALGORITHM:
+      return &Sun::FastPosition;
+    case SPA_ALGORITHM:
+      return &Sun::SPA;
+    case PSA_ALGORITHM:
+    default:
+      return &Sun::PSA;
+    }
+}
+
+void
+Sun::GetPosition (PositionAlgorithm algorithm, const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates)
+{
+  switch (algorithm)
+    {
+    case FAST_ALGORITHM:
+      FastPosition (date, latitude, longitude, udtSunCoordinates);
+      break;
+    case SPA_ALGORITHM:
+      SPA (date, latitude, longitude, udtSunCoordinates);
+      break;
+    case PSA_ALGORITHM:
+    default:
+      PSA (date, latitude, longitude, udtSunCoordinates);
+      break;
+    }
+}
+
+double
+Sun::JulianDay (const tm *date)
+{
+  int year = date->tm_year + 1900;
+  int month = date->tm_mon + 1;
+  int day = date->tm_mday;
+
+  long int liAux1 = (month - 14) / 12;
+  long int liAux2 = (1461 * (year + 4800 + liAux1)) / 4 + (367 * (month - 2 - 12 * liAux1)) / 12
+    - (3 * ((year + 4900 + liAux1) / 100)) / 4 + day - 32075;
+  return (double)(liAux2) - 0.5 + DecimalHours (date) / 24.0;
+}
+
+void
+Sun::FastPosition (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates)
+{
+  Count (SunCounters::PSA_EVALUATIONS);
+
+  double dElapsedJulianDays = JulianDay (date) - 2451545.0;
+
+  // Fractional year, 0 on January 1st at 0h UT, and UT time of the day in hours
+  double dDays = dElapsedJulianDays + 0.5;
+  double dYearFraction = dDays / 365.2422;
+  double dGamma = twopi * (dYearFraction - floor (dYearFraction));
+  double dUniversalTime = (dDays - floor (dDays)) * HOURS_IN_DAY;
+
+  // sin and cos of the multiples of gamma by angle addition
+  double dSin1 = sin (dGamma);
+  double dCos1 = cos (dGamma);
+  double dSin2 = 2 * dSin1 * dCos1;
+  double dCos2 = dCos1 * dCos1 - dSin1 * dSin1;
+  double dSin3 = dSin2 * dCos1 + dCos2 * dSin1;
+  double dCos3 = dCos2 * dCos1 - dSin2 * dSin1;
+
+  double dDeclination = 0.006918 - 0.399912 * dCos1 + 0.070257 * dSin1 - 0.006758 * dCos2
+    + 0.000907 * dSin2 - 0.002697 * dCos3 + 0.00148 * dSin3;
+  double dEquationOfTime = 229.18 * (0.000075 + 0.001868 * dCos1 - 0.032077 * dSin1
+                                     - 0.014615 * dCos2 - 0.040849 * dSin2); // minutes
+
+  double dSolarTime = dUniversalTime * MINUTES_IN_HOUR + dEquationOfTime + 4 * longitude; // minutes
+  double dHourAngle = (dSolarTime / 4 - 180) * rad;
+
+  double dLatitudeInRadians = latitude * rad;
+  double dCos_Latitude = cos (dLatitudeInRadians);
+  double dSin_Latitude = sin (dLatitudeInRadians);
+  double dCos_HourAngle = cos (dHourAngle);
+
+  double dCosZenith = dSin_Latitude * sin (dDeclination) + dCos_Latitude * cos (dDeclination) * dCos_HourAngle;
+  double dZenithAngle = acos (std::min (1.0, std::max (-1.0, dCosZenith)));
+
+  double dAzimuth = atan2 (-sin (dHourAngle), tan (dDeclination) * dCos_Latitude - dSin_Latitude * dCos_HourAngle);
+  if (dAzimuth < 0.0)
+    {
+      dAzimuth = dAzimuth + twopi;
+    }
+
+  // Parallax Correction, as PSA
+  double dParallax = (dEarthMeanRadius / dAstronomicalUnit) * sin (dZenithAngle);
+
+  udtSunCoordinates->dAzimuth = dAzimuth / rad;
+  udtSunCoordinates->dZenithAngle = (dZenithAngle + dParallax) / rad;
+  udtSunCoordinates->dElevationAngle = 90 - udtSunCoordinates->dZenithAngle;
+}
+
+/*
+ * SPA periodic terms of the Earth heliocentric longitude (L), latitude (B)
+ * and radius vector (R): amplitude, phase, frequency.
+ */
+struct SpaTerm
+{
+  double a;
+  double b;
+  double c;
+};
+
+static const SpaTerm g_spaL0[] = {
+  { 175347046, 0, 0 }, { 3341656, 4.6692568, 6283.07585 }, { 34894, 4.6261, 12566.1517 },
+  { 3497, 2.7441, 5753.3849 }, { 3418, 2.8289, 3.5231 }, { 3136, 3.6277, 77713.7715 },
+  { 2676, 4.4181, 7860.4194 }, { 2343, 6.1352, 3930.2097 }, { 1324, 0.7425, 11506.7698 },
+  { 1273, 2.0371, 529.691 }, { 1199, 1.1096, 1577.3435 }, { 990, 5.233, 5884.927 },
+  { 902, 2.045, 26.298 }, { 857, 3.508, 398.149 }, { 780, 1.179, 5223.694 },
+  { 753, 2.533, 5507.553 }, { 505, 4.583, 18849.228 }, { 492, 4.205, 775.523 },
+  { 357, 2.92, 0.067 }, { 317, 5.849, 11790.629 }, { 284, 1.899, 796.298 },
+  { 271, 0.315, 10977.079 }, { 243, 0.345, 5486.778 }, { 206, 4.806, 2544.314 },
+  { 205, 1.869, 5573.143 }, { 202, 2.458, 6069.777 }, { 156, 0.833, 213.299 },
+  { 132, 3.411, 2942.463 }, { 126, 1.083, 20.775 }, { 115, 0.645, 0.98 },
+  { 103, 0.636, 4694.003 }, { 102, 0.976, 15720.839 }, { 102, 4.267, 7.114 },
+  { 99, 6.21, 2146.17 }, { 98, 0.68, 155.42 }, { 86, 5.98, 161000.69 },
+  { 85, 1.3, 6275.96 }, { 85, 3.67, 71430.7 }, { 80, 1.81, 17260.15 },
+  { 79, 3.04, 12036.46 }, { 75, 1.76, 5088.63 }, { 74, 3.5, 3154.69 },
+  { 74, 4.68, 801.82 }, { 70, 0.83, 9437.76 }, { 62, 3.98, 8827.39 },
+  { 61, 1.82, 7084.9 }, { 57, 2.78, 6286.6 }, { 56, 4.39, 14143.5 },
+  { 56, 3.47, 6279.55 }, { 52, 0.19, 12139.55 }, { 52, 1.33, 1748.02 },
+  { 51, 0.28, 5856.48 }, { 49, 0.49, 1194.45 }, { 41, 5.37, 8429.24 },
+  { 41, 2.4, 19651.05 }, { 39, 6.17, 10447.39 }, { 37, 6.04, 10213.29 },
+  { 37, 2.57, 1059.38 }, { 36, 1.71, 2352.87 }, { 36, 1.78, 6812.77 },
+  { 33, 0.59, 17789.85 }, { 30, 0.44, 83996.85 }, { 30, 2.74, 1349.87 },
+  { 25, 3.16, 4690.48 }
+};
+
+static const SpaTerm g_spaL1[] = {
+  { 628331966747.0, 0, 0 }, { 206059, 2.678235, 6283.07585 }, { 4303, 2.6351, 12566.1517 },
+  { 425, 1.59, 3.523 }, { 119, 5.796, 26.298 }, { 109, 2.966, 1577.344 },
+  { 93, 2.59, 18849.23 }, { 72, 1.14, 529.69 }, { 68, 1.87, 398.15 },
+  { 67, 4.41, 5507.55 }, { 59, 2.89, 5223.69 }, { 56, 2.17, 155.42 },
+  { 45, 0.4, 796.3 }, { 36, 0.47, 775.52 }, { 29, 2.65, 7.11 },
+  { 21, 5.34, 0.98 }, { 19, 1.85, 5486.78 }, { 19, 4.97, 213.3 },
+  { 17, 2.99, 6275.96 }, { 16, 0.03, 2544.31 }, { 16, 1.43, 2146.17 },
+  { 15, 1.21, 10977.08 }, { 12, 2.83, 1748.02 }, { 12, 3.26, 5088.63 },
+  { 12, 5.27, 1194.45 }, { 12, 2.08, 4694 }, { 11, 0.77, 553.57 },
+  { 10, 1.3, 6286.6 }, { 10, 4.24, 1349.87 }, { 9, 2.7, 242.73 },
+  { 9, 5.64, 951.72 }, { 8, 5.3, 2352.87 }, { 6, 2.65, 9437.76 },
+  { 6, 4.67, 4690.48 }
+};
+
+static const SpaTerm g_spaL2[] = {
+  { 52919, 0, 0 }, { 8720, 1.0721, 6283.0758 }, { 309, 0.867, 12566.152 },
+  { 27, 0.05, 3.52 }, { 16, 5.19, 26.3 }, { 16, 3.68, 155.42 },
+  { 10, 0.76, 18849.23 }, { 9, 2.06, 77713.77 }, { 7, 0.83, 775.52 },
+  { 5, 4.66, 1577.34 }, { 4, 1.03, 7.11 }, { 4, 3.44, 5573.14 },
+  { 3, 5.14, 796.3 }, { 3, 6.05, 5507.55 }, { 3, 1.19, 242.73 },
+  { 3, 6.12, 529.69 }, { 3, 0.31, 398.15 }, { 3, 2.28, 553.57 },
+  { 2, 4.38, 5223.69 }, { 2, 3.75, 0.98 }
+};
+
+static const SpaTerm g_spaL3[] = {
+  { 289, 5.844, 6283.076 }, { 35, 0, 0 }, { 17, 5.49, 12566.15 },
+  { 3, 5.2, 155.42 }, { 1, 4.72, 3.52 }, { 1, 5.3, 18849.23 },
+  { 1, 5.97, 242.73 }
+};
+
+static const SpaTerm g_spaL4[] = {
+  { 114, 3.142, 0 }, { 8, 4.13, 6283.08 }, { 1, 3.84, 12566.15 }
+};
+
+static const SpaTerm g_spaL5[] = {
+  { 1, 3.14, 0 }
+};
+
+static const SpaTerm g_spaB0[] = {
+  { 280, 3.199, 84334.662 }, { 102, 5.422, 5507.553 }, { 80, 3.88, 5223.69 },
+  { 44, 3.7, 2352.87 }, { 32, 4, 1577.34 }
+};
+
+static const SpaTerm g_spaB1[] = {
+  { 9, 3.9, 5507.55 }, { 6, 1.73, 5223.69 }
+};
+
+static const SpaTerm g_spaR0[] = {
+  { 100013989, 0, 0 }, { 1670700, 3.0984635, 6283.07585 }, { 13956, 3.05525, 12566.1517 },
+  { 3084, 5.1985, 77713.7715 }, { 1628, 1.1739, 5753.3849 }, { 1576, 2.8469, 7860.4194 },
+  { 925, 5.453, 11506.77 }, { 542, 4.564, 3930.21 }, { 472, 3.661, 5884.927 },
+  { 346, 0.964, 5507.553 }, { 329, 5.9, 5223.694 }, { 307, 0.299, 5573.143 },
+  { 243, 4.273, 11790.629 }, { 212, 5.847, 1577.344 }, { 186, 5.022, 10977.079 },
+  { 175, 3.012, 18849.228 }, { 110, 5.055, 5486.778 }, { 98, 0.89, 6069.78 },
+  { 86, 5.69, 15720.84 }, { 86, 1.27, 161000.69 }, { 65, 0.27, 17260.15 },
+  { 63, 0.92, 529.69 }, { 57, 2.01, 83996.85 }, { 56, 5.24, 71430.7 },
+  { 49, 3.25, 2544.31 }, { 47, 2.58, 775.52 }, { 45, 5.54, 9437.76 },
+  { 43, 6.01, 6275.96 }, { 39, 5.36, 4694 }, { 38, 2.39, 8827.39 },
+  { 37, 0.83, 19651.05 }, { 37, 4.9, 12139.55 }, { 36, 1.67, 12036.46 },
+  { 35, 1.84, 2942.46 }, { 33, 0.24, 7084.9 }, { 32, 0.18, 5088.63 },
+  { 32, 1.78, 398.15 }, { 28, 1.21, 6286.6 }, { 28, 1.9, 6279.55 },
+  { 26, 4.59, 10447.39 }
+};
+
+static const SpaTerm g_spaR1[] = {
+  { 103019, 1.10749, 6283.07585 }, { 1721, 1.0644, 12566.1517 }, { 702, 3.142, 0 },
+  { 32, 1.02, 18849.23 }, { 31, 2.84, 5507.55 }, { 25, 1.32, 5223.69 },
+  { 18, 1.42, 1577.34 }, { 10, 5.91, 10977.08 }, { 9, 1.42, 6275.96 },
+  { 9, 0.27, 5486.78 }
+};
+
+static const SpaTerm g_spaR2[] = {
+  { 4359, 5.7846, 6283.0758 }, { 124, 5.579, 12566.152 }, { 12, 3.14, 0 },
+  { 9, 3.63, 77713.77 }, { 6, 1.87, 5573.14 }, { 3, 5.47, 18849.23 }
+};
+
+static const SpaTerm g_spaR3[] = {
+  { 145, 4.273, 6283.076 }, { 7, 3.92, 12566.15 }
+};
+
+static const SpaTerm g_spaR4[] = {
+  { 4, 2.56, 6283.08 }
+};
+
+/*
+ * The largest SPA nutation terms: multipliers of the mean elongation of the
+ * moon, anomaly of the sun, anomaly of the moon, argument of latitude of the
+ * moon and longitude of the ascending node, then the longitude (a + b T) and
+ * obliquity (c + d T) coefficients, in 0.0001 arc seconds.
+ */
+struct SpaNutationTerm
+{
+  int y[5];
+  double a;
+  double b;
+  double c;
+  double d;
+};
+
+static const SpaNutationTerm g_spaNutation[] = {
+  { { 0, 0, 0, 0, 1 }, -171996, -174.2, 92025, 8.9 },
+  { { -2, 0, 0, 2, 2 }, -13187, -1.6, 5736, -3.1 },
+  { { 0, 0, 0, 2, 2 }, -2274, -0.2, 977, -0.5 },
+  { { 0, 0, 0, 0, 2 }, 2062, 0.2, -895, 0.5 },
+  { { 0, 1, 0, 0, 0 }, 1426, -3.4, 54, -0.1 },
+  { { 0, 0, 1, 0, 0 }, 712, 0.1, -7, 0 },
+  { { -2, 1, 0, 2, 2 }, -517, 1.2, 224, -0.6 },
+  { { 0, 0, 0, 2, 1 }, -386, -0.4, 200, 0 },
+  { { 0, 0, 1, 2, 2 }, -301, 0, 129, -0.1 },
+  { { -2, -1, 0, 2, 2 }, 217, -0.5, -95, 0.3 },
+  { { -2, 0, 1, 0, 0 }, -158, 0, 0, 0 },
+  { { -2, 0, 0, 2, 1 }, 129, 0.1, -70, 0 },
+  { { 0, 0, -1, 2, 2 }, 123, 0, -53, 0 },
+  { { 2, 0, 0, 0, 0 }, 63, 0, 0, 0 },
+  { { 0, 0, 1, 0, 1 }, 63, 0.1, -33, 0 },
+  { { 2, 0, -1, 2, 2 }, -59, 0, 26, 0 },
+  { { 0, 0, -1, 0, 1 }, -58, -0.1, 32, 0 },
+  { { 0, 0, 1, 2, 1 }, -51, 0, 27, 0 }
+};
+
+#define SPA_TERMS(table) (table), (sizeof (table) / sizeof ((table)[0]))
+
+static double
+SpaSum (const SpaTerm *terms, size_t n, double jme)
+{
+  double sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    {
+      sum += terms[i].a * cos (terms[i].b + terms[i].c * jme);
+    }
+  return sum;
+}
+
+static double
+LimitDegrees (double degrees)
+{
+  degrees = fmod (degrees, 360);
+  return degrees < 0 ? degrees + 360 : degrees;
+}
+
+void
+Sun::SPA (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates)
+{
+  SpaPosition (JulianDay (date), dDeltaT, latitude, longitude, udtSunCoordinates);
+}
+
+void
+Sun::SpaPosition (double julianDay, double deltaT, double latitude, double longitude, Sun::Coordinates* udtSunCoordinates)
+{
+  Count (SunCounters::PSA_EVALUATIONS);
+
+  double jde = julianDay + deltaT / SECONDS_IN_DAY;
+  double jc = (julianDay - 2451545.0) / 36525;
+  double jce = (jde - 2451545.0) / 36525;
+  double jme = jce / 10;
+
+  // Earth heliocentric longitude, latitude (degrees) and radius vector (AU)
+  double l = (SpaSum (SPA_TERMS (g_spaL0), jme)
+              + jme * (SpaSum (SPA_TERMS (g_spaL1), jme)
+                       + jme * (SpaSum (SPA_TERMS (g_spaL2), jme)
+                                + jme * (SpaSum (SPA_TERMS (g_spaL3), jme)
+                                         + jme * (SpaSum (SPA_TERMS (g_spaL4), jme)
+                                                  + jme * SpaSum (SPA_TERMS (g_spaL5), jme)))))) / 1e8;
+  double b = (SpaSum (SPA_TERMS (g_spaB0), jme) + jme * SpaSum (SPA_TERMS (g_spaB1), jme)) / 1e8;
+  double r = (SpaSum (SPA_TERMS (g_spaR0), jme)
+              + jme * (SpaSum (SPA_TERMS (g_spaR1), jme)
+                       + jme * (SpaSum (SPA_TERMS (g_spaR2), jme)
+                                + jme * (SpaSum (SPA_TERMS (g_spaR3), jme)
+                                         + jme * SpaSum (SPA_TERMS (g_spaR4), jme))))) / 1e8;
+
+  // geocentric longitude and latitude
+  double theta = LimitDegrees (l / rad + 180);
+  double beta = -b / rad;
+
+  // nutation in longitude and obliquity
+  double x[5];
+  x[0] = 297.85036 + jce * (445267.111480 + jce * (-0.0019142 + jce / 189474));
+  x[1] = 357.52772 + jce * (35999.050340 + jce * (-0.0001603 - jce / 300000));
+  x[2] = 134.96298 + jce * (477198.867398 + jce * (0.0086972 + jce / 56250));
+  x[3] = 93.27191 + jce * (483202.017538 + jce * (-0.0036825 + jce / 327270));
+  x[4] = 125.04452 + jce * (-1934.136261 + jce * (0.0020708 + jce / 450000));
+  double deltaPsi = 0;
+  double deltaEpsilon = 0;
+  for (size_t i = 0; i < sizeof (g_spaNutation) / sizeof (g_spaNutation[0]); ++i)
+    {
+      const SpaNutationTerm &term = g_spaNutation[i];
+      double argument = 0;
+      for (int j = 0; j < 5; ++j)
+        {
+          argument += x[j] * term.y[j];
+        }
+      argument *= rad;
+      deltaPsi += (term.a + term.b * jce) * sin (argument);
+      deltaEpsilon += (term.c + term.d * jce) * cos (argument);
+    }
+  deltaPsi /= 36000000;
+  deltaEpsilon /= 36000000;
+
+  // true obliquity of the ecliptic
+  double u = jme / 10;
+  double epsilon0 = 84381.448 + u * (-4680.93 + u * (-1.55 + u * (1999.25 + u * (-51.38 + u * (-249.67
+                                     + u * (-39.05 + u * (7.12 + u * (27.87 + u * (5.79 + u * 2.45)))))))));
+  double epsilon = (epsilon0 / 3600 + deltaEpsilon) * rad;
+
+  // apparent sun longitude, with the aberration correction
+  double lambda = (theta + deltaPsi - 20.4898 / (3600 * r)) * rad;
+
+  // apparent sidereal time at Greenwich
+  double nu0 = LimitDegrees (280.46061837 + 360.98564736629 * (julianDay - 2451545.0)
+                             + jc * jc * (0.000387933 - jc / 38710000));
+  double nu = nu0 + deltaPsi * cos (epsilon);
+
+  // geocentric sun right ascension and declination
+  double betaInRadians = beta * rad;
+  double alpha = atan2 (sin (lambda) * cos (epsilon) - tan (betaInRadians) * sin (epsilon), cos (lambda)) / rad;
+  double delta = asin (sin (betaInRadians) * cos (epsilon) + cos (betaInRadians) * sin (epsilon) * sin (lambda));
+
+  double hourAngle = LimitDegrees (nu + longitude - alpha) * rad;
+
+  // topocentric correction, at sea level
+  double latitudeInRadians = latitude * rad;
+  double xi = 8.794 / (3600 * r) * rad;
+  double uu = atan (0.99664719 * tan (latitudeInRadians));
+  double xx = cos (uu);
+  double yy = 0.99664719 * sin (uu);
+  double deltaAlpha = atan2 (-xx * sin (xi) * sin (hourAngle), cos (delta) - xx * sin (xi) * cos (hourAngle));
+  double deltaPrime = atan2 ((sin (delta) - yy * sin (xi)) * cos (deltaAlpha), cos (delta) - xx * sin (xi) * cos (hourAngle));
+  double hourAnglePrime = hourAngle - deltaAlpha;
+
+  double elevation = asin (sin (latitudeInRadians) * sin (deltaPrime)
+                           + cos (latitudeInRadians) * cos (deltaPrime) * cos (hourAnglePrime));
+  double gamma = atan2 (sin (hourAnglePrime), cos (hourAnglePrime) * sin (latitudeInRadians)
+                        - tan (deltaPrime) * cos (latitudeInRadians)) / rad;
+
+  udtSunCoordinates->dElevationAngle = elevation / rad;
+  udtSunCoordinates->dZenithAngle = 90 - udtSunCoordinates->dElevationAngle;
+  udtSunCoordinates->dAzimuth = LimitDegrees (gamma + 180);
+}
+
+/*
+ * Days from 1970-01-01 to a date of the proleptic Gregorian calendar, and
+ * back (H. Hinnant, chrono-compatible low-level date algorithms).
+ */
+static int64_t
+DaysFromCivil (int64_t year, unsigned month, unsigned day)
+{
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  unsigned yearOfEra = (unsigned) (year - era * 400);
+  unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + (int64_t) dayOfEra - 719468;
+}
+
+static void
+CivilFromDays (int64_t days, int64_t *year, unsigned *month, unsigned *day)
+{
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  unsigned dayOfEra = (unsigned) (days - era * 146097);
+  unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  unsigned mp = (5 * dayOfYear + 2) / 153;
+  *day = dayOfYear - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = yearOfEra + era * 400 + (*month <= 2);
+}
+
+static int64_t
+FloorDivide (int64_t a, int64_t b)
+{
+  return a / b - (a % b < 0);
+}
+
+int64_t
+Sun::GetUnixTime (const tm *date)
+{
+  int64_t year = date->tm_year + 1900 + FloorDivide (date->tm_mon, 12);
+  unsigned month = (unsigned) (date->tm_mon - 12 * FloorDivide (date->tm_mon, 12)) + 1;
+  int64_t days = DaysFromCivil (year, month, 1) + date->tm_mday - 1;
+  return days * SECONDS_IN_DAY + date->tm_hour * SECONDS_IN_HOUR + date->tm_min * SECONDS_IN_MINUTE
+         + date->tm_sec - date->tm_gmtoff;
+}
+
+void
+Sun::AddSeconds (tm *date, int64_t seconds)
+{
+  int64_t local = GetUnixTime (date) + seconds + date->tm_gmtoff;
+  int64_t days = FloorDivide (local, SECONDS_IN_DAY);
+  int64_t secondOfDay = local - days * SECONDS_IN_DAY;
+
+  int64_t year;
+  unsigned month;
+  unsigned day;
+  CivilFromDays (days, &year, &month, &day);
+
+  date->tm_year = (int) (year - 1900);
+  date->tm_mon = (int) month - 1;
+  date->tm_mday = (int) day;
+  date->tm_hour = (int) (secondOfDay / SECONDS_IN_HOUR);
+  date->tm_min = (int) (secondOfDay % SECONDS_IN_HOUR / SECONDS_IN_MINUTE);
+  date->tm_sec = (int) (secondOfDay % SECONDS_IN_MINUTE);
+  date->tm_wday = (int) ((days % 7 + 11) % 7); // 1970-01-01 was a Thursday
+  date->tm_yday = (int) (days - DaysFromCivil (year, 1, 1));
 }
 
 double
@@ -167,6 +709,30 @@ Sun::GetAirMass (const double &latitude, const double &altitude)
   return 1.353 * ((1 - a * altitude) * pow (0.7, pow (AM, 0.678)) + a * altitude);
 }
 
+void
+Sun::EnableCounters (bool enable)
+{
+  m_counting.store (enable, std::memory_order_relaxed);
+}
+
+uint64_t
+Sun::GetPsaEvaluations (void)
+{
+  return SunPerThreadCounters::Get (SunCounters::PSA_EVALUATIONS);
+}
+
+uint64_t
+Sun::GetCelestialEvaluations (void)
+{
+  return SunPerThreadCounters::Get (SunCounters::CELESTIAL_EVALUATIONS);
+}
+
+void
+Sun::ResetCounters (void)
+{
+  SunPerThreadCounters::Reset ();
+}
+
 } /* namespace ns3 */
 
 
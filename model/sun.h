@@ -22,24 +22,27 @@
 #ifndef SUN_H
 #define SUN_H
 
+#include <atomic>
 #include <ctime>
+#include <stdint.h>
 
 namespace ns3 {
 
 /** Constants Declaration*/
 
-#define HOURS_IN_DAY 24
-#define SECONDS_IN_HOUR 3600
-#define MINUTES_IN_HOUR 60
-#define SECONDS_IN_MINUTE MINUTES_IN_HOUR
+const int HOURS_IN_DAY = 24;
+const int SECONDS_IN_HOUR = 3600;
+const int MINUTES_IN_HOUR = 60;
+const int SECONDS_IN_MINUTE = MINUTES_IN_HOUR;
 
-#define SECONDS_IN_DAY  (HOURS_IN_DAY * SECONDS_IN_HOUR)
+const int SECONDS_IN_DAY = HOURS_IN_DAY * SECONDS_IN_HOUR;
 
-#define pi 3.14159265358979323846
-#define twopi (2 * pi)
-#define rad (pi / 180)
-#define dEarthMeanRadius 6371.01    // In km
-#define dAstronomicalUnit 149597890 // In km
+const double pi = 3.14159265358979323846;
+const double twopi = 2 * pi;
+const double rad = pi / 180;
+const double dEarthMeanRadius = 6371.01;    // In km
+const double dAstronomicalUnit = 149597890; // In km
+const double dDeltaT = 69; // TT - UT in seconds, for 2015-2020
 
 
 class Sun
@@ -53,27 +56,178 @@ public:
     double dElevationAngle;
   } Coordinates;
 
+  /**
+   * The sun position algorithms. All of them interpret the date as PSA does
+   * and return the topocentric position without atmospheric refraction.
+   */
+  enum PositionAlgorithm
+  {
+    PSA_ALGORITHM, //!< PSA (Blanco-Muriel et al., 2001), the default
+    FAST_ALGORITHM, //!< Spencer (1971) declination and equation of time: cheaper, coarser
+    SPA_ALGORITHM //!< NREL SPA (Reda and Andreas, 2004): slower, more accurate
+  };
+
+  /**
+   * The time-only stage of PSA: the Julian Day, the ecliptic and the
+   * celestial coordinates depend on the date alone, so they are computed
+   * once per date and shared by all the locations.
+   */
+  typedef struct
+  {
+    double dGreenwichMeanSiderealTime; //!< In hours, without limiting it to 24
+    double dRightAscension; //!< In radians
+    double dCos_Declination;
+    double dSin_Declination;
+    double dTan_Declination;
+  } CelestialState;
+
+  /**
+   * The location terms of the local stage of PSA, computed once per location.
+   */
+  typedef struct
+  {
+    double dLatitude; //!< In degrees
+    double dLongitude; //!< In degrees
+    double dCos_Latitude;
+    double dSin_Latitude;
+  } Location;
+
+  typedef void (*PositionFunction)(const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates);
+
+  /**
+   *  \return the function implementing algorithm
+   */
+  static PositionFunction GetPositionFunction (PositionAlgorithm algorithm);
+
+  /**
+   *  Calculate local sun coordinates with the given algorithm
+   */
+  static void GetPosition (PositionAlgorithm algorithm, const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates);
+
   /**
    *  Calculate local sun coordinates
    *  \return SunCoordinates - i.e., azimuth and zenith angle in degrees
    */
   static void PSA (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates);
 
+  /**
+   *  The time-only stage of PSA, the most expensive one
+   */
+  static void GetCelestialState (const tm *date, Sun::CelestialState *state);
+
+  /**
+   *  GetCelestialState through a one-entry cache per thread, keyed by the
+   *  date: all the callers at the same date, e.g., the harvesters at the
+   *  same simulation tick, share one evaluation.
+   *  \return a reference valid until the next call from the same thread
+   */
+  static const Sun::CelestialState & GetSharedCelestialState (const tm *date);
+
+  /**
+   *  \return the location terms of PSA
+   */
+  static Sun::Location GetLocation (const double &latitude, const double &longitude);
+
+  /**
+   *  The per-location stage of PSA: with the state of date, it returns the
+   *  same coordinates of PSA (date, latitude, longitude), bit for bit.
+   */
+  static void PSA (const Sun::CelestialState &state, const Sun::Location &location, Sun::Coordinates* udtSunCoordinates);
+
+  /**
+   *  Calculate local sun coordinates from the Spencer (1971) Fourier series
+   *  of the declination and of the equation of time. Cheaper than PSA,
+   *  with errors up to some tenths of degree.
+   */
+  static void FastPosition (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates);
+
+  /**
+   *  Calculate local sun coordinates with the NREL Solar Position Algorithm
+   *  (Reda and Andreas, 2004), with the full Earth periodic terms and the
+   *  largest nutation terms, at sea level and with a fixed TT - UT of
+   *  dDeltaT seconds. About ten times more expensive than PSA.
+   */
+  static void SPA (const tm *date, const double &latitude, const double &longitude, Sun::Coordinates* udtSunCoordinates);
+
   /**
      *  Estimate the Incident insolation
      *  \return the Incident insolation in [W/m^2]
      */
   static double GetIncidentInsolation (const tm *date, const double &latitude, const double &longitude, const double &altitude);
 
+  /**
+   *  Estimate the Incident insolation from an already computed sun position
+   *  \param udtSunCoordinates the sun position returned by PSA
+   *  \param airMass the Air Mass factor returned by GetAirMass
+   *  \return the Incident insolation in [W/m^2]
+   */
+  static double GetIncidentInsolation (const Sun::Coordinates &udtSunCoordinates, const double &airMass);
+
   static double GetAirMass (const double &latitude, const double &altitude);
 
+  /**
+   *  Add seconds to a date with civil calendar arithmetic, instead of mktime
+   *  and localtime: it is reentrant and does not read the TZ settings. The
+   *  UTC offset of the date (tm_gmtoff) is kept, i.e., daylight saving time
+   *  is not followed, which does not change the sun position.
+   */
+  static void AddSeconds (tm *date, int64_t seconds);
+
+  /**
+   *  \return the seconds since the Epoch of date, from its fields and its
+   *  UTC offset, as mktime without the TZ settings
+   */
+  static int64_t GetUnixTime (const tm *date);
+
+  /**
+   *  Count the sun position and GetCelestialState evaluations, from now on.
+   *  The counters are disabled by default, so that the sun model costs
+   *  nothing more than the evaluation itself; when enabled, every thread
+   *  counts on its own cache line.
+   */
+  static void EnableCounters (bool enable);
+
+  /**
+   *  \return the number of sun position evaluations while the counters were
+   *  enabled, since the start of the program or the last ResetCounters,
+   *  from all the threads
+   */
+  static uint64_t GetPsaEvaluations (void);
+
+  /**
+   *  \return the number of GetCelestialState evaluations, counted as
+   *  GetPsaEvaluations
+   */
+  static uint64_t GetCelestialEvaluations (void);
+
+  static void ResetCounters (void);
+
 private:
   /**
-   *  Calculate time of the day in UT decimal hours
+   *  Calculate time of the day in UT decimal hours, to the second
    *  \return UT decimal hours
    */
   static double DecimalHours (const tm *date);
 
+  /**
+   *  \return the Julian Day of date, as computed by PSA
+   */
+  static double JulianDay (const tm *date);
+
+  /**
+   *  The SPA topocentric sun position.
+   *  \param julianDay the Julian Day (UT)
+   *  \param deltaT TT - UT in seconds
+   */
+  static void SpaPosition (double julianDay, double deltaT, double latitude, double longitude, Sun::Coordinates* udtSunCoordinates);
+
+  /**
+   *  Count one evaluation of counter, if the counters are enabled
+   */
+  static void Count (uint32_t counter);
+
+  static std::atomic<bool> m_counting;
+
 }; // end class
 
 } /* namespace ns3 */
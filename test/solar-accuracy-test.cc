@@ -0,0 +1,399 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/nstime.h>
+#include <ns3/node.h>
+#include <ns3/simulator.h>
+#include <ns3/sun.h>
+#include <ns3/solar-energy-harvester.h>
+#include <ns3/solar-energy-profile.h>
+#include <ns3/solar-power-window.h>
+#include <ns3/solar-segment-energy-source.h>
+#include <ns3/solar-shared-profile.h>
+#include <ns3/solar-sun-track.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SolarAccuracyTestSuite");
+
+/**
+ * The golden reference series of data/sun-harvester-golden.txt, written by
+ * utils/sun-harvester-golden from the reference PSA path: the power of
+ * every config at every step over one year.
+ */
+struct GoldenSeries
+{
+  tm startDate; //!< The date of the first sample
+  uint32_t step; //!< Seconds between two samples
+  uint32_t samples; //!< Samples per config
+  std::vector<std::string> names; //!< The config names
+  std::vector<SolarEnergyHarvester::Panel> panels; //!< The config panels
+  std::vector<std::vector<double> > power; //!< The reference power, per config
+};
+
+static bool
+LoadGoldenSeries (const std::string &filename, GoldenSeries *golden)
+{
+  std::ifstream is (filename.c_str ());
+  if (!is)
+    {
+      return false;
+    }
+
+  std::string line;
+  int64_t start = 0;
+  golden->step = 0;
+  golden->samples = 0;
+  while (std::getline (is, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::istringstream iss (line);
+      std::string key;
+      iss >> key;
+      if (key == "start")
+        {
+          iss >> start;
+        }
+      else if (key == "step")
+        {
+          iss >> golden->step;
+        }
+      else if (key == "samples")
+        {
+          iss >> golden->samples;
+        }
+      else if (key == "config")
+        {
+          SolarEnergyHarvester::Panel panel;
+          std::string name;
+          iss >> name >> panel.latitude >> panel.longitude >> panel.altitude
+          >> panel.solarCellEfficiency >> panel.dcdcEfficiency
+          >> panel.panelAzimuthAngle >> panel.panelTiltAngle
+          >> panel.panelDimension >> panel.diffusePercentage;
+          panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+          panel.sunPositionAlgorithm = Sun::PSA_ALGORITHM;
+          golden->names.push_back (name);
+          golden->panels.push_back (panel);
+          golden->power.push_back (std::vector<double> ());
+        }
+      else
+        {
+          // the first sample line
+          std::istringstream samples (line);
+          for (uint32_t i = 0; i < golden->samples; ++i)
+            {
+              for (uint32_t c = 0; c < golden->panels.size (); ++c)
+                {
+                  double power;
+                  if (!(samples >> power))
+                    {
+                      return false;
+                    }
+                  golden->power[c].push_back (power);
+                }
+              if (i + 1 < golden->samples && std::getline (is, line))
+                {
+                  samples.clear ();
+                  samples.str (line);
+                }
+            }
+          break;
+        }
+    }
+
+  time_t when = start;
+  gmtime_r (&when, &golden->startDate);
+  return golden->step > 0 && !golden->panels.empty () && golden->power[0].size () == golden->samples;
+}
+
+/**
+ * The model paths checked against the golden series
+ */
+enum AccuracyMode
+{
+  REFERENCE_MODE, //!< CalculateHarvestedPower with PSA, the reference itself
+  TWO_STAGE_MODE, //!< PSA in two stages, through GetSharedCelestialState
+  FAST_MODE, //!< The Fast sun position algorithm
+  SPA_MODE, //!< The SPA sun position algorithm
+  SUN_TRACK_MODE, //!< The spline sun track, with 10 minutes knots
+  DOUBLE_PROFILE_MODE, //!< The energy profile, replayed
+  QUANTIZED_16_MODE, //!< The 16 bits quantized energy profile, replayed
+  QUANTIZED_8_MODE, //!< The 8 bits quantized energy profile, replayed
+  PREFETCH_MODE, //!< The prefetch window, filled by the background worker
+  SHARED_PROFILE_MODE, //!< The shared memory profile
+  SEGMENT_MODE //!< The power segments of a harvester, 15 minutes long, with 1 s updates
+};
+
+/**
+ * A SolarSegmentEnergySource keeping all the segments it is notified.
+ */
+class SolarSegmentRecorder : public SolarSegmentEnergySource
+{
+public:
+  virtual void NotifyPowerSegment (Ptr<EnergyHarvester> harvester, const SolarPowerSegment &segment)
+  {
+    m_segments.push_back (segment);
+    SolarSegmentEnergySource::NotifyPowerSegment (harvester, segment);
+  }
+
+  std::vector<SolarPowerSegment> m_segments; // <- The segments, in time order
+};
+
+/**
+ * Checks one model path against the golden series of every config: every
+ * sample within sampleTolerance of the yearly peak of the config, and the
+ * yearly energy within energyTolerance of the reference one.
+ */
+class SolarAccuracyTestCase : public TestCase
+{
+public:
+  SolarAccuracyTestCase (std::string name, AccuracyMode mode, double sampleTolerance, double energyTolerance);
+
+  void DoRun (void);
+
+private:
+  /**
+   * \return the power of every sample of config c, computed by m_mode,
+   * and the yearly energy in energy
+   */
+  std::vector<double> GetSeries (const GoldenSeries &golden, uint32_t c, double *energy);
+
+  AccuracyMode m_mode;
+  double m_sampleTolerance;
+  double m_energyTolerance;
+};
+
+SolarAccuracyTestCase::SolarAccuracyTestCase (std::string name, AccuracyMode mode,
+                                              double sampleTolerance, double energyTolerance)
+  : TestCase ("Accuracy of " + name + " against the golden series"),
+    m_mode (mode),
+    m_sampleTolerance (sampleTolerance),
+    m_energyTolerance (energyTolerance)
+{
+  SetDataDir (NS_TEST_SOURCEDIR);
+}
+
+std::vector<double>
+SolarAccuracyTestCase::GetSeries (const GoldenSeries &golden, uint32_t c, double *energy)
+{
+  SolarEnergyHarvester::Panel panel = golden.panels[c];
+  std::vector<double> series;
+  *energy = 0;
+
+  if (m_mode == DOUBLE_PROFILE_MODE || m_mode == QUANTIZED_16_MODE || m_mode == QUANTIZED_8_MODE)
+    {
+      SolarEnergyHarvester::ProfileFormat format = m_mode == QUANTIZED_16_MODE ? SolarEnergyHarvester::QUANTIZED_16_PROFILE
+        : m_mode == QUANTIZED_8_MODE ? SolarEnergyHarvester::QUANTIZED_8_PROFILE : SolarEnergyHarvester::DOUBLE_PROFILE;
+      Ptr<SolarEnergyProfile> profile = Create<SolarEnergyProfile> (panel, golden.startDate, Seconds (golden.step), format);
+      for (uint32_t i = 0; i < golden.samples; ++i)
+        {
+          series.push_back (profile->GetPower (i));
+        }
+      *energy = profile->GetEnergy (Seconds ((double) golden.samples * golden.step));
+      return series;
+    }
+
+  if (m_mode == SEGMENT_MODE)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      Ptr<SolarSegmentRecorder> source = CreateObject<SolarSegmentRecorder> ();
+      node->AggregateObject (source);
+      Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+      harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (1)));
+      harvester->SetAttribute ("PowerSegmentLength", TimeValue (Minutes (15)));
+      harvester->SetPanel (panel);
+      harvester->SetStartDate (golden.startDate);
+      source->ConnectEnergyHarvester (harvester);
+      harvester->SetNode (node);
+      harvester->SetEnergySource (source);
+      Simulator::Stop (Seconds ((double) golden.samples * golden.step));
+      Simulator::Run ();
+
+      // the samples fall within the segments, at 1 s updates
+      size_t k = 0;
+      for (uint32_t i = 0; i < golden.samples; ++i)
+        {
+          Time t = Seconds ((double) i * golden.step);
+          while (k + 1 < source->m_segments.size () && source->m_segments[k].GetEnd () <= t)
+            {
+              ++k;
+            }
+          double power = source->m_segments[k].GetPower (t);
+          series.push_back (power);
+          *energy += power * golden.step;
+        }
+      Simulator::Destroy ();
+      return series;
+    }
+
+  Ptr<SolarPowerWindow> window;
+  Ptr<SolarSharedProfile> sharedProfile;
+  std::ostringstream prefix;
+  prefix << "/sun-harvester-accuracy-" << getpid ();
+  if (m_mode == PREFETCH_MODE)
+    {
+      window = SolarPowerWindow::Get (panel, golden.startDate, Seconds (golden.step), 1024);
+    }
+  else if (m_mode == SHARED_PROFILE_MODE)
+    {
+      SolarSharedProfile::Remove (prefix.str (), panel, golden.startDate, Seconds (golden.step), golden.samples);
+      sharedProfile = Create<SolarSharedProfile> (prefix.str (), panel, golden.startDate, Seconds (golden.step), golden.samples);
+    }
+
+  Ptr<SolarSunTrack> track;
+  if (m_mode == SUN_TRACK_MODE)
+    {
+      track = Create<SolarSunTrack> (panel, golden.startDate, 600);
+    }
+  if (m_mode == FAST_MODE)
+    {
+      panel.sunPositionAlgorithm = Sun::FAST_ALGORITHM;
+    }
+  else if (m_mode == SPA_MODE)
+    {
+      panel.sunPositionAlgorithm = Sun::SPA_ALGORITHM;
+    }
+  Sun::Location location = Sun::GetLocation (panel.latitude, panel.longitude);
+
+  for (uint32_t i = 0; i < golden.samples; ++i)
+    {
+      tm date = golden.startDate;
+      Sun::AddSeconds (&date, (int64_t) i * golden.step);
+
+      double power = 0;
+      if (m_mode == SUN_TRACK_MODE)
+        {
+          power = track->GetPower ((double) i * golden.step);
+        }
+      else if (m_mode == PREFETCH_MODE)
+        {
+          // waiting for the worker, if behind
+          std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now () + std::chrono::seconds (10);
+          while (!window->GetPower (i, power) && std::chrono::steady_clock::now () < timeout)
+            {
+              std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            }
+        }
+      else if (m_mode == SHARED_PROFILE_MODE)
+        {
+          sharedProfile->GetPower (i, power);
+        }
+      else if (m_mode == TWO_STAGE_MODE)
+        {
+          Sun::Coordinates coordinates;
+          Sun::PSA (Sun::GetSharedCelestialState (&date), location, &coordinates);
+          double insolation = SolarEnergyHarvester::GetPanelInsolation (coordinates, panel.airMass, panel.panelTiltAngle,
+                                                                        panel.panelAzimuthAngle, panel.diffusePercentage);
+          power = insolation * (panel.solarCellEfficiency / 100) * (panel.dcdcEfficiency / 100) * panel.panelDimension;
+        }
+      else
+        {
+          power = SolarEnergyHarvester::CalculateHarvestedPower (&date, panel);
+        }
+      series.push_back (power);
+      *energy += power * golden.step;
+    }
+
+  if (m_mode == PREFETCH_MODE)
+    {
+      window = 0;
+      SolarPowerWindow::ClearCache ();
+    }
+  else if (m_mode == SHARED_PROFILE_MODE)
+    {
+      sharedProfile = 0;
+      SolarSharedProfile::Remove (prefix.str (), panel, golden.startDate, Seconds (golden.step), golden.samples);
+    }
+  return series;
+}
+
+void
+SolarAccuracyTestCase::DoRun ()
+{
+  GoldenSeries golden;
+  bool loaded = LoadGoldenSeries (CreateDataDirFilename ("data/sun-harvester-golden.txt"), &golden);
+  NS_TEST_ASSERT_MSG_EQ (loaded, true, "Cannot load the golden series");
+
+  for (uint32_t c = 0; c < golden.panels.size (); ++c)
+    {
+      double peak = *std::max_element (golden.power[c].begin (), golden.power[c].end ());
+      double goldenEnergy = 0;
+      for (uint32_t i = 0; i < golden.samples; ++i)
+        {
+          goldenEnergy += golden.power[c][i] * golden.step;
+        }
+
+      double energy;
+      std::vector<double> series = GetSeries (golden, c, &energy);
+      for (uint32_t i = 0; i < golden.samples; ++i)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (series[i], golden.power[c][i], m_sampleTolerance * peak,
+                                     "Config " << golden.names[c] << ", sample " << i << " out of tolerance");
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (energy, goldenEnergy, m_energyTolerance * goldenEnergy,
+                                 "Config " << golden.names[c] << ", yearly energy out of tolerance");
+    }
+}
+
+/**
+ * Every fast path of the model, with its tolerances: a path made faster
+ * has to stay within them, or have them revised on purpose.
+ */
+class SolarAccuracyTestSuite : public TestSuite
+{
+public:
+  SolarAccuracyTestSuite ();
+};
+
+SolarAccuracyTestSuite::SolarAccuracyTestSuite ()
+  : TestSuite ("sun-harvester-accuracy", UNIT)
+{
+  // per-sample tolerance, of the yearly peak; yearly energy tolerance
+  AddTestCase (new SolarAccuracyTestCase ("PSA", REFERENCE_MODE, 1e-9, 1e-9), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("two-stage PSA", TWO_STAGE_MODE, 1e-9, 1e-9), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("Fast", FAST_MODE, 1e-2, 2e-3), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("SPA", SPA_MODE, 5e-4, 1e-4), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("sun track", SUN_TRACK_MODE, 1e-3, 1e-6), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("double profile", DOUBLE_PROFILE_MODE, 1e-9, 1e-9), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("Quantized16 profile", QUANTIZED_16_MODE, 1e-5, 1e-6), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("Quantized8 profile", QUANTIZED_8_MODE, 2e-3, 1e-4), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("prefetch window", PREFETCH_MODE, 1e-9, 1e-9), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("shared profile", SHARED_PROFILE_MODE, 1e-9, 1e-9), TestCase::QUICK);
+  AddTestCase (new SolarAccuracyTestCase ("power segments", SEGMENT_MODE, 2e-4, 1e-6), TestCase::QUICK);
+}
+
+// create an instance of the test suite
+static SolarAccuracyTestSuite g_solarAccuracyTestSuite;
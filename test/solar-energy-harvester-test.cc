@@ -22,12 +22,43 @@
 #include <ns3/log.h>
 #include <ns3/test.h>
 #include <ns3/node.h>
+#include <ns3/node-container.h>
+#include <ns3/energy-source-container.h>
 #include <ns3/simulator.h>
 #include <ns3/double.h>
+#include <ns3/enum.h>
+#include <ns3/pointer.h>
+#include <ns3/uinteger.h>
 #include <ns3/config.h>
 #include <ns3/string.h>
+#include <ns3/boolean.h>
+#include <ns3/constant-velocity-mobility-model.h>
 #include <ns3/solar-energy-harvester.h>
+#include <ns3/solar-energy-harvester-helper.h>
+#include <ns3/solar-cloud-model.h>
+#include <ns3/solar-energy-predictor.h>
 #include <ns3/basic-energy-source.h>
+#include <ns3/solar-energy-profile.h>
+#include <ns3/solar-irradiance-dataset.h>
+#include <ns3/solar-irradiance-field.h>
+#include <ns3/solar-shared-profile.h>
+#include <ns3/solar-power-segment.h>
+#include <ns3/solar-power-window.h>
+#include <ns3/solar-segment-energy-source.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 using namespace ns3;
 
@@ -125,6 +156,1575 @@ SolarEnergyHarvesterTestCase::DoRun ()
 
 }
 
+/**
+ * Checks that ScheduleOnPowerThreshold notifies the same crossings, at the
+ * same times, as inspecting every HarvestedPower update.
+ */
+class SolarEnergyHarvesterThresholdTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterThresholdTestCase ();
+
+  void DoRun (void);
+
+  void HarvestedPower (double oldValue, double newValue);
+  void ThresholdCrossed (bool above);
+
+  double m_threshold;
+  std::vector<std::pair<Time, bool> > m_traced;    // crossings seen on the HarvestedPower trace
+  std::vector<std::pair<Time, bool> > m_scheduled; // crossings notified by ScheduleOnPowerThreshold
+};
+
+SolarEnergyHarvesterThresholdTestCase::SolarEnergyHarvesterThresholdTestCase ()
+  : TestCase ("Sun Energy Harvester power threshold test case"),
+    m_threshold (0)
+{
+}
+
+void
+SolarEnergyHarvesterThresholdTestCase::HarvestedPower (double oldValue, double newValue)
+{
+  if ((oldValue >= m_threshold) != (newValue >= m_threshold))
+    {
+      m_traced.push_back (std::make_pair (Simulator::Now (), newValue >= m_threshold));
+    }
+}
+
+void
+SolarEnergyHarvesterThresholdTestCase::ThresholdCrossed (bool above)
+{
+  m_scheduled.push_back (std::make_pair (Simulator::Now (), above));
+}
+
+void
+SolarEnergyHarvesterThresholdTestCase::DoRun ()
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+  node->AggregateObject (source);
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-21 00:00:00"));
+  harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  source->ConnectEnergyHarvester (harvester);
+  harvester->SetNode (node);
+  harvester->SetEnergySource (source);
+
+  // half of the power at noon
+  tm noon = harvester->GetDate ();
+  noon.tm_hour += 12;
+  time_t when = mktime (&noon);
+  localtime_r (&when, &noon);
+  m_threshold = harvester->CalculateHarvestedPower (&noon) / 2;
+  NS_TEST_ASSERT_MSG_GT (m_threshold, 0, "No power at noon");
+
+  harvester->TraceConnectWithoutContext ("HarvestedPower",
+                                         MakeCallback (&SolarEnergyHarvesterThresholdTestCase::HarvestedPower, this));
+  harvester->ScheduleOnPowerThreshold (m_threshold,
+                                       MakeCallback (&SolarEnergyHarvesterThresholdTestCase::ThresholdCrossed, this));
+
+  Simulator::Stop (Days (2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_traced.size (), 4, "Expected a rising and a falling crossing per day");
+  NS_TEST_ASSERT_MSG_EQ (m_scheduled.size (), m_traced.size (), "Wrong number of notified crossings");
+  for (uint32_t i = 0; i < m_traced.size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_scheduled[i].first, m_traced[i].first, "Crossing notified at the wrong time");
+      NS_TEST_ASSERT_MSG_EQ (m_scheduled[i].second, m_traced[i].second, "Crossing notified in the wrong direction");
+    }
+}
+
+/**
+ * Runs replications of the harvester computations (the power of every
+ * update, a shared energy profile and the energy queries of harvester
+ * objects) in concurrent threads and checks that the results are
+ * bit-identical to the ones of serial runs, and that the counters of the
+ * threads add up.
+ */
+class SolarEnergyHarvesterReplicationsTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterReplicationsTestCase ();
+
+  void DoRun (void);
+
+  static void RunReplication (SolarEnergyHarvester::Panel panel, tm startDate, SolarEnergyProfile *profile,
+                              uint32_t replication, std::vector<double> *results);
+
+  /**
+   * The hourly energy of harvester over two days, from its energy profile
+   */
+  static void RunHarvester (SolarEnergyHarvester *harvester, std::vector<double> *results);
+
+  /**
+   * Evaluate the sun position evaluations times
+   */
+  static void RunSunPositions (uint32_t evaluations);
+};
+
+SolarEnergyHarvesterReplicationsTestCase::SolarEnergyHarvesterReplicationsTestCase ()
+  : TestCase ("Sun Energy Harvester concurrent replications test case")
+{
+}
+
+void
+SolarEnergyHarvesterReplicationsTestCase::RunReplication (SolarEnergyHarvester::Panel panel, tm startDate,
+                                                          SolarEnergyProfile *profile, uint32_t replication,
+                                                          std::vector<double> *results)
+{
+  // no ns-3 object nor Time is created here, as they are not thread-safe
+  panel.latitude += replication;
+  panel.sunPositionAlgorithm = (Sun::PositionAlgorithm) (replication % 3);
+  tm date = startDate;
+  for (uint32_t i = 0; i < 2 * SECONDS_IN_DAY / 60; ++i)
+    {
+      results->push_back (SolarEnergyHarvester::CalculateHarvestedPower (&date, panel));
+      results->push_back (profile->GetPower (i * (replication + 1)));
+      Sun::AddSeconds (&date, 60);
+    }
+}
+
+void
+SolarEnergyHarvesterReplicationsTestCase::RunHarvester (SolarEnergyHarvester *harvester, std::vector<double> *results)
+{
+  for (uint32_t h = 0; h < 48; ++h)
+    {
+      results->push_back (harvester->GetEnergyBetween (Hours (h), Hours (h + 1)));
+    }
+}
+
+void
+SolarEnergyHarvesterReplicationsTestCase::RunSunPositions (uint32_t evaluations)
+{
+  struct tm date;
+  memset (&date, 0, sizeof (date));
+  date.tm_year = 115;
+  date.tm_mday = 1;
+  for (uint32_t i = 0; i < evaluations; ++i)
+    {
+      Sun::Coordinates coordinates;
+      Sun::PSA (&date, 38.11, 15.661, &coordinates);
+      Sun::AddSeconds (&date, 60);
+    }
+}
+
+void
+SolarEnergyHarvesterReplicationsTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  const uint32_t replications = 8;
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-03-28 12:00:00"));
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+  tm startDate = harvester->GetDate ();
+
+  std::vector<std::vector<double> > serial (replications);
+  Ptr<SolarEnergyProfile> serialProfile = Create<SolarEnergyProfile> (panel, startDate, Seconds (60));
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      RunReplication (panel, startDate, PeekPointer (serialProfile), r, &serial[r]);
+    }
+
+  std::vector<std::vector<double> > concurrent (replications);
+  Ptr<SolarEnergyProfile> sharedProfile = Create<SolarEnergyProfile> (panel, startDate, Seconds (60));
+  std::vector<std::thread> threads;
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads.push_back (std::thread (&RunReplication, panel, startDate, PeekPointer (sharedProfile), r, &concurrent[r]));
+    }
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads[r].join ();
+    }
+
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      NS_TEST_ASSERT_MSG_EQ (concurrent[r].size (), serial[r].size (), "Wrong number of results");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&concurrent[r][0], &serial[r][0], serial[r].size () * sizeof (double)), 0,
+                             "Concurrent results differ from the serial ones");
+    }
+
+  // harvester objects, two per site, sharing their profiles; Run clears the
+  // marked times, so that the threads can create Time values
+  Simulator::Run ();
+  std::vector<Ptr<SolarEnergyHarvester> > harvesters;
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      harvesters.push_back (CreateObject<SolarEnergyHarvester> ());
+      harvesters[r]->SetAttribute ("StartAt", StringValue ("2015-03-28 00:00:00"));
+      harvesters[r]->SetAttribute ("Latitude", DoubleValue (38.11 + r / 2));
+    }
+  SolarEnergyProfile::ClearCache ();
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      serial[r].clear ();
+      RunHarvester (PeekPointer (harvesters[r]), &serial[r]);
+    }
+  SolarEnergyProfile::ClearCache ();
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      harvesters[r] = CreateObject<SolarEnergyHarvester> ();
+      harvesters[r]->SetAttribute ("StartAt", StringValue ("2015-03-28 00:00:00"));
+      harvesters[r]->SetAttribute ("Latitude", DoubleValue (38.11 + r / 2));
+      concurrent[r].clear ();
+    }
+  threads.clear ();
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads.push_back (std::thread (&RunHarvester, PeekPointer (harvesters[r]), &concurrent[r]));
+    }
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads[r].join ();
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&concurrent[r][0], &serial[r][0], serial[r].size () * sizeof (double)), 0,
+                             "Concurrent harvester results differ from the serial ones");
+    }
+  harvesters.clear ();
+  Simulator::Destroy ();
+
+  // the per-thread counters of all the threads add up
+  Sun::EnableCounters (true);
+  uint64_t evaluations = Sun::GetPsaEvaluations ();
+  threads.clear ();
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads.push_back (std::thread (&RunSunPositions, 10000));
+    }
+  for (uint32_t r = 0; r < replications; ++r)
+    {
+      threads[r].join ();
+    }
+  Sun::EnableCounters (false);
+  NS_TEST_ASSERT_MSG_EQ (Sun::GetPsaEvaluations () - evaluations, replications * 10000, "Sun position evaluations lost");
+}
+
+/**
+ * Checks the quantized energy profiles against the double one over a week:
+ * every power within half a quantization level of the peak, the energy
+ * equal to the integral of the quantized power, and the smaller memory.
+ */
+class SolarEnergyHarvesterQuantizedProfileTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterQuantizedProfileTestCase ();
+
+  void DoRun (void);
+};
+
+SolarEnergyHarvesterQuantizedProfileTestCase::SolarEnergyHarvesterQuantizedProfileTestCase ()
+  : TestCase ("Sun Energy Harvester quantized profile test case")
+{
+}
+
+void
+SolarEnergyHarvesterQuantizedProfileTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-18 00:00:00"));
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+  tm startDate = harvester->GetDate ();
+
+  const uint32_t samples = 7 * SECONDS_IN_DAY / 60;
+  Ptr<SolarEnergyProfile> exact = Create<SolarEnergyProfile> (panel, startDate, Seconds (60));
+  double peak = 0;
+  for (uint32_t i = 0; i < samples; ++i)
+    {
+      peak = std::max (peak, exact->GetPower (i));
+    }
+
+  SolarEnergyHarvester::ProfileFormat formats[] = { SolarEnergyHarvester::QUANTIZED_16_PROFILE,
+                                                    SolarEnergyHarvester::QUANTIZED_8_PROFILE };
+  double levels[] = { 0xffff, 0xff };
+  for (uint32_t f = 0; f < 2; ++f)
+    {
+      Ptr<SolarEnergyProfile> quantized = Create<SolarEnergyProfile> (panel, startDate, Seconds (60), formats[f], 100);
+      double energy = 0;
+      for (uint32_t i = 0; i < samples; ++i)
+        {
+          double power = quantized->GetPower (i);
+          NS_TEST_ASSERT_MSG_EQ_TOL (power, exact->GetPower (i), 0.5001 * peak / levels[f], "Quantized power out of bound");
+          energy += power * 60;
+        }
+      // the power of every update is accounted over the interval before it
+      energy += (quantized->GetPower (samples) - quantized->GetPower (0)) * 60;
+      NS_TEST_ASSERT_MSG_EQ_TOL (quantized->GetEnergy (Seconds (samples * 60.0)), energy, energy * 1e-12,
+                                 "The energy is not the integral of the quantized power");
+      NS_TEST_ASSERT_MSG_LT (quantized->GetMemoryUsage () * 4, exact->GetMemoryUsage (), "Quantized profile too large");
+    }
+}
+
+/**
+ * Checks the energy profile queries against the energy a harvester
+ * provides: GetForecast, from the start, against the energy harvested in
+ * every hour, and GetEnergyBetween after a panel change. The forecast of
+ * a harvester with a CloudModel is the clear-sky one.
+ */
+class SolarEnergyHarvesterForecastTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterForecastTestCase ();
+
+  void DoRun (void);
+
+private:
+  void TotalEnergyHarvested (double oldValue, double newValue);
+
+  /**
+   * Record the total energy harvested
+   */
+  void Sample (void);
+
+  /**
+   * Record the forecast of the next three hours
+   */
+  void Forecast (Ptr<SolarEnergyHarvester> harvester, std::vector<double> *forecast);
+
+  /**
+   * Change the panel, and record the energy expected until the end
+   */
+  void ChangePanel (Ptr<SolarEnergyHarvester> harvester);
+
+  double m_totalEnergy;
+  std::vector<double> m_samples;
+  std::vector<double> m_forecast;
+  std::vector<double> m_cloudyForecast;
+  double m_expectedEnergy;
+};
+
+SolarEnergyHarvesterForecastTestCase::SolarEnergyHarvesterForecastTestCase ()
+  : TestCase ("Sun Energy Harvester forecast test case"),
+    m_totalEnergy (0),
+    m_expectedEnergy (0)
+{
+}
+
+void
+SolarEnergyHarvesterForecastTestCase::TotalEnergyHarvested (double oldValue, double newValue)
+{
+  m_totalEnergy = newValue;
+}
+
+void
+SolarEnergyHarvesterForecastTestCase::Sample (void)
+{
+  m_samples.push_back (m_totalEnergy);
+}
+
+void
+SolarEnergyHarvesterForecastTestCase::Forecast (Ptr<SolarEnergyHarvester> harvester, std::vector<double> *forecast)
+{
+  *forecast = harvester->GetForecast (Hours (3), Hours (1));
+}
+
+void
+SolarEnergyHarvesterForecastTestCase::ChangePanel (Ptr<SolarEnergyHarvester> harvester)
+{
+  harvester->SetAttribute ("PanelTiltAngle", DoubleValue (10));
+  m_expectedEnergy = harvester->GetEnergyBetween (Hours (3), Hours (6));
+}
+
+void
+SolarEnergyHarvesterForecastTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+  node->AggregateObject (source);
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-18 06:00:00"));
+  harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  harvester->TraceConnectWithoutContext ("TotalEnergyHarvested",
+                                         MakeCallback (&SolarEnergyHarvesterForecastTestCase::TotalEnergyHarvested, this));
+  source->ConnectEnergyHarvester (harvester);
+  harvester->SetNode (node);
+  harvester->SetEnergySource (source);
+
+  Ptr<Node> cloudyNode = CreateObject<Node> ();
+  Ptr<BasicEnergySource> cloudySource = CreateObject<BasicEnergySource> ();
+  cloudyNode->AggregateObject (cloudySource);
+  Ptr<SolarEnergyHarvester> cloudy = CreateObject<SolarEnergyHarvester> ();
+  cloudy->SetAttribute ("StartAt", StringValue ("2015-06-18 06:00:00"));
+  cloudy->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  cloudy->SetAttribute ("CloudModel", PointerValue (CreateObject<SolarCloudModel> ()));
+  cloudySource->ConnectEnergyHarvester (cloudy);
+  cloudy->SetNode (cloudyNode);
+  cloudy->SetEnergySource (cloudySource);
+
+  // the samples follow the hourly updates
+  Simulator::Schedule (Seconds (0), &SolarEnergyHarvesterForecastTestCase::Forecast, this, harvester, &m_forecast);
+  Simulator::Schedule (Seconds (0), &SolarEnergyHarvesterForecastTestCase::Forecast, this, cloudy, &m_cloudyForecast);
+  for (uint32_t h = 0; h <= 6; ++h)
+    {
+      Simulator::Schedule (Hours (h) + Seconds (1), &SolarEnergyHarvesterForecastTestCase::Sample, this);
+    }
+  Simulator::Schedule (Hours (3) - Seconds (30), &SolarEnergyHarvesterForecastTestCase::ChangePanel, this, harvester);
+  Simulator::Stop (Hours (6) + Seconds (2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_forecast.size (), 3, "Wrong number of forecast slots");
+  NS_TEST_ASSERT_MSG_EQ (m_cloudyForecast.size (), 3, "Wrong number of forecast slots");
+  NS_TEST_ASSERT_MSG_EQ (m_samples.size (), 7, "Wrong number of samples");
+  for (uint32_t h = 0; h < 3; ++h)
+    {
+      double energy = m_samples[h + 1] - m_samples[h];
+      NS_TEST_ASSERT_MSG_GT (energy, 0, "No energy harvested in the morning");
+      NS_TEST_ASSERT_MSG_EQ_TOL (m_forecast[h], energy, energy * 1e-9, "Forecast differs from the harvested energy");
+      NS_TEST_ASSERT_MSG_EQ (m_cloudyForecast[h], m_forecast[h], "The forecast is not the clear-sky one");
+    }
+  double energy = m_samples[6] - m_samples[3];
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_expectedEnergy, energy, energy * 1e-9,
+                             "Energy after the panel change differs from the harvested one");
+}
+
+/**
+ * Checks the replay of a measured irradiance dataset: the interpolation of
+ * the records, the missing samples, the plane of array transposition of a
+ * flat panel, equal to GHI, and the power of a harvester reading it.
+ */
+class SolarEnergyHarvesterMeasuredIrradianceTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterMeasuredIrradianceTestCase ();
+
+  void DoRun (void);
+
+  void ThresholdCrossed (bool above);
+
+  std::vector<bool> m_crossings; // crossings notified by ScheduleOnPowerThreshold
+};
+
+SolarEnergyHarvesterMeasuredIrradianceTestCase::SolarEnergyHarvesterMeasuredIrradianceTestCase ()
+  : TestCase ("Sun Energy Harvester measured irradiance test case")
+{
+}
+
+void
+SolarEnergyHarvesterMeasuredIrradianceTestCase::ThresholdCrossed (bool above)
+{
+  m_crossings.push_back (above);
+}
+
+void
+SolarEnergyHarvesterMeasuredIrradianceTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+  node->AggregateObject (source);
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-18 06:00:00"));
+  harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  tm startDate = harvester->GetDate ();
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+
+  // a day of consistent clear-sky records, one per minute, with the sun of
+  // their time stamps and a missing one
+  SolarIrradianceDataset::Header header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, SolarIrradianceDataset::MAGIC, sizeof (header.magic));
+  header.version = SolarIrradianceDataset::VERSION;
+  header.recordSize = sizeof (SolarIrradianceDataset::Record);
+  header.start = Sun::GetUnixTime (&startDate);
+  header.step = 60;
+  header.records = 24 * 60;
+  header.latitude = header.longitude = header.altitude = NAN;
+  std::vector<SolarIrradianceDataset::Record> records (header.records);
+  std::vector<Sun::Coordinates> positions (header.records);
+  for (uint32_t i = 0; i < header.records; ++i)
+    {
+      tm date = startDate;
+      Sun::AddSeconds (&date, (int64_t) i * header.step - SECONDS_IN_HOUR);
+      Sun::PSA (&date, panel.latitude, panel.longitude, &positions[i]);
+      double cosZenith = std::max (cos (positions[i].dZenithAngle * rad), 0.0);
+      records[i].dni = positions[i].dElevationAngle > 0 ? 800 : 0;
+      records[i].dhi = positions[i].dElevationAngle > 0 ? 100 : 0;
+      records[i].ghi = records[i].dni * cosZenith + records[i].dhi;
+    }
+  records[100].dhi = NAN;
+
+  std::string filename = CreateTempDirFilename ("measured-irradiance.irr");
+  FILE *file = fopen (filename.c_str (), "wb");
+  NS_TEST_ASSERT_MSG_EQ (file != 0, true, "Cannot write the dataset");
+  fwrite (&header, sizeof (header), 1, file);
+  fwrite (&records[0], sizeof (records[0]), records.size (), file);
+  fclose (file);
+
+  Ptr<SolarIrradianceDataset> dataset = SolarIrradianceDataset::Get (filename);
+  NS_TEST_ASSERT_MSG_EQ (dataset->GetEnd (), header.start + 24 * SECONDS_IN_HOUR, "Wrong dataset end");
+  SolarIrradianceDataset::Record record;
+  NS_TEST_ASSERT_MSG_EQ (dataset->GetIrradiance (header.start - 1, record), false, "Record before the start");
+  NS_TEST_ASSERT_MSG_EQ (dataset->GetIrradiance (header.start + 300 * 60 + 30, record), true, "Record not found");
+  NS_TEST_ASSERT_MSG_EQ_TOL (record.ghi, (records[300].ghi + records[301].ghi) / 2, 1e-3, "Wrong interpolation");
+  dataset->GetIrradiance (header.start + 100 * 60 + 30, record);
+  NS_TEST_ASSERT_MSG_EQ_TOL (record.dhi, records[101].dhi, 1e-3, "A missing sample is not skipped");
+  for (uint32_t i = 0; i < header.records; i += 37)
+    {
+      double flat = SolarIrradianceDataset::GetPlaneOfArrayIrradiance (records[i], positions[i], 0, 0, 0.2);
+      NS_TEST_ASSERT_MSG_EQ_TOL (flat, records[i].ghi, 1e-3, "A flat panel does not receive GHI");
+    }
+
+  harvester->SetAttribute ("IrradianceDataset", StringValue (filename));
+  source->ConnectEnergyHarvester (harvester);
+  harvester->SetNode (node);
+  harvester->SetEnergySource (source);
+
+  // the last update, at 6 hours, reads the record of 6 hours
+  Simulator::Stop (Hours (6) + NanoSeconds (1));
+  Simulator::Run ();
+  double power = records[360].ghi * (panel.solarCellEfficiency / 100) * (panel.dcdcEfficiency / 100) * panel.panelDimension;
+  NS_TEST_ASSERT_MSG_EQ_TOL (harvester->GetPower (), power, power * 1e-6, "Wrong measured power");
+  Simulator::Destroy ();
+
+  // up to the last record, a threshold watch scanning every update: the
+  // 45 s updates fall between the records, and the scan past the last one
+  Ptr<SolarEnergyHarvester> watched = CreateObject<SolarEnergyHarvester> ();
+  watched->SetAttribute ("StartAt", StringValue ("2015-06-18 06:00:00"));
+  watched->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (45)));
+  watched->SetAttribute ("ThresholdScanStep", TimeValue (Seconds (45)));
+  watched->SetAttribute ("IrradianceDataset", StringValue (filename));
+  Ptr<Node> watchedNode = CreateObject<Node> ();
+  Ptr<BasicEnergySource> watchedSource = CreateObject<BasicEnergySource> ();
+  watchedNode->AggregateObject (watchedSource);
+  watchedSource->ConnectEnergyHarvester (watched);
+  watched->SetNode (watchedNode);
+  watched->SetEnergySource (watchedSource);
+  watched->ScheduleOnPowerThreshold (power / 2,
+                                     MakeCallback (&SolarEnergyHarvesterMeasuredIrradianceTestCase::ThresholdCrossed, this));
+
+  // and the power segments, whose last one ends at the last record, against
+  // the periodic updates
+  Ptr<SolarEnergyHarvester> harvesters[2];
+  Ptr<EnergySource> sources[2];
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      if (i == 1)
+        {
+          sources[i] = CreateObject<SolarSegmentEnergySource> ();
+        }
+      else
+        {
+          sources[i] = CreateObject<BasicEnergySource> ();
+        }
+      node->AggregateObject (sources[i]);
+      harvesters[i] = CreateObject<SolarEnergyHarvester> ();
+      harvesters[i]->SetAttribute ("StartAt", StringValue ("2015-06-18 06:00:00"));
+      harvesters[i]->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+      harvesters[i]->SetAttribute ("IrradianceDataset", StringValue (filename));
+      if (i == 1)
+        {
+          harvesters[i]->SetAttribute ("PowerSegmentLength", TimeValue (Minutes (15)));
+        }
+      sources[i]->ConnectEnergyHarvester (harvesters[i]);
+      harvesters[i]->SetNode (node);
+      harvesters[i]->SetEnergySource (sources[i]);
+    }
+
+  Simulator::Stop (Seconds (dataset->GetLast () - header.start));
+  Simulator::Run ();
+  double periodic = sources[0]->GetRemainingEnergy () - sources[0]->GetInitialEnergy ();
+  double segments = sources[1]->GetRemainingEnergy () - sources[1]->GetInitialEnergy ();
+  Simulator::Destroy ();
+  NS_TEST_ASSERT_MSG_EQ (m_crossings.size (), 2, "Expected a rising and a falling crossing");
+  NS_TEST_ASSERT_MSG_EQ (m_crossings[0], true, "The first crossing is not rising");
+  NS_TEST_ASSERT_MSG_EQ (m_crossings[1], false, "The second crossing is not falling");
+  NS_TEST_ASSERT_MSG_GT (periodic, 0, "No energy harvested");
+  NS_TEST_ASSERT_MSG_EQ_TOL (segments, periodic, periodic * 1e-3, "Wrong energy of the segments");
+  remove (filename.c_str ());
+}
+
+/**
+ * Checks that a shared memory profile, created or attached to, holds the
+ * power of every update, as computed by CalculateHarvestedPower, that the
+ * segment is removed when released unless kept, and the private fallback.
+ */
+class SolarEnergyHarvesterSharedProfileTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterSharedProfileTestCase ();
+
+  void DoRun (void);
+};
+
+SolarEnergyHarvesterSharedProfileTestCase::SolarEnergyHarvesterSharedProfileTestCase ()
+  : TestCase ("Sun Energy Harvester shared memory profile test case")
+{
+}
+
+void
+SolarEnergyHarvesterSharedProfileTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-18 00:00:00"));
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+  tm startDate = harvester->GetDate ();
+  const uint64_t samples = SECONDS_IN_DAY / 60;
+
+  std::ostringstream prefix;
+  prefix << "/sun-harvester-test-" << getpid ();
+  SolarSharedProfile::Remove (prefix.str (), panel, startDate, Seconds (60), samples);
+
+  // the second profile attaches to the segment of the first one
+  Ptr<SolarSharedProfile> created = Create<SolarSharedProfile> (prefix.str (), panel, startDate, Seconds (60), samples);
+  Ptr<SolarSharedProfile> attached = Create<SolarSharedProfile> (prefix.str (), panel, startDate, Seconds (60), samples);
+  if (created->IsShared ())
+    {
+      NS_TEST_ASSERT_MSG_EQ (created->IsCreator (), true, "The first profile did not create the segment");
+      NS_TEST_ASSERT_MSG_EQ (attached->IsShared (), true, "The second profile did not attach to the segment");
+      NS_TEST_ASSERT_MSG_EQ (attached->IsCreator (), false, "The second profile created the segment again");
+    }
+
+  for (uint64_t i = 0; i < samples; ++i)
+    {
+      tm date = startDate;
+      Sun::AddSeconds (&date, (int64_t) i * 60);
+      double power;
+      NS_TEST_ASSERT_MSG_EQ (attached->GetPower (i, power), true, "Update missing from the profile");
+      NS_TEST_ASSERT_MSG_EQ (power, SolarEnergyHarvester::CalculateHarvestedPower (&date, panel), "Wrong shared power");
+    }
+  double power;
+  NS_TEST_ASSERT_MSG_EQ (attached->GetPower (samples, power), false, "Update beyond the profile");
+
+  // the last profile releasing the segment removes it, unless kept
+  std::string name = SolarSharedProfile::GetSegmentName (prefix.str (), panel, startDate, Seconds (60), samples);
+  bool shared = created->IsShared ();
+  created = 0;
+  attached = 0;
+  int fd = shm_open (name.c_str (), O_RDONLY, 0);
+  NS_TEST_ASSERT_MSG_EQ (fd < 0, true, "The released segment was not removed");
+  if (shared)
+    {
+      Ptr<SolarSharedProfile> kept = Create<SolarSharedProfile> (prefix.str (), panel, startDate, Seconds (60), samples, true);
+      kept = 0;
+      fd = shm_open (name.c_str (), O_RDONLY, 0);
+      NS_TEST_ASSERT_MSG_EQ (fd >= 0, true, "The kept segment was removed");
+      close (fd);
+    }
+  SolarSharedProfile::Remove (prefix.str (), panel, startDate, Seconds (60), samples);
+
+  // a name too long for shared memory: the profile is computed in private
+  // memory, one day at a time
+  std::string longPrefix = prefix.str () + std::string (300, 'x');
+  Ptr<SolarSharedProfile> local = Create<SolarSharedProfile> (longPrefix, panel, startDate, Seconds (60), 3 * samples);
+  NS_TEST_ASSERT_MSG_EQ (local->IsShared (), false, "The profile is shared");
+  for (uint64_t i = 0; i < 3 * samples; i += 97)
+    {
+      tm date = startDate;
+      Sun::AddSeconds (&date, (int64_t) i * 60);
+      NS_TEST_ASSERT_MSG_EQ (local->GetPower (i, power), true, "Update missing from the private profile");
+      NS_TEST_ASSERT_MSG_EQ (power, SolarEnergyHarvester::CalculateHarvestedPower (&date, panel), "Wrong private power");
+    }
+  NS_TEST_ASSERT_MSG_EQ (local->GetPower (3 * samples, power), false, "Update beyond the private profile");
+}
+
+/**
+ * Checks that a cubic power segment is interpolated and integrated
+ * exactly, that a harvester publishing segments to a
+ * SolarSegmentEnergySource provides the energy of the periodic updates with
+ * far fewer notifications, and that it keeps the periodic updates with a
+ * BasicEnergySource.
+ */
+class SolarEnergyHarvesterPowerSegmentTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterPowerSegmentTestCase ();
+
+  void DoRun (void);
+};
+
+SolarEnergyHarvesterPowerSegmentTestCase::SolarEnergyHarvesterPowerSegmentTestCase ()
+  : TestCase ("Sun Energy Harvester power segment test case")
+{
+}
+
+void
+SolarEnergyHarvesterPowerSegmentTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  std::vector<double> offsets;
+  std::vector<double> power;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      double s = 300.0 * i;
+      offsets.push_back (s);
+      power.push_back (1 + s * (2e-3 + s * (-3e-6 + s * 4e-9)));
+    }
+  SolarPowerSegment segment (Seconds (10), Seconds (910), offsets, power);
+  NS_TEST_ASSERT_MSG_EQ_TOL (segment.GetCoefficient (3), 4e-9, 1e-15, "Wrong cubic term");
+  NS_TEST_ASSERT_MSG_EQ_TOL (segment.GetPower (Seconds (460)), 1 + 450 * (2e-3 + 450 * (-3e-6 + 450 * 4e-9)), 1e-9,
+                             "Wrong interpolated power");
+  double energy = 900 + 1e-3 * 900 * 900 - 1e-6 * pow (900, 3) + 1e-9 * pow (900, 4);
+  NS_TEST_ASSERT_MSG_EQ_TOL (segment.GetEnergy (Seconds (0), Seconds (1000)), energy, 1e-6, "Wrong segment energy");
+
+  // the periodic updates, the segments, and the segments requested with a
+  // source that does not understand them
+  Ptr<SolarEnergyHarvester> harvesters[3];
+  Ptr<EnergySource> sources[3];
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      if (i == 1)
+        {
+          sources[i] = CreateObject<SolarSegmentEnergySource> ();
+        }
+      else
+        {
+          sources[i] = CreateObject<BasicEnergySource> ();
+        }
+      node->AggregateObject (sources[i]);
+      harvesters[i] = CreateObject<SolarEnergyHarvester> ();
+      harvesters[i]->SetAttribute ("StartAt", StringValue ("2015-06-21 00:00:00"));
+      harvesters[i]->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+      if (i > 0)
+        {
+          harvesters[i]->SetAttribute ("PowerSegmentLength", TimeValue (Minutes (15)));
+        }
+      sources[i]->ConnectEnergyHarvester (harvesters[i]);
+      harvesters[i]->SetNode (node);
+      harvesters[i]->SetEnergySource (sources[i]);
+    }
+
+  Simulator::Stop (Days (1));
+  Simulator::Run ();
+  double periodic = sources[0]->GetRemainingEnergy () - sources[0]->GetInitialEnergy ();
+  double segments = sources[1]->GetRemainingEnergy () - sources[1]->GetInitialEnergy ();
+  double fallback = sources[2]->GetRemainingEnergy () - sources[2]->GetInitialEnergy ();
+  NS_TEST_ASSERT_MSG_GT (periodic, 0, "No energy harvested");
+  NS_TEST_ASSERT_MSG_EQ_TOL (segments, periodic, periodic * 1e-3, "Wrong energy of the segments");
+  NS_TEST_ASSERT_MSG_EQ_TOL (fallback, periodic, periodic * 1e-9, "A BasicEnergySource did not get the periodic updates");
+  NS_TEST_ASSERT_MSG_LT (harvesters[1]->GetEnergySourceNotifications () * 10, harvesters[0]->GetEnergySourceNotifications (),
+                         "Too many segment notifications");
+  NS_TEST_ASSERT_MSG_EQ (harvesters[2]->GetEnergySourceNotifications (), harvesters[0]->GetEnergySourceNotifications (),
+                         "Wrong periodic notifications");
+  Simulator::Destroy ();
+}
+
+/**
+ * Checks that a MobilityAware harvester moving straight, at a speed that
+ * does not divide MobilityUpdateDistance, updates its location once every
+ * MobilityUpdateDistance meters.
+ */
+class SolarEnergyHarvesterMobilityTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterMobilityTestCase ();
+
+  void DoRun (void);
+
+private:
+  /**
+   * Count the latitude changes, once per second
+   */
+  void Sample (Ptr<SolarEnergyHarvester> harvester);
+
+  double m_latitude;
+  uint32_t m_locationUpdates;
+};
+
+SolarEnergyHarvesterMobilityTestCase::SolarEnergyHarvesterMobilityTestCase ()
+  : TestCase ("Sun Energy Harvester mobility test case"),
+    m_latitude (NAN),
+    m_locationUpdates (0)
+{
+}
+
+void
+SolarEnergyHarvesterMobilityTestCase::Sample (Ptr<SolarEnergyHarvester> harvester)
+{
+  if (harvester->GetLatitude () != m_latitude)
+    {
+      m_latitude = harvester->GetLatitude ();
+      ++m_locationUpdates;
+    }
+  Simulator::Schedule (Seconds (1), &SolarEnergyHarvesterMobilityTestCase::Sample, this, harvester);
+}
+
+void
+SolarEnergyHarvesterMobilityTestCase::DoRun ()
+{
+  LogComponentDisable ("SolarEnergyHarvester", LOG_LEVEL_ALL);
+
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+  node->AggregateObject (source);
+  Ptr<ConstantVelocityMobilityModel> mobility = CreateObject<ConstantVelocityMobilityModel> ();
+  node->AggregateObject (mobility);
+  mobility->SetPosition (Vector (0, 0, 0));
+  // 100 m every 33.3 s: the wake-up delays are rounded to the nanosecond
+  mobility->SetVelocity (Vector (0, 3, 0));
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("MobilityAware", BooleanValue (true));
+  harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  source->ConnectEnergyHarvester (harvester);
+  harvester->SetNode (node);
+  harvester->SetEnergySource (source);
+
+  Simulator::Schedule (Seconds (0.5), &SolarEnergyHarvesterMobilityTestCase::Sample, this, harvester);
+  Simulator::Stop (Seconds (1010));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  // the initial location, then one every 100 m up to 3000 m
+  NS_TEST_ASSERT_MSG_EQ (m_locationUpdates, 31, "Wrong number of location updates");
+}
+
+/**
+ * Checks that cloud models with the same stream and area generate the same
+ * series, that the stream changes it, and that the series of two areas are
+ * correlated as SpatialCorrelation sets when they share the stream only.
+ */
+class SolarCloudModelTestCase : public TestCase
+{
+public:
+  SolarCloudModelTestCase ();
+
+  void DoRun (void);
+
+private:
+  /**
+   * \return a cloud model, unlikely to reach the clamping bounds
+   */
+  static Ptr<SolarCloudModel> CreateCloudModel (uint32_t area, int64_t stream);
+
+  /**
+   * \return the sample correlation of the series of a and b
+   */
+  static double GetCorrelation (Ptr<SolarCloudModel> a, Ptr<SolarCloudModel> b, uint32_t samples);
+};
+
+SolarCloudModelTestCase::SolarCloudModelTestCase ()
+  : TestCase ("Sun Energy Harvester cloud model streams test case")
+{
+}
+
+Ptr<SolarCloudModel>
+SolarCloudModelTestCase::CreateCloudModel (uint32_t area, int64_t stream)
+{
+  Ptr<SolarCloudModel> cloudModel = CreateObject<SolarCloudModel> ();
+  cloudModel->SetAttribute ("Mean", DoubleValue (0.5));
+  cloudModel->SetAttribute ("StdDev", DoubleValue (0.05));
+  cloudModel->SetAttribute ("Correlation", DoubleValue (0.5));
+  cloudModel->SetAttribute ("SpatialCorrelation", DoubleValue (0.6));
+  cloudModel->SetAttribute ("MinIndex", DoubleValue (0));
+  cloudModel->SetAttribute ("Area", UintegerValue (area));
+  cloudModel->AssignStreams (stream);
+  return cloudModel;
+}
+
+double
+SolarCloudModelTestCase::GetCorrelation (Ptr<SolarCloudModel> a, Ptr<SolarCloudModel> b, uint32_t samples)
+{
+  double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+  for (uint32_t i = 0; i < samples; ++i)
+    {
+      double x = a->GetClearSkyIndex (Minutes (i));
+      double y = b->GetClearSkyIndex (Minutes (i));
+      sumA += x;
+      sumB += y;
+      sumAA += x * x;
+      sumBB += y * y;
+      sumAB += x * y;
+    }
+  double covariance = sumAB / samples - (sumA / samples) * (sumB / samples);
+  double varianceA = sumAA / samples - (sumA / samples) * (sumA / samples);
+  double varianceB = sumBB / samples - (sumB / samples) * (sumB / samples);
+  return covariance / sqrt (varianceA * varianceB);
+}
+
+void
+SolarCloudModelTestCase::DoRun ()
+{
+  const uint32_t samples = 100000;
+
+  // reproducible, also when restarted by AssignStreams
+  Ptr<SolarCloudModel> first = CreateCloudModel (0, 7);
+  Ptr<SolarCloudModel> second = CreateCloudModel (0, 7);
+  Ptr<SolarCloudModel> other = CreateCloudModel (0, 8);
+  second->GetClearSkyIndex (Days (3));
+  second->AssignStreams (7);
+  bool differ = false;
+  for (uint32_t i = 0; i < 14400; ++i)
+    {
+      double index = first->GetClearSkyIndex (Minutes (i));
+      NS_TEST_ASSERT_MSG_EQ (second->GetClearSkyIndex (Minutes (i)), index, "Same stream, different series");
+      differ |= other->GetClearSkyIndex (Minutes (i)) != index;
+    }
+  NS_TEST_ASSERT_MSG_EQ (differ, true, "The stream does not change the series");
+
+  // the areas sharing the stream share the common innovations
+  NS_TEST_ASSERT_MSG_EQ_TOL (GetCorrelation (CreateCloudModel (0, 7), CreateCloudModel (1, 7), samples), 0.6, 0.02,
+                             "Wrong spatial correlation");
+  NS_TEST_ASSERT_MSG_EQ_TOL (GetCorrelation (CreateCloudModel (0, 7), CreateCloudModel (1, 8), samples), 0, 0.02,
+                             "Areas with different streams are correlated");
+}
+
+/**
+ * Checks the EWMA and WCMA predictions, over a few cloudy days, against the
+ * definitions of the predictors applied to the slot energies integrated
+ * from the HarvestedPower trace, and the slot energies of a harvester with
+ * power segments against the energy its source receives.
+ */
+class SolarEnergyPredictorTestCase : public TestCase
+{
+public:
+  SolarEnergyPredictorTestCase ();
+
+  void DoRun (void);
+
+private:
+  void HarvestedPower (double oldValue, double newValue);
+  void SamplePrediction (Ptr<SolarEnergyPredictor> predictor);
+  void SampleEnergy (Ptr<EnergySource> source);
+
+  /**
+   * \return the mean energy of the slots last - slotsPerDay, last - 2 slotsPerDay, ..., at most days of them
+   */
+  static double GetMean (const std::vector<double> &energy, int64_t last, uint32_t slotsPerDay, uint32_t days);
+
+  std::vector<std::pair<Time, double> > m_power; // <- The harvested power, from the time it holds
+  std::vector<double> m_predictions; // <- The prediction in the middle of every slot
+  std::vector<double> m_energy; // <- The energy of the source at the end of every slot
+};
+
+SolarEnergyPredictorTestCase::SolarEnergyPredictorTestCase ()
+  : TestCase ("Sun Energy Harvester EWMA and WCMA predictors test case")
+{
+}
+
+void
+SolarEnergyPredictorTestCase::HarvestedPower (double oldValue, double newValue)
+{
+  m_power.push_back (std::make_pair (Simulator::Now (), newValue));
+}
+
+void
+SolarEnergyPredictorTestCase::SamplePrediction (Ptr<SolarEnergyPredictor> predictor)
+{
+  m_predictions.push_back (predictor->GetPrediction ());
+}
+
+void
+SolarEnergyPredictorTestCase::SampleEnergy (Ptr<EnergySource> source)
+{
+  m_energy.push_back (source->GetRemainingEnergy ());
+}
+
+double
+SolarEnergyPredictorTestCase::GetMean (const std::vector<double> &energy, int64_t last, uint32_t slotsPerDay, uint32_t days)
+{
+  double sum = 0;
+  uint32_t n = 0;
+  for (int64_t slot = last - slotsPerDay; slot >= 0 && n < days; slot -= slotsPerDay, ++n)
+    {
+      sum += energy[slot];
+    }
+  return n > 0 ? sum / n : 0;
+}
+
+void
+SolarEnergyPredictorTestCase::DoRun ()
+{
+  const uint32_t slotsPerDay = 24;
+  const uint32_t days = 3;
+  const uint32_t k = 2;
+  const double alpha = 0.3;
+  const uint32_t slots = 6 * slotsPerDay;
+
+  for (int algorithm = SolarEnergyPredictor::EWMA; algorithm <= SolarEnergyPredictor::WCMA; ++algorithm)
+    {
+      m_power.clear ();
+      m_predictions.clear ();
+
+      Ptr<Node> node = CreateObject<Node> ();
+      Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+      node->AggregateObject (source);
+
+      // the clouds make the days, and the slots, differ
+      Ptr<SolarCloudModel> cloudModel = CreateObject<SolarCloudModel> ();
+      Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+      harvester->SetAttribute ("StartAt", StringValue ("2015-06-15 00:00:00"));
+      harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+      harvester->SetAttribute ("CloudModel", PointerValue (cloudModel));
+      source->ConnectEnergyHarvester (harvester);
+      harvester->SetNode (node);
+      harvester->SetEnergySource (source);
+
+      Ptr<SolarEnergyPredictor> predictor = CreateObject<SolarEnergyPredictor> ();
+      predictor->SetAttribute ("Algorithm", EnumValue (algorithm));
+      predictor->SetAttribute ("SlotsPerDay", UintegerValue (slotsPerDay));
+      predictor->SetAttribute ("Days", UintegerValue (days));
+      predictor->SetAttribute ("K", UintegerValue (k));
+      predictor->SetAttribute ("Alpha", DoubleValue (alpha));
+      m_power.push_back (std::make_pair (Seconds (0), harvester->GetPower ()));
+      harvester->TraceConnectWithoutContext ("HarvestedPower",
+                                             MakeCallback (&SolarEnergyPredictorTestCase::HarvestedPower, this));
+      predictor->SetHarvester (harvester);
+
+      Time slot = predictor->GetSlotDuration ();
+      for (uint32_t i = 0; i < slots; ++i)
+        {
+          Simulator::Schedule (TimeStep (slot.GetTimeStep () * i + slot.GetTimeStep () / 2), &SolarEnergyPredictorTestCase::SamplePrediction, this, predictor);
+        }
+      Simulator::Stop (TimeStep (slot.GetTimeStep () * slots));
+      Simulator::Run ();
+      Simulator::Destroy ();
+
+      // the energy of every slot, from the power steps
+      std::vector<double> energy (slots, 0);
+      for (uint32_t i = 0; i < m_power.size (); ++i)
+        {
+          Time end = i + 1 < m_power.size () ? m_power[i + 1].first : TimeStep (slot.GetTimeStep () * slots);
+          for (Time t = m_power[i].first; t < end; )
+            {
+              uint32_t n = t.GetTimeStep () / slot.GetTimeStep ();
+              Time next = std::min (end, TimeStep (slot.GetTimeStep () * (n + 1)));
+              energy[n] += m_power[i].second * (next - t).GetSeconds ();
+              t = next;
+            }
+        }
+
+      // the prediction made at the end of every slot
+      std::vector<double> ewma (slotsPerDay, 0);
+      std::vector<double> eta (slots, 1);
+      for (uint32_t n = 0; n + 1 < slots; ++n)
+        {
+          double expected;
+          uint32_t next = (n + 1) % slotsPerDay;
+          ewma[n % slotsPerDay] = n < slotsPerDay ? energy[n] : alpha * ewma[n % slotsPerDay] + (1 - alpha) * energy[n];
+          double mean = GetMean (energy, n, slotsPerDay, days);
+          eta[n] = mean > 0 ? energy[n] / mean : 1;
+          if (algorithm == SolarEnergyPredictor::EWMA)
+            {
+              expected = ewma[next];
+            }
+          else
+            {
+              double gap = 0;
+              double weights = 0;
+              for (uint32_t j = 0; j < k && j <= n; ++j)
+                {
+                  gap += double (k - j) / k * eta[n - j];
+                  weights += double (k - j) / k;
+                }
+              expected = alpha * energy[n] + (1 - alpha) * GetMean (energy, n + 1, slotsPerDay, days) * gap / weights;
+            }
+          NS_TEST_ASSERT_MSG_EQ_TOL (m_predictions[n + 1], expected, 1e-9 + 1e-9 * fabs (expected), "Wrong prediction");
+        }
+      NS_TEST_ASSERT_MSG_GT (*std::max_element (m_predictions.begin (), m_predictions.end ()), 0, "No energy predicted");
+    }
+
+  // with power segments, and Alpha 1, the prediction is the energy of the
+  // last slot, integrated from the segments
+  m_predictions.clear ();
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<SolarSegmentEnergySource> source = CreateObject<SolarSegmentEnergySource> ();
+  node->AggregateObject (source);
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-15 00:00:00"));
+  harvester->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  harvester->SetAttribute ("PowerSegmentLength", TimeValue (Minutes (15)));
+  source->ConnectEnergyHarvester (harvester);
+  harvester->SetNode (node);
+  harvester->SetEnergySource (source);
+
+  Ptr<SolarEnergyPredictor> predictor = CreateObject<SolarEnergyPredictor> ();
+  predictor->SetAttribute ("Algorithm", EnumValue (SolarEnergyPredictor::WCMA));
+  predictor->SetAttribute ("SlotsPerDay", UintegerValue (slotsPerDay));
+  predictor->SetAttribute ("Alpha", DoubleValue (1));
+  predictor->SetHarvester (harvester);
+
+  Time slot = predictor->GetSlotDuration ();
+  for (uint32_t i = 0; i < slotsPerDay; ++i)
+    {
+      Simulator::Schedule (TimeStep (slot.GetTimeStep () * i), &SolarEnergyPredictorTestCase::SampleEnergy, this, source);
+      Simulator::Schedule (TimeStep (slot.GetTimeStep () * i + slot.GetTimeStep () / 2), &SolarEnergyPredictorTestCase::SamplePrediction, this, predictor);
+    }
+  Simulator::Stop (TimeStep (slot.GetTimeStep () * slotsPerDay));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  double peak = 0;
+  for (uint32_t n = 0; n + 1 < slotsPerDay; ++n)
+    {
+      double energy = m_energy[n + 1] - m_energy[n];
+      peak = std::max (peak, energy);
+      NS_TEST_ASSERT_MSG_EQ_TOL (m_predictions[n + 1], energy, 1e-9 + 1e-9 * energy, "Wrong energy of a slot with power segments");
+    }
+  NS_TEST_ASSERT_MSG_GT (peak, 0, "No energy harvested");
+}
+
+/**
+ * Checks that InstallFromFile applies the records of a CSV spec file, with
+ * comments, blank lines and any node order, and of the equivalent binary
+ * file, and that malformed CSV lines are rejected.
+ */
+class SolarEnergyHarvesterSpecFileTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterSpecFileTestCase ();
+
+  void DoRun (void);
+
+private:
+  /**
+   * Check that the harvesters have the panels and start dates of specs.
+   */
+  void CheckHarvesters (EnergyHarvesterContainer harvesters,
+                        const std::vector<SolarEnergyHarvesterHelper::PanelSpec> &specs);
+};
+
+SolarEnergyHarvesterSpecFileTestCase::SolarEnergyHarvesterSpecFileTestCase ()
+  : TestCase ("Sun Energy Harvester panel spec file test case")
+{
+}
+
+void
+SolarEnergyHarvesterSpecFileTestCase::CheckHarvesters (EnergyHarvesterContainer harvesters,
+                                                       const std::vector<SolarEnergyHarvesterHelper::PanelSpec> &specs)
+{
+  NS_TEST_ASSERT_MSG_EQ (harvesters.GetN (), specs.size (), "Wrong number of harvesters");
+  for (uint32_t i = 0; i < harvesters.GetN (); ++i)
+    {
+      Ptr<SolarEnergyHarvester> harvester = DynamicCast<SolarEnergyHarvester> (harvesters.Get (i));
+      NS_TEST_ASSERT_MSG_EQ (harvester->GetNode ()->GetId (), specs[i].nodeId, "Harvester on the wrong node");
+      SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+      NS_TEST_ASSERT_MSG_EQ (panel.latitude, specs[i].latitude, "Wrong latitude");
+      NS_TEST_ASSERT_MSG_EQ (panel.longitude, specs[i].longitude, "Wrong longitude");
+      NS_TEST_ASSERT_MSG_EQ (panel.altitude, specs[i].altitude, "Wrong altitude");
+      NS_TEST_ASSERT_MSG_EQ (panel.panelTiltAngle, specs[i].panelTiltAngle, "Wrong tilt");
+      NS_TEST_ASSERT_MSG_EQ (panel.panelAzimuthAngle, specs[i].panelAzimuthAngle, "Wrong azimuth");
+      NS_TEST_ASSERT_MSG_EQ (panel.panelDimension, specs[i].panelDimension, "Wrong dimension");
+      NS_TEST_ASSERT_MSG_EQ (panel.solarCellEfficiency, specs[i].solarCellEfficiency, "Wrong cell efficiency");
+      NS_TEST_ASSERT_MSG_EQ (panel.dcdcEfficiency, specs[i].dcdcEfficiency, "Wrong DC/DC efficiency");
+      tm date = harvester->GetDate ();
+      NS_TEST_ASSERT_MSG_EQ (mktime (&date), specs[i].startTime, "Wrong start date");
+    }
+}
+
+void
+SolarEnergyHarvesterSpecFileTestCase::DoRun ()
+{
+  NodeContainer nodes;
+  nodes.Create (3);
+  EnergySourceContainer sources;
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+      nodes.Get (i)->AggregateObject (source);
+      sources.Add (source);
+    }
+
+  // two nodes out of order, sharing the date, and one later
+  std::ostringstream csv;
+  csv << "# nodeId,latitude,longitude,altitude,tilt,azimuth,dimension,cell,dcdc,date\n"
+      << nodes.Get (2)->GetId () << ",38.11,15.66,10,30,180,0.01,15,90,2015-06-18 06:00:00\n"
+      << "\n"
+      << nodes.Get (0)->GetId () << ",45.5,-9.25,0,0,90,0.02,20,85,2015-06-18 06:00:00 # inline comment\n"
+      << nodes.Get (1)->GetId () << ",-33.9,151.2,50,45,0,0.5,18.5,95,2015-12-21 12:30:15\n";
+
+  std::vector<SolarEnergyHarvesterHelper::PanelSpec> specs;
+  std::istringstream lines (csv.str ());
+  std::string line;
+  while (std::getline (lines, line))
+    {
+      SolarEnergyHarvesterHelper::PanelSpec spec;
+      line.erase (std::min (line.find ('#'), line.size ()));
+      if (line.find (',') != std::string::npos)
+        {
+          NS_TEST_ASSERT_MSG_EQ (SolarEnergyHarvesterHelper::ParsePanelSpec (line, spec), true, "Valid line rejected");
+          specs.push_back (spec);
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (specs.size (), 3, "Wrong number of records");
+  NS_TEST_ASSERT_MSG_EQ (specs[2].startTime - specs[1].startTime > 0, true, "Dates out of order");
+
+  std::ostringstream filename;
+  filename << "sun-harvester-test-" << getpid () << ".spec";
+  std::ofstream csvFile (filename.str ().c_str ());
+  csvFile << csv.str ();
+  csvFile.close ();
+
+  SolarEnergyHarvesterHelper helper;
+  helper.Set ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  EnergyHarvesterContainer fromCsv = helper.InstallFromFile (sources, filename.str ());
+  CheckHarvesters (fromCsv, specs);
+
+  // the same records, in binary form, on new nodes
+  NodeContainer binaryNodes;
+  binaryNodes.Create (3);
+  EnergySourceContainer binarySources;
+  for (uint32_t i = 0; i < binaryNodes.GetN (); ++i)
+    {
+      Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+      binaryNodes.Get (i)->AggregateObject (source);
+      binarySources.Add (source);
+    }
+  std::ofstream binaryFile (filename.str ().c_str (), std::ios::out | std::ios::binary);
+  binaryFile.write (SolarEnergyHarvesterHelper::SpecFileMagic, sizeof (SolarEnergyHarvesterHelper::SpecFileMagic));
+  for (uint32_t i = 0; i < specs.size (); ++i)
+    {
+      specs[i].nodeId += binaryNodes.Get (0)->GetId () - nodes.Get (0)->GetId ();
+      binaryFile.write (reinterpret_cast<const char *> (&specs[i]), sizeof (specs[i]));
+    }
+  binaryFile.close ();
+  EnergyHarvesterContainer fromBinary = helper.InstallFromFile (binarySources, filename.str ());
+  CheckHarvesters (fromBinary, specs);
+  remove (filename.str ().c_str ());
+
+  // the same panels and dates, installed by Install
+  NodeContainer referenceNodes;
+  referenceNodes.Create (3);
+  EnergyHarvesterContainer references;
+  for (uint32_t i = 0; i < referenceNodes.GetN (); ++i)
+    {
+      Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+      referenceNodes.Get (i)->AggregateObject (source);
+      Ptr<SolarEnergyHarvester> reference = DynamicCast<SolarEnergyHarvester> (helper.Install (source).Get (0));
+      SolarEnergyHarvester::Panel panel = reference->GetPanel ();
+      panel.latitude = specs[i].latitude;
+      panel.longitude = specs[i].longitude;
+      panel.altitude = specs[i].altitude;
+      panel.panelTiltAngle = specs[i].panelTiltAngle;
+      panel.panelAzimuthAngle = specs[i].panelAzimuthAngle;
+      panel.panelDimension = specs[i].panelDimension;
+      panel.solarCellEfficiency = specs[i].solarCellEfficiency;
+      panel.dcdcEfficiency = specs[i].dcdcEfficiency;
+      reference->SetPanel (panel);
+      time_t when = specs[i].startTime;
+      tm date;
+      localtime_r (&when, &date);
+      reference->SetStartDate (date);
+      references.Add (reference);
+    }
+
+  Simulator::Stop (Hours (10));
+  Simulator::Run ();
+
+  double totalPower = 0;
+  for (uint32_t i = 0; i < references.GetN (); ++i)
+    {
+      Ptr<SolarEnergyHarvester> reference = DynamicCast<SolarEnergyHarvester> (references.Get (i));
+      Ptr<SolarEnergyHarvester> csvHarvester = DynamicCast<SolarEnergyHarvester> (fromCsv.Get (i));
+      Ptr<SolarEnergyHarvester> binaryHarvester = DynamicCast<SolarEnergyHarvester> (fromBinary.Get (i));
+      NS_TEST_ASSERT_MSG_EQ (csvHarvester->GetUpdates (), reference->GetUpdates (), "Harvester from file not started");
+      NS_TEST_ASSERT_MSG_EQ (binaryHarvester->GetUpdates (), reference->GetUpdates (), "Harvester from file not started");
+      NS_TEST_ASSERT_MSG_EQ_TOL (csvHarvester->GetPower (), reference->GetPower (), 1e-12,
+                                 "Harvester from file differs from Install");
+      NS_TEST_ASSERT_MSG_EQ_TOL (binaryHarvester->GetPower (), reference->GetPower (), 1e-12,
+                                 "Harvester from file differs from Install");
+      Ptr<EnergyHarvesterContainer> onNode = csvHarvester->GetNode ()->GetObject<EnergyHarvesterContainer> ();
+      NS_TEST_ASSERT_MSG_NE (onNode, 0, "No harvester container aggregated to the node");
+      NS_TEST_ASSERT_MSG_EQ (onNode->Get (0), csvHarvester, "Wrong harvester aggregated to the node");
+      totalPower += reference->GetPower ();
+    }
+  NS_TEST_ASSERT_MSG_GT (DynamicCast<SolarEnergyHarvester> (references.Get (0))->GetUpdates (), 0, "No updates");
+  NS_TEST_ASSERT_MSG_GT (totalPower, 0, "No power harvested");
+
+  // malformed lines
+  const char *malformed[] = {
+    "",
+    "x,38.11,15.66,10,30,180,0.01,15,90,2015-06-18 06:00:00",
+    "1,38.11,15.66,10,30,180,0.01,15,90",
+    "1,38.11,,10,30,180,0.01,15,90,2015-06-18 06:00:00",
+    "1;38.11;15.66;10;30;180;0.01;15;90;2015-06-18 06:00:00",
+    "1,38.11,15.66,10,30,180,0.01,15,90,18/06/2015 06:00",
+    "1,38.11,15.66,10,30,180,0.01,15,90,2015-13-18 06:00:00"
+  };
+  for (size_t i = 0; i < sizeof (malformed) / sizeof (malformed[0]); ++i)
+    {
+      SolarEnergyHarvesterHelper::PanelSpec spec;
+      NS_TEST_ASSERT_MSG_EQ (SolarEnergyHarvesterHelper::ParsePanelSpec (malformed[i], spec), false,
+                             "Malformed line accepted: " << malformed[i]);
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * Checks that the harvesters installed by BulkInstall behave as the ones
+ * installed by Install with the same attributes.
+ */
+class SolarEnergyHarvesterBulkInstallTestCase : public TestCase
+{
+public:
+  SolarEnergyHarvesterBulkInstallTestCase ();
+
+  void DoRun (void);
+
+private:
+  /**
+   * \return n energy sources, on new nodes
+   */
+  static EnergySourceContainer CreateSources (uint32_t n);
+};
+
+SolarEnergyHarvesterBulkInstallTestCase::SolarEnergyHarvesterBulkInstallTestCase ()
+  : TestCase ("Sun Energy Harvester bulk install test case")
+{
+}
+
+EnergySourceContainer
+SolarEnergyHarvesterBulkInstallTestCase::CreateSources (uint32_t n)
+{
+  NodeContainer nodes;
+  nodes.Create (n);
+  EnergySourceContainer sources;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Ptr<BasicEnergySource> source = CreateObject<BasicEnergySource> ();
+      source->SetAttribute ("BasicEnergySourceInitialEnergyJ", DoubleValue (1e6));
+      nodes.Get (i)->AggregateObject (source);
+      sources.Add (source);
+    }
+  return sources;
+}
+
+void
+SolarEnergyHarvesterBulkInstallTestCase::DoRun ()
+{
+  const uint32_t n = 4;
+
+  SolarEnergyHarvesterHelper helper;
+  helper.Set ("StartAt", StringValue ("2015-06-18 04:00:00"));
+  helper.Set ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+  helper.Set ("Latitude", DoubleValue (45.5));
+  helper.Set ("PanelTiltAngle", DoubleValue (20));
+
+  EnergySourceContainer sources = CreateSources (n);
+  EnergySourceContainer bulkSources = CreateSources (n);
+  EnergyHarvesterContainer harvesters = helper.Install (sources);
+  EnergyHarvesterContainer bulkHarvesters = helper.BulkInstall (bulkSources);
+  NS_TEST_ASSERT_MSG_EQ (bulkHarvesters.GetN (), harvesters.GetN (), "Wrong number of harvesters");
+
+  Simulator::Stop (Hours (10) + NanoSeconds (1));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Ptr<SolarEnergyHarvester> harvester = DynamicCast<SolarEnergyHarvester> (harvesters.Get (i));
+      Ptr<SolarEnergyHarvester> bulkHarvester = DynamicCast<SolarEnergyHarvester> (bulkHarvesters.Get (i));
+      NS_TEST_ASSERT_MSG_EQ (bulkHarvester->GetNode (), bulkSources.Get (i)->GetNode (), "Harvester on the wrong node");
+      Ptr<EnergyHarvesterContainer> onNode = bulkHarvester->GetNode ()->GetObject<EnergyHarvesterContainer> ();
+      NS_TEST_ASSERT_MSG_NE (onNode, 0, "No harvester container aggregated to the node");
+      NS_TEST_ASSERT_MSG_EQ (onNode->GetN (), 1, "Wrong number of harvesters on the node");
+      NS_TEST_ASSERT_MSG_EQ (onNode->Get (0), bulkHarvester, "Wrong harvester on the node");
+      NS_TEST_ASSERT_MSG_EQ (bulkHarvester->GetPanel ().latitude, 45.5, "Attribute not applied");
+      NS_TEST_ASSERT_MSG_EQ (bulkHarvester->GetPanel ().panelTiltAngle, 20, "Attribute not applied");
+      NS_TEST_ASSERT_MSG_GT (harvester->GetPower (), 0, "No power");
+      NS_TEST_ASSERT_MSG_EQ (bulkHarvester->GetPower (), harvester->GetPower (), "Different power");
+      NS_TEST_ASSERT_MSG_EQ (bulkHarvester->GetCounters ().updates, harvester->GetCounters ().updates,
+                             "Different number of updates");
+      NS_TEST_ASSERT_MSG_EQ (bulkSources.Get (i)->GetRemainingEnergy (), sources.Get (i)->GetRemainingEnergy (),
+                             "Different harvested energy");
+    }
+  Simulator::Destroy ();
+}
+
+/**
+ * Checks the power interpolated from a SolarIrradianceField against the
+ * sun model evaluated at every location, over a summer and a winter day:
+ * exact at the grid points, within 1e-4 of the peak at the cell centres.
+ */
+class SolarIrradianceFieldTestCase : public TestCase
+{
+public:
+  SolarIrradianceFieldTestCase ();
+
+  void DoRun (void);
+};
+
+SolarIrradianceFieldTestCase::SolarIrradianceFieldTestCase ()
+  : TestCase ("Sun Energy Harvester irradiance field interpolation test case")
+{
+}
+
+void
+SolarIrradianceFieldTestCase::DoRun ()
+{
+  Ptr<SolarIrradianceField> field = CreateObject<SolarIrradianceField> ();
+  field->SetAttribute ("MinLatitude", DoubleValue (38.0));
+  field->SetAttribute ("MaxLatitude", DoubleValue (38.2));
+  field->SetAttribute ("MinLongitude", DoubleValue (15.5));
+  field->SetAttribute ("MaxLongitude", DoubleValue (15.8));
+  field->SetAttribute ("LatitudePoints", UintegerValue (5));
+  field->SetAttribute ("LongitudePoints", UintegerValue (5));
+  field->SetAttribute ("Altitude", DoubleValue (31));
+
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+  panel.altitude = 31;
+  panel.panelTiltAngle = 25;
+  panel.panelAzimuthAngle = 30;
+  SolarIrradianceField::PanelWeights weights =
+    SolarIrradianceField::GetPanelWeights (panel.panelTiltAngle, panel.panelAzimuthAngle, panel.diffusePercentage);
+  double scale = (panel.solarCellEfficiency / 100) * (panel.dcdcEfficiency / 100) * panel.panelDimension;
+
+  const char *days[] = { "2015-06-18 00:00:00", "2015-12-21 00:00:00" };
+  for (int centres = 0; centres <= 1; ++centres)
+    {
+      double peak = 0;
+      double error = 0;
+      for (size_t d = 0; d < sizeof (days) / sizeof (days[0]); ++d)
+        {
+          tm date;
+          memset (&date, 0, sizeof (date));
+          strptime (days[d], "%Y-%m-%d %H:%M:%S", &date);
+          for (int minute = 0; minute < 24 * 60; minute += 5)
+            {
+              for (int i = 0; i < 5 - centres; ++i)
+                {
+                  for (int j = 0; j < 5 - centres; ++j)
+                    {
+                      panel.latitude = 38.0 + 0.05 * (i + 0.5 * centres);
+                      panel.longitude = 15.5 + 0.075 * (j + 0.5 * centres);
+                      panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+                      double exact = SolarEnergyHarvester::CalculateHarvestedPower (&date, panel);
+                      double interpolated = field->GetPanelInsolation (&date, panel.latitude, panel.longitude, weights) * scale;
+                      peak = std::max (peak, exact);
+                      error = std::max (error, fabs (interpolated - exact));
+                    }
+                }
+              Sun::AddSeconds (&date, 5 * 60);
+            }
+        }
+      NS_TEST_ASSERT_MSG_GT (peak, 0, "No power");
+      NS_TEST_ASSERT_MSG_EQ_TOL (error / peak, 0, centres ? 1e-4 : 1e-9, "Interpolation error too large");
+    }
+
+  // the look-ahead samples give the grid values without evicting the
+  // current date, and the cache keeps the least recently used date out
+  Ptr<SolarIrradianceField> cached = CreateObject<SolarIrradianceField> ();
+  cached->SetAttribute ("CachedDates", UintegerValue (2));
+  tm dates[3];
+  memset (&dates[0], 0, sizeof (dates[0]));
+  strptime ("2015-06-18 10:00:00", "%Y-%m-%d %H:%M:%S", &dates[0]);
+  mktime (&dates[0]);
+  for (int d = 1; d < 3; ++d)
+    {
+      dates[d] = dates[d - 1];
+      Sun::AddSeconds (&dates[d], 60);
+    }
+  double current = cached->GetPanelInsolation (&dates[0], 38.11, 15.66, weights);
+  for (int minute = 1; minute <= 120; ++minute)
+    {
+      tm ahead = dates[0];
+      Sun::AddSeconds (&ahead, minute * 60);
+      NS_TEST_ASSERT_MSG_EQ (cached->GetPanelInsolation (&ahead, 38.11, 15.66, weights, true),
+                             field->GetPanelInsolation (&ahead, 38.11, 15.66, weights),
+                             "A look-ahead sample differs from the grid");
+    }
+  NS_TEST_ASSERT_MSG_EQ (cached->GetEvaluations (), 1, "A look-ahead sample evaluated a grid");
+  NS_TEST_ASSERT_MSG_EQ (cached->GetPanelInsolation (&dates[0], 38.11, 15.66, weights), current, "Wrong cached date");
+  NS_TEST_ASSERT_MSG_EQ (cached->GetEvaluations (), 1, "The current date was evicted");
+  int order[] = { 1, 0, 1, 2, 1, 0 };
+  uint64_t evaluations[] = { 2, 2, 2, 3, 3, 4 };
+  for (int i = 0; i < 6; ++i)
+    {
+      cached->GetPanelInsolation (&dates[order[i]], 38.11, 15.66, weights);
+      NS_TEST_ASSERT_MSG_EQ (cached->GetEvaluations (), evaluations[i], "Wrong cache replacement");
+    }
+}
+
+/**
+ * Checks that a SolarPowerWindow provides, chunk after chunk, the power of
+ * the sun model at every update, and that a harvester reading it provides
+ * the power and the energy of a harvester computing every update.
+ */
+class SolarPowerWindowTestCase : public TestCase
+{
+public:
+  SolarPowerWindowTestCase ();
+
+  void DoRun (void);
+
+private:
+  void SamplePower (Ptr<SolarEnergyHarvester> exact, Ptr<SolarEnergyHarvester> prefetched);
+};
+
+SolarPowerWindowTestCase::SolarPowerWindowTestCase ()
+  : TestCase ("Sun Energy Harvester prefetch window test case")
+{
+}
+
+void
+SolarPowerWindowTestCase::SamplePower (Ptr<SolarEnergyHarvester> exact, Ptr<SolarEnergyHarvester> prefetched)
+{
+  NS_TEST_ASSERT_MSG_EQ_TOL (prefetched->GetPower (), exact->GetPower (), 1e-9 * exact->GetPower (),
+                             "Prefetched power differs from the exact one");
+}
+
+void
+SolarPowerWindowTestCase::DoRun ()
+{
+  // the window alone, waiting for the worker when it falls behind
+  Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+  harvester->SetAttribute ("StartAt", StringValue ("2015-06-18 00:00:00"));
+  SolarEnergyHarvester::Panel panel = harvester->GetPanel ();
+  panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+  tm date = harvester->GetDate ();
+  Ptr<SolarPowerWindow> window = SolarPowerWindow::Get (panel, date, Seconds (60), 100);
+  for (uint64_t sample = 0; sample < SECONDS_IN_DAY / 60; ++sample)
+    {
+      double power;
+      std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now () + std::chrono::seconds (10);
+      while (!window->GetPower (sample, power) && std::chrono::steady_clock::now () < timeout)
+        {
+          std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+      NS_TEST_ASSERT_MSG_EQ (window->GetPower (sample, power), true, "Sample never prefetched");
+      NS_TEST_ASSERT_MSG_EQ (power, SolarEnergyHarvester::CalculateHarvestedPower (&date, panel), "Wrong prefetched power");
+      Sun::AddSeconds (&date, 60);
+    }
+  window = 0;
+  SolarPowerWindow::ClearCache ();
+
+  // a harvester reading the window, against one computing every update
+  Ptr<SolarEnergyHarvester> harvesters[2];
+  Ptr<BasicEnergySource> sources[2];
+  for (int i = 0; i < 2; ++i)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      sources[i] = CreateObject<BasicEnergySource> ();
+      sources[i]->SetAttribute ("BasicEnergySourceInitialEnergyJ", DoubleValue (1e6));
+      node->AggregateObject (sources[i]);
+      harvesters[i] = CreateObject<SolarEnergyHarvester> ();
+      harvesters[i]->SetAttribute ("StartAt", StringValue ("2015-06-18 00:00:00"));
+      harvesters[i]->SetAttribute ("PeriodicHarvestedPowerUpdateInterval", TimeValue (Seconds (60)));
+      sources[i]->ConnectEnergyHarvester (harvesters[i]);
+      harvesters[i]->SetNode (node);
+      harvesters[i]->SetEnergySource (sources[i]);
+    }
+  harvesters[1]->SetAttribute ("PrefetchChunk", TimeValue (Hours (2)));
+  for (uint32_t minutes = 5; minutes < 24 * 60; minutes += 10)
+    {
+      Simulator::Schedule (Minutes (minutes), &SolarPowerWindowTestCase::SamplePower, this, harvesters[0], harvesters[1]);
+    }
+  Simulator::Stop (Days (1));
+  Simulator::Run ();
+
+  double harvested = sources[0]->GetRemainingEnergy () - 1e6;
+  NS_TEST_ASSERT_MSG_GT (harvested, 0, "No energy harvested");
+  NS_TEST_ASSERT_MSG_EQ_TOL (sources[1]->GetRemainingEnergy () - 1e6, harvested, 1e-9 * harvested,
+                             "Prefetched energy differs from the exact one");
+  NS_TEST_ASSERT_MSG_EQ (harvesters[1]->GetCounters ().updates, harvesters[0]->GetCounters ().updates,
+                         "Different number of updates");
+  Simulator::Destroy ();
+  SolarPowerWindow::ClearCache ();
+}
+
 class SolarEnergyHarvesterTestSuite : public TestSuite
 {
 public:
@@ -135,6 +1735,20 @@ SolarEnergyHarvesterTestSuite::SolarEnergyHarvesterTestSuite ()
   : TestSuite ("solar-energy-harvester-test", UNIT)
 {
   AddTestCase (new SolarEnergyHarvesterTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterThresholdTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterReplicationsTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterQuantizedProfileTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterMeasuredIrradianceTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterSharedProfileTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterPowerSegmentTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterMobilityTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterForecastTestCase, TestCase::QUICK);
+  AddTestCase (new SolarCloudModelTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyPredictorTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterSpecFileTestCase, TestCase::QUICK);
+  AddTestCase (new SolarEnergyHarvesterBulkInstallTestCase, TestCase::QUICK);
+  AddTestCase (new SolarIrradianceFieldTestCase, TestCase::QUICK);
+  AddTestCase (new SolarPowerWindowTestCase, TestCase::QUICK);
 }
 
 // create an instance of the test suite
@@ -27,6 +27,12 @@
 #include <ns3/config.h>
 #include <ns3/string.h>
 #include <ns3/sun.h>
+#include <ns3/solar-energy-harvester.h>
+#include <ns3/solar-sun-track.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
 
 using namespace ns3;
 
@@ -78,6 +84,229 @@ SunTestCase::DoRun ()
 
 }
 
+/**
+ * Checks the sun position algorithms against SPA, every 5 hours over 2015,
+ * with the sun above the horizon, within the errors of their tier.
+ */
+class SunPositionAlgorithmsTestCase : public TestCase
+{
+public:
+  SunPositionAlgorithmsTestCase ();
+
+  void DoRun (void);
+};
+
+SunPositionAlgorithmsTestCase::SunPositionAlgorithmsTestCase ()
+  : TestCase ("Sun position algorithms against SPA")
+{
+}
+
+void
+SunPositionAlgorithmsTestCase::DoRun ()
+{
+  double latitude = 38.11;
+  double longitude = 15.661;
+
+  time_t start = 1420070400; // 2015-01-01 00:00:00 UTC
+  for (time_t when = start; when < start + 365 * SECONDS_IN_DAY; when += 5 * SECONDS_IN_HOUR)
+    {
+      struct tm date;
+      gmtime_r (&when, &date);
+
+      Sun::Coordinates spa;
+      Sun::GetPosition (Sun::SPA_ALGORITHM, &date, latitude, longitude, &spa);
+      if (spa.dElevationAngle <= 5)
+        {
+          continue;
+        }
+
+      Sun::Coordinates psa;
+      Sun::GetPosition (Sun::PSA_ALGORITHM, &date, latitude, longitude, &psa);
+      NS_TEST_ASSERT_MSG_EQ_TOL (psa.dZenithAngle, spa.dZenithAngle, 0.01, "PSA zenith angle far from SPA");
+      NS_TEST_ASSERT_MSG_EQ_TOL (psa.dAzimuth, spa.dAzimuth, 0.1, "PSA azimuth far from SPA");
+
+      Sun::Coordinates fast;
+      Sun::GetPosition (Sun::FAST_ALGORITHM, &date, latitude, longitude, &fast);
+      NS_TEST_ASSERT_MSG_EQ_TOL (fast.dZenithAngle, spa.dZenithAngle, 0.2, "Fast zenith angle far from SPA");
+      NS_TEST_ASSERT_MSG_EQ_TOL (fast.dAzimuth, spa.dAzimuth, 1, "Fast azimuth far from SPA");
+    }
+}
+
+/**
+ * Checks that the two stages of PSA, with the time-only stage shared by
+ * several locations, return the same coordinates of PSA, bit for bit.
+ */
+class SunTwoStagePsaTestCase : public TestCase
+{
+public:
+  SunTwoStagePsaTestCase ();
+
+  void DoRun (void);
+};
+
+SunTwoStagePsaTestCase::SunTwoStagePsaTestCase ()
+  : TestCase ("Two-stage PSA against PSA")
+{
+}
+
+void
+SunTwoStagePsaTestCase::DoRun ()
+{
+  const double latitudes[] = { -60, -33.87, 0, 38.11, 64.15 };
+  const double longitudes[] = { -122.42, 0, 15.661, 151.21, 179.5 };
+
+  Sun::EnableCounters (true);
+  time_t start = 1420070400; // 2015-01-01 00:00:00 UTC
+  for (time_t when = start; when < start + 365 * SECONDS_IN_DAY; when += 7 * SECONDS_IN_HOUR)
+    {
+      struct tm date;
+      gmtime_r (&when, &date);
+
+      uint64_t evaluations = Sun::GetCelestialEvaluations ();
+      for (uint32_t i = 0; i < sizeof (latitudes) / sizeof (latitudes[0]); ++i)
+        {
+          Sun::Coordinates psa;
+          Sun::PSA (&date, latitudes[i], longitudes[i], &psa);
+
+          Sun::Coordinates twoStage;
+          Sun::PSA (Sun::GetSharedCelestialState (&date), Sun::GetLocation (latitudes[i], longitudes[i]), &twoStage);
+          NS_TEST_ASSERT_MSG_EQ (twoStage.dZenithAngle, psa.dZenithAngle, "Different zenith angle");
+          NS_TEST_ASSERT_MSG_EQ (twoStage.dAzimuth, psa.dAzimuth, "Different azimuth");
+          NS_TEST_ASSERT_MSG_EQ (twoStage.dElevationAngle, psa.dElevationAngle, "Different elevation angle");
+        }
+      // one shared state for all the locations, plus one per PSA call
+      NS_TEST_ASSERT_MSG_EQ (Sun::GetCelestialEvaluations () - evaluations, 1 + sizeof (latitudes) / sizeof (latitudes[0]),
+                             "The celestial state was not shared");
+    }
+  Sun::EnableCounters (false);
+}
+
+/**
+ * Checks the interpolated sun track against the exact model over 2015, at
+ * two sites out of the tropics, for knot spacings of 5, 10 and 15 minutes:
+ * the error has to stay below 0.1% of the peak power of a flat panel.
+ * In the tropics, the error grows when the sun passes close to the zenith.
+ */
+class SunTrackTestCase : public TestCase
+{
+public:
+  SunTrackTestCase ();
+
+  void DoRun (void);
+};
+
+SunTrackTestCase::SunTrackTestCase ()
+  : TestCase ("Spline sun track against the exact model")
+{
+}
+
+void
+SunTrackTestCase::DoRun ()
+{
+  const double latitudes[] = { 38.11, -33 };
+  const double tilts[] = { 0, 30, 90 };
+  const int64_t knotSpacings[] = { 300, 600, 900 };
+
+  struct tm startDate;
+  memset (&startDate, 0, sizeof (startDate));
+  startDate.tm_year = 115;
+  startDate.tm_mday = 1;
+  startDate.tm_gmtoff = SECONDS_IN_HOUR;
+
+  for (uint32_t l = 0; l < 2; ++l)
+    {
+      SolarEnergyHarvester::Panel panel;
+      memset (&panel, 0, sizeof (panel));
+      panel.latitude = latitudes[l];
+      panel.longitude = 15.661;
+      panel.altitude = 31;
+      panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+      panel.solarCellEfficiency = 8;
+      panel.dcdcEfficiency = 90;
+      panel.panelAzimuthAngle = 180;
+      panel.panelDimension = 1;
+      panel.diffusePercentage = 10;
+      panel.sunPositionAlgorithm = Sun::PSA_ALGORITHM;
+
+      // the peak power of a flat panel, on the summer solstice
+      double peak = 0;
+      for (int64_t seconds = 0; seconds < SECONDS_IN_DAY; seconds += 60)
+        {
+          struct tm date = startDate;
+          Sun::AddSeconds (&date, (panel.latitude > 0 ? 171 : 355) * SECONDS_IN_DAY + seconds);
+          peak = std::max (peak, SolarEnergyHarvester::CalculateHarvestedPower (&date, panel));
+        }
+
+      for (uint32_t t = 0; t < 3; ++t)
+        {
+          panel.panelTiltAngle = tilts[t];
+          for (uint32_t k = 0; k < 3; ++k)
+            {
+              SolarSunTrack track (panel, startDate, knotSpacings[k]);
+              double maxError = 0;
+              for (int64_t seconds = 0; seconds < 365 * SECONDS_IN_DAY; seconds += 7 * 60 + 13)
+                {
+                  struct tm date = startDate;
+                  Sun::AddSeconds (&date, seconds);
+                  double exact = SolarEnergyHarvester::CalculateHarvestedPower (&date, panel);
+                  maxError = std::max (maxError, std::fabs (track.GetPower (seconds) - exact));
+                }
+              NS_LOG_DEBUG ("Latitude " << panel.latitude << ", tilt " << panel.panelTiltAngle << ", knots every "
+                                        << knotSpacings[k] << " s: max error " << maxError / peak * 100 << "%");
+              NS_TEST_ASSERT_MSG_LT (maxError, 1e-3 * peak, "Sun track too far from the exact model");
+            }
+        }
+    }
+}
+
+/**
+ * Checks that the sun position counts the seconds, and the UTC offsets
+ * that are not whole hours (Sun::DecimalHours).
+ */
+class SunDecimalHoursTestCase : public TestCase
+{
+public:
+  SunDecimalHoursTestCase ();
+
+  void DoRun (void);
+};
+
+SunDecimalHoursTestCase::SunDecimalHoursTestCase ()
+  : TestCase ("Decimal hours to the second")
+{
+}
+
+void
+SunDecimalHoursTestCase::DoRun ()
+{
+  struct tm date;
+  memset (&date, 0, sizeof (date));
+  date.tm_year = 115;
+  date.tm_mday = 1;
+  date.tm_hour = 12;
+  date.tm_min = 30;
+
+  // the sun moves within the minute
+  Sun::Coordinates before;
+  Sun::Coordinates after;
+  Sun::PSA (&date, 38.11, 15.661, &before);
+  date.tm_sec = 36;
+  Sun::PSA (&date, 38.11, 15.661, &after);
+  NS_TEST_ASSERT_MSG_GT (std::fabs (after.dAzimuth - before.dAzimuth), 1e-3, "The sun did not move in 36 s");
+
+  // 12:00 at UTC+05:30 is 06:30 UTC
+  date.tm_min = 0;
+  date.tm_sec = 0;
+  date.tm_gmtoff = 5 * SECONDS_IN_HOUR + 30 * SECONDS_IN_MINUTE;
+  Sun::PSA (&date, 38.11, 15.661, &before);
+  date.tm_hour = 6;
+  date.tm_min = 30;
+  date.tm_gmtoff = 0;
+  Sun::PSA (&date, 38.11, 15.661, &after);
+  NS_TEST_ASSERT_MSG_EQ_TOL (after.dAzimuth, before.dAzimuth, 1e-9, "UTC offset not applied to the minute");
+  NS_TEST_ASSERT_MSG_EQ_TOL (after.dZenithAngle, before.dZenithAngle, 1e-9, "UTC offset not applied to the minute");
+}
+
 class SunTestSuite : public TestSuite
 {
 public:
@@ -88,6 +317,10 @@ SunTestSuite::SunTestSuite ()
   : TestSuite ("sun-test", UNIT)
 {
   AddTestCase (new SunTestCase, TestCase::QUICK);
+  AddTestCase (new SunPositionAlgorithmsTestCase, TestCase::QUICK);
+  AddTestCase (new SunTwoStagePsaTestCase, TestCase::QUICK);
+  AddTestCase (new SunTrackTestCase, TestCase::QUICK);
+  AddTestCase (new SunDecimalHoursTestCase, TestCase::QUICK);
 }
 
 // create an instance of the test suite
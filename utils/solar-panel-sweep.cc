@@ -0,0 +1,548 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Panel sizing sweep.
+ *
+ * Evaluates the energy harvested over a period (one year by default) by every
+ * combination of location, panel tilt, panel azimuth, panel dimension, solar
+ * cell efficiency and DC-DC efficiency, using the SolarEnergyHarvester power
+ * model without the ns-3 event scheduler.
+ *
+ * The harvested power is linear in dimension and efficiencies, so only the
+ * (location, tilt, azimuth) insolation integrals are computed; the sun
+ * position is computed once per location and time step and shared by all
+ * the orientations. The orientations are spread over all the cores through a
+ * work-stealing pool.
+ *
+ * Usage example:
+ *
+ *   ./waf --run "solar-panel-sweep --locations=38.11,15.661,31;45.46,9.19,120
+ *                --tilt=0:90:5 --azimuth=0:355:5 --dimension=0.01,0.02,0.05
+ *                --cellEfficiency=8:20:2 --minEnergy=1e5 --optimize=1"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SolarPanelSweep");
+
+/**
+ * A fixed set of workers, each one owning a task deque. Workers pop their
+ * own tasks from the back and steal from the front of the other deques when
+ * they run out of work.
+ */
+class WorkStealingPool
+{
+public:
+  WorkStealingPool (uint32_t nThreads);
+  ~WorkStealingPool ();
+
+  void Submit (const std::function<void ()> &task);
+
+  /**
+   * Block until every submitted task has been executed.
+   */
+  void Wait (void);
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void ()> > tasks;
+  };
+
+  bool Pop (uint32_t id, std::function<void ()> &task);
+  void Worker (uint32_t id);
+
+  std::vector<Queue *> m_queues;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_done;
+  uint64_t m_queued;  // tasks submitted and not yet popped
+  uint64_t m_pending; // tasks submitted and not yet completed
+  uint32_t m_next;    // round-robin submission queue
+  bool m_stop;
+};
+
+WorkStealingPool::WorkStealingPool (uint32_t nThreads)
+  : m_queued (0),
+    m_pending (0),
+    m_next (0),
+    m_stop (false)
+{
+  for (uint32_t i = 0; i < nThreads; ++i)
+    {
+      m_queues.push_back (new Queue);
+    }
+  for (uint32_t i = 0; i < nThreads; ++i)
+    {
+      m_threads.push_back (std::thread (&WorkStealingPool::Worker, this, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool ()
+{
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_stop = true;
+  }
+  m_wakeup.notify_all ();
+  for (size_t i = 0; i < m_threads.size (); ++i)
+    {
+      m_threads[i].join ();
+    }
+  for (size_t i = 0; i < m_queues.size (); ++i)
+    {
+      delete m_queues[i];
+    }
+}
+
+void
+WorkStealingPool::Submit (const std::function<void ()> &task)
+{
+  Queue *queue = m_queues[m_next++ % m_queues.size ()];
+  {
+    std::lock_guard<std::mutex> lock (queue->mutex);
+    queue->tasks.push_back (task);
+  }
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    ++m_queued;
+    ++m_pending;
+  }
+  m_wakeup.notify_one ();
+}
+
+void
+WorkStealingPool::Wait (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_done.wait (lock, [this] { return m_pending == 0; });
+}
+
+bool
+WorkStealingPool::Pop (uint32_t id, std::function<void ()> &task)
+{
+  for (size_t i = 0; i < m_queues.size (); ++i)
+    {
+      Queue *queue = m_queues[(id + i) % m_queues.size ()];
+      std::lock_guard<std::mutex> lock (queue->mutex);
+      if (queue->tasks.empty ())
+        {
+          continue;
+        }
+      if (i == 0)
+        {
+          task = queue->tasks.back ();
+          queue->tasks.pop_back ();
+        }
+      else
+        {
+          task = queue->tasks.front ();
+          queue->tasks.pop_front ();
+        }
+      return true;
+    }
+  return false;
+}
+
+void
+WorkStealingPool::Worker (uint32_t id)
+{
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_wakeup.wait (lock, [this] { return m_stop || m_queued > 0; });
+        if (m_queued == 0)
+          {
+            return;
+          }
+        --m_queued;
+      }
+
+      // a task is reserved for this worker: it is in some deque
+      std::function<void ()> task;
+      while (!Pop (id, task))
+        {
+          std::this_thread::yield ();
+        }
+      task ();
+
+      std::lock_guard<std::mutex> lock (m_mutex);
+      if (--m_pending == 0)
+        {
+          m_done.notify_all ();
+        }
+    }
+}
+
+/**
+ * The sun positions over the simulated period for a single location, shared
+ * by all the orientations evaluated at that location.
+ */
+struct SunTable
+{
+  double latitude;
+  double longitude;
+  double altitude;
+  double airMass;
+  std::vector<Sun::Coordinates> coordinates;
+  std::vector<double> boundSuffix; // upper bound of the insolation integral from step i to the end [J/m^2]
+};
+
+struct SweepParameters
+{
+  time_t start;
+  uint32_t steps;
+  uint32_t stepS;
+  double diffusePercentage;
+};
+
+static double
+GetWallSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * Parse either a "first:last:step" range or a comma separated list.
+ */
+static std::vector<double>
+ParseValues (const std::string &s)
+{
+  std::vector<double> values;
+  double first, last, step;
+  if (sscanf (s.c_str (), "%lf:%lf:%lf", &first, &last, &step) == 3)
+    {
+      NS_ABORT_MSG_UNLESS (step > 0, "Invalid range step: " << s);
+      for (uint32_t i = 0; first + i * step <= last + step * 1e-9; ++i)
+        {
+          values.push_back (first + i * step);
+        }
+      return values;
+    }
+
+  std::istringstream iss (s);
+  std::string item;
+  while (std::getline (iss, item, ','))
+    {
+      values.push_back (atof (item.c_str ()));
+    }
+  NS_ABORT_MSG_IF (values.empty (), "Invalid value list: " << s);
+  return values;
+}
+
+static void
+FillSunTable (SunTable &table, const SweepParameters &parameters, uint32_t first, uint32_t last)
+{
+  for (uint32_t i = first; i < last; ++i)
+    {
+      time_t when = parameters.start + (time_t) i * parameters.stepS;
+      tm date;
+      gmtime_r (&when, &date);
+      Sun::PSA (&date, table.latitude, table.longitude, &table.coordinates[i]);
+    }
+}
+
+/**
+ * Insolation integral over the period for one orientation [J/m^2].
+ *
+ * \param pruneBelow give up, returning a negative value, as soon as the
+ *        integral can no longer reach this value; 0 disables pruning
+ */
+static double
+Integrate (const SunTable &table, const SweepParameters &parameters, double tilt, double azimuth, double pruneBelow)
+{
+  static const uint32_t checkInterval = 1024;
+
+  double energy = 0;
+  for (uint32_t i = 0; i < parameters.steps; ++i)
+    {
+      energy += SolarEnergyHarvester::GetPanelInsolation (table.coordinates[i], table.airMass,
+                                                          tilt, azimuth, parameters.diffusePercentage) * parameters.stepS;
+      if (pruneBelow > 0 && i % checkInterval == 0 && energy + table.boundSuffix[i + 1] < pruneBelow)
+        {
+          return -1;
+        }
+    }
+  return energy;
+}
+
+/**
+ * Pattern search of the orientation maximizing the insolation integral,
+ * starting from the best point of the grid.
+ */
+static void
+OptimizeOrientation (const SunTable &table, const SweepParameters &parameters,
+                     double &tilt, double &azimuth, double &energy, double step)
+{
+  static const double minStep = 0.1;
+
+  while (step >= minStep)
+    {
+      bool moved = false;
+      const double candidates[4][2] = { { step, 0 }, { -step, 0 }, { 0, step }, { 0, -step } };
+      for (uint32_t c = 0; c < 4; ++c)
+        {
+          double t = tilt + candidates[c][0];
+          double a = fmod (azimuth + candidates[c][1] + 360, 360);
+          if (t < 0 || t > 90)
+            {
+              continue;
+            }
+          double e = Integrate (table, parameters, t, a, 0);
+          if (e > energy)
+            {
+              tilt = t;
+              azimuth = a;
+              energy = e;
+              moved = true;
+            }
+        }
+      if (!moved)
+        {
+          step /= 2;
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string locations = "38.11,15.661,31";
+  std::string tilts = "0:90:5";
+  std::string azimuths = "0:355:5";
+  std::string dimensions = "1";
+  std::string cellEfficiencies = "8";
+  std::string dcdcEfficiencies = "90";
+  std::string startDate = "2015-01-01 00:00:00";
+  double days = 365;
+  uint32_t stepS = 600;
+  double diffusePercentage = 10;
+  double minEnergy = 0;
+  bool optimize = false;
+  uint32_t threads = std::thread::hardware_concurrency ();
+  std::string output = "solar-panel-sweep.txt";
+
+  CommandLine cmd;
+  cmd.AddValue ("locations", "Semicolon separated latitude,longitude,altitude triplets", locations);
+  cmd.AddValue ("tilt", "Panel tilt angles: first:last:step or comma separated list", tilts);
+  cmd.AddValue ("azimuth", "Panel azimuth angles: first:last:step or comma separated list", azimuths);
+  cmd.AddValue ("dimension", "Panel dimensions: first:last:step or comma separated list", dimensions);
+  cmd.AddValue ("cellEfficiency", "Solar cell efficiencies [%]: first:last:step or comma separated list", cellEfficiencies);
+  cmd.AddValue ("dcdcEfficiency", "DC-DC efficiencies [%]: first:last:step or comma separated list", dcdcEfficiencies);
+  cmd.AddValue ("start", "The starting date (UTC) in format YYYY-MM-DD hh:mm:ss", startDate);
+  cmd.AddValue ("days", "The evaluated period in days", days);
+  cmd.AddValue ("step", "The time step in seconds", stepS);
+  cmd.AddValue ("diffusePercentage", "The diffuse energy percentage", diffusePercentage);
+  cmd.AddValue ("minEnergy", "Prune configurations harvesting less than this energy [J] over the period", minEnergy);
+  cmd.AddValue ("optimize", "Search the best tilt and azimuth of every location", optimize);
+  cmd.AddValue ("threads", "Number of worker threads", threads);
+  cmd.AddValue ("output", "The results table file name", output);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (threads > 0, "At least one thread is needed");
+  NS_ABORT_MSG_UNLESS (stepS > 0, "The time step must be positive");
+
+  std::vector<double> tiltValues = ParseValues (tilts);
+  std::vector<double> azimuthValues = ParseValues (azimuths);
+  std::vector<double> dimensionValues = ParseValues (dimensions);
+  std::vector<double> cellValues = ParseValues (cellEfficiencies);
+  std::vector<double> dcdcValues = ParseValues (dcdcEfficiencies);
+
+  std::vector<SunTable> tables;
+  std::istringstream iss (locations);
+  std::string item;
+  while (std::getline (iss, item, ';'))
+    {
+      SunTable table;
+      NS_ABORT_MSG_UNLESS (sscanf (item.c_str (), "%lf,%lf,%lf", &table.latitude, &table.longitude, &table.altitude) == 3,
+                           "Location format: latitude,longitude,altitude");
+      table.airMass = Sun::GetAirMass (table.latitude, table.altitude);
+      tables.push_back (table);
+    }
+
+  SweepParameters parameters;
+  tm start;
+  memset (&start, 0, sizeof (start));
+  NS_ABORT_MSG_UNLESS (strptime (startDate.c_str (), "%Y-%m-%d %H:%M:%S", &start), "Date Format (24 hours): YYYY-MM-DD hh:mm:ss");
+  parameters.start = timegm (&start);
+  parameters.stepS = stepS;
+  parameters.steps = (uint32_t)(days * SECONDS_IN_DAY / stepS);
+  parameters.diffusePercentage = diffusePercentage;
+
+  // the harvested energy is insolation * dimension * efficiencies: an
+  // orientation is pruned when even the largest panel cannot reach minEnergy
+  double maxFactor = 0;
+  for (size_t d = 0; d < dimensionValues.size (); ++d)
+    {
+      for (size_t c = 0; c < cellValues.size (); ++c)
+        {
+          for (size_t e = 0; e < dcdcValues.size (); ++e)
+            {
+              maxFactor = std::max (maxFactor, dimensionValues[d] * (cellValues[c] / 100) * (dcdcValues[e] / 100));
+            }
+        }
+    }
+  double pruneBelow = (minEnergy > 0 && maxFactor > 0) ? minEnergy / maxFactor : 0;
+
+  std::ofstream os (output.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "Cannot open " << output);
+  os << "#latitude longitude altitude tilt azimuth dimension cellEfficiency dcdcEfficiency energy[J]" << std::endl;
+  os << std::setprecision (8);
+
+  WorkStealingPool pool (threads);
+  uint64_t evaluated = 0;
+  uint64_t pruned = 0;
+  uint64_t written = 0;
+  double begin = GetWallSeconds ();
+
+  for (size_t l = 0; l < tables.size (); ++l)
+    {
+      SunTable &table = tables[l];
+
+      // sun positions, split in chunks among the workers
+      table.coordinates.resize (parameters.steps);
+      const uint32_t chunk = 4096;
+      for (uint32_t first = 0; first < parameters.steps; first += chunk)
+        {
+          uint32_t last = std::min (first + chunk, parameters.steps);
+          pool.Submit ([&table, &parameters, first, last] { FillSunTable (table, parameters, first, last); });
+        }
+      pool.Wait ();
+
+      // a panel never gets more than the incident insolation plus the diffuse
+      // part; for a horizontal panel without diffuse part the model reduces
+      // to the incident insolation times sin (elevation)
+      table.boundSuffix.assign (parameters.steps + 1, 0);
+      for (uint32_t i = parameters.steps; i-- > 0; )
+        {
+          double bound = 0;
+          if (table.coordinates[i].dElevationAngle > 0)
+            {
+              bound = SolarEnergyHarvester::GetPanelInsolation (table.coordinates[i], table.airMass, 0, 0, 0);
+              bound = bound / sin (table.coordinates[i].dElevationAngle * rad) * (1 + diffusePercentage / 100);
+            }
+          table.boundSuffix[i] = table.boundSuffix[i + 1] + bound * stepS;
+        }
+
+      // one task per orientation; results are stored by index, without locks
+      std::vector<double> energies (tiltValues.size () * azimuthValues.size ());
+      for (size_t t = 0; t < tiltValues.size (); ++t)
+        {
+          for (size_t a = 0; a < azimuthValues.size (); ++a)
+            {
+              double *energy = &energies[t * azimuthValues.size () + a];
+              double tilt = tiltValues[t];
+              double azimuth = azimuthValues[a];
+              pool.Submit ([&table, &parameters, tilt, azimuth, pruneBelow, energy]
+                           { *energy = Integrate (table, parameters, tilt, azimuth, pruneBelow); });
+            }
+        }
+      pool.Wait ();
+
+      size_t best = 0;
+      for (size_t o = 0; o < energies.size (); ++o)
+        {
+          if (energies[o] > energies[best])
+            {
+              best = o;
+            }
+          uint64_t combinations = dimensionValues.size () * cellValues.size () * dcdcValues.size ();
+          evaluated += combinations;
+          if (energies[o] < 0)
+            {
+              pruned += combinations;
+              continue;
+            }
+          for (size_t d = 0; d < dimensionValues.size (); ++d)
+            {
+              for (size_t c = 0; c < cellValues.size (); ++c)
+                {
+                  for (size_t e = 0; e < dcdcValues.size (); ++e)
+                    {
+                      double energy = energies[o] * dimensionValues[d] * (cellValues[c] / 100) * (dcdcValues[e] / 100);
+                      if (energy < minEnergy)
+                        {
+                          ++pruned;
+                          continue;
+                        }
+                      os << table.latitude << " " << table.longitude << " " << table.altitude << " "
+                         << tiltValues[o / azimuthValues.size ()] << " " << azimuthValues[o % azimuthValues.size ()] << " "
+                         << dimensionValues[d] << " " << cellValues[c] << " " << dcdcValues[e] << " " << energy << "\n";
+                      ++written;
+                    }
+                }
+            }
+        }
+
+      if (optimize && energies[best] > 0)
+        {
+          double tilt = tiltValues[best / azimuthValues.size ()];
+          double azimuth = azimuthValues[best % azimuthValues.size ()];
+          double energy = energies[best];
+          double step = 5;
+          if (tiltValues.size () > 1)
+            {
+              step = tiltValues[1] - tiltValues[0];
+            }
+          OptimizeOrientation (table, parameters, tilt, azimuth, energy, step);
+          os << "#optimum " << table.latitude << " " << table.longitude << " " << table.altitude << " "
+             << tilt << " " << azimuth << " insolation[J/m^2]=" << energy << std::endl;
+        }
+
+      // release the sun table before moving to the next location
+      std::vector<Sun::Coordinates> ().swap (table.coordinates);
+      std::vector<double> ().swap (table.boundSuffix);
+    }
+
+  double elapsed = GetWallSeconds () - begin;
+  os.close ();
+
+  std::cout << "Configurations: " << evaluated << ", pruned: " << pruned << ", written: " << written << std::endl;
+  std::cout << "Wall time: " << elapsed << " s, "
+            << (elapsed > 0 ? evaluated / elapsed * SECONDS_IN_HOUR : 0) << " configurations/hour" << std::endl;
+
+  return 0;
+}
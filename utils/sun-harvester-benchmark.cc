@@ -0,0 +1,470 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Micro-benchmarks of the sun model and of the harvester hot paths.
+ *
+ * Every benchmark runs on fixed inputs (a set of dates spread over 2015 at a
+ * fixed location), is warmed up once and then repeated; one CSV line is
+ * printed per benchmark:
+ *
+ *   benchmark,ops,repetitions,min_ns_per_op,median_ns_per_op,mean_ns_per_op
+ *
+ * UpdateHarvestedPower is measured through the simulator, so its figure
+ * includes the event scheduling and the BasicEnergySource update triggered
+ * by every harvester update. The SolarEnergyHarvester::Day benchmark reports
+ * the wall time of a full simulated day at 1 s resolution per harvester.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/energy-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SunHarvesterBenchmark");
+
+static const double g_latitude = 38.11;
+static const double g_longitude = 15.661;
+static const double g_altitude = 31;
+
+// prevents the compiler from optimizing away the benchmarked calls
+static volatile double g_sink;
+
+static double
+GetWallSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * Dates spread every 37 minutes over 2015, so that both day and night
+ * samples are measured.
+ */
+static std::vector<tm>
+MakeDates (uint32_t n)
+{
+  std::vector<tm> dates (n);
+  time_t start = 1420070400; // 2015-01-01 00:00:00 UTC
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      time_t when = start + (time_t) i * 37 * SECONDS_IN_MINUTE;
+      gmtime_r (&when, &dates[i]);
+    }
+  return dates;
+}
+
+class Benchmark
+{
+public:
+  virtual ~Benchmark ()
+  {
+  }
+  virtual std::string GetName (void) const = 0;
+
+  /**
+   * Run ops operations.
+   * \return the elapsed wall time in seconds
+   */
+  virtual double Run (uint64_t ops) = 0;
+};
+
+class SunPositionBenchmark : public Benchmark
+{
+public:
+  SunPositionBenchmark (const std::vector<tm> &dates, Sun::PositionFunction position, std::string name)
+    : m_dates (dates),
+      m_position (position),
+      m_name (name)
+  {
+  }
+  std::string GetName (void) const
+  {
+    return m_name;
+  }
+  double Run (uint64_t ops)
+  {
+    Sun::Coordinates coordinates;
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        m_position (&m_dates[i % m_dates.size ()], g_latitude, g_longitude, &coordinates);
+        g_sink = coordinates.dElevationAngle;
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  const std::vector<tm> &m_dates;
+  Sun::PositionFunction m_position;
+  std::string m_name;
+};
+
+/* The two stages of PSA, timed separately: the time-only stage once per
+ * date, the per-location stage for a state shared by all the locations. */
+class CelestialStateBenchmark : public Benchmark
+{
+public:
+  CelestialStateBenchmark (const std::vector<tm> &dates) : m_dates (dates)
+  {
+  }
+  std::string GetName (void) const
+  {
+    return "Sun::GetCelestialState";
+  }
+  double Run (uint64_t ops)
+  {
+    Sun::CelestialState state;
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        Sun::GetCelestialState (&m_dates[i % m_dates.size ()], &state);
+        g_sink = state.dRightAscension;
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  const std::vector<tm> &m_dates;
+};
+
+class LocalStageBenchmark : public Benchmark
+{
+public:
+  LocalStageBenchmark (const std::vector<tm> &dates)
+  {
+    Sun::GetCelestialState (&dates[dates.size () / 2], &m_state);
+    for (uint32_t i = 0; i < 1024; ++i)
+      {
+        m_locations.push_back (Sun::GetLocation (g_latitude + (i % 32) * 0.1, g_longitude + (i / 32) * 0.1));
+      }
+  }
+  std::string GetName (void) const
+  {
+    return "Sun::PSA (state, location)";
+  }
+  double Run (uint64_t ops)
+  {
+    Sun::Coordinates coordinates;
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        Sun::PSA (m_state, m_locations[i % m_locations.size ()], &coordinates);
+        g_sink = coordinates.dElevationAngle;
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  Sun::CelestialState m_state;
+  std::vector<Sun::Location> m_locations;
+};
+
+class IncidentInsolationBenchmark : public Benchmark
+{
+public:
+  IncidentInsolationBenchmark (const std::vector<tm> &dates) : m_dates (dates)
+  {
+  }
+  std::string GetName (void) const
+  {
+    return "Sun::GetIncidentInsolation";
+  }
+  double Run (uint64_t ops)
+  {
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        g_sink = Sun::GetIncidentInsolation (&m_dates[i % m_dates.size ()], g_latitude, g_longitude, g_altitude);
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  const std::vector<tm> &m_dates;
+};
+
+class AirMassBenchmark : public Benchmark
+{
+public:
+  std::string GetName (void) const
+  {
+    return "Sun::GetAirMass";
+  }
+  double Run (uint64_t ops)
+  {
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        g_sink = Sun::GetAirMass (g_latitude + (i % 64) * 0.01, g_altitude);
+      }
+    return GetWallSeconds () - begin;
+  }
+};
+
+class CalculateHarvestedPowerBenchmark : public Benchmark
+{
+public:
+  CalculateHarvestedPowerBenchmark (const std::vector<tm> &dates) : m_dates (dates)
+  {
+    m_harvester = CreateObject<SolarEnergyHarvester> ();
+    m_harvester->SetAttribute ("PanelTiltAngle", DoubleValue (30));
+    m_harvester->SetAttribute ("PanelAzimuthAngle", DoubleValue (180));
+  }
+  std::string GetName (void) const
+  {
+    return "SolarEnergyHarvester::CalculateHarvestedPower";
+  }
+  double Run (uint64_t ops)
+  {
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        g_sink = m_harvester->CalculateHarvestedPower (&m_dates[i % m_dates.size ()]);
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  const std::vector<tm> &m_dates;
+  Ptr<SolarEnergyHarvester> m_harvester;
+};
+
+/**
+ * The interpolated sun track of the same panel, sampled every second as a
+ * harvester with a 1 s update interval; the knots are every 10 minutes.
+ */
+class SunTrackBenchmark : public Benchmark
+{
+public:
+  SunTrackBenchmark (const std::vector<tm> &dates)
+  {
+    Ptr<SolarEnergyHarvester> harvester = CreateObject<SolarEnergyHarvester> ();
+    harvester->SetAttribute ("PanelTiltAngle", DoubleValue (30));
+    harvester->SetAttribute ("PanelAzimuthAngle", DoubleValue (180));
+    m_track = Create<SolarSunTrack> (harvester->GetPanel (), dates[0], 600);
+  }
+  std::string GetName (void) const
+  {
+    return "SolarSunTrack::GetPower";
+  }
+  double Run (uint64_t ops)
+  {
+    double begin = GetWallSeconds ();
+    for (uint64_t i = 0; i < ops; ++i)
+      {
+        g_sink = m_track->GetPower (i % (365 * SECONDS_IN_DAY));
+      }
+    return GetWallSeconds () - begin;
+  }
+private:
+  Ptr<SolarSunTrack> m_track;
+};
+
+/**
+ * Simulates nHarvesters nodes, each one with a BasicEnergySource and a
+ * SolarEnergyHarvester updated every second; one operation lasts
+ * secondsPerOp simulated seconds of a single harvester.
+ */
+class SimulationBenchmark : public Benchmark
+{
+public:
+  SimulationBenchmark (uint32_t nHarvesters, double secondsPerOp, std::string name)
+    : m_nHarvesters (nHarvesters),
+      m_secondsPerOp (secondsPerOp),
+      m_name (name)
+  {
+  }
+  std::string GetName (void) const
+  {
+    return m_name;
+  }
+  double Run (uint64_t ops)
+  {
+    NodeContainer nodes;
+    nodes.Create (m_nHarvesters);
+    BasicEnergySourceHelper sourceHelper;
+    EnergySourceContainer sources = sourceHelper.Install (nodes);
+    SolarEnergyHarvesterHelper harvesterHelper;
+    harvesterHelper.Set ("StartAt", StringValue ("2015-06-21 00:00:00"));
+    harvesterHelper.Install (sources);
+
+    Simulator::Stop (Seconds (ops * m_secondsPerOp / m_nHarvesters));
+    double begin = GetWallSeconds ();
+    Simulator::Run ();
+    double elapsed = GetWallSeconds () - begin;
+    Simulator::Destroy ();
+    return elapsed;
+  }
+private:
+  uint32_t m_nHarvesters;
+  double m_secondsPerOp;
+  std::string m_name;
+};
+
+/**
+ * Compare a sun position algorithm with SPA, hourly over 2015 at the given
+ * latitudes, on the daytime samples only. One CSV line is printed per
+ * latitude:
+ *
+ *   algorithm,latitude,samples,mean_zenith_error,max_zenith_error,max_azimuth_error
+ *
+ * The errors are in degrees; the azimuth one is measured with the sun
+ * above 5 degrees, where the azimuth is well conditioned.
+ */
+static void
+MeasureAccuracy (Sun::PositionFunction position, std::string name, std::ostream &os)
+{
+  const double latitudes[] = { 0, g_latitude, 60 };
+  std::vector<tm> dates (365 * HOURS_IN_DAY);
+  time_t start = 1420070400; // 2015-01-01 00:00:00 UTC
+  for (uint32_t i = 0; i < dates.size (); ++i)
+    {
+      time_t when = start + (time_t) i * SECONDS_IN_HOUR;
+      gmtime_r (&when, &dates[i]);
+    }
+
+  for (uint32_t l = 0; l < sizeof (latitudes) / sizeof (latitudes[0]); ++l)
+    {
+      uint32_t samples = 0;
+      double sumZenithError = 0;
+      double maxZenithError = 0;
+      double maxAzimuthError = 0;
+      for (uint32_t i = 0; i < dates.size (); ++i)
+        {
+          Sun::Coordinates reference;
+          Sun::SPA (&dates[i], latitudes[l], g_longitude, &reference);
+          if (reference.dElevationAngle <= 0)
+            {
+              continue;
+            }
+          Sun::Coordinates coordinates;
+          position (&dates[i], latitudes[l], g_longitude, &coordinates);
+
+          double zenithError = std::fabs (coordinates.dZenithAngle - reference.dZenithAngle);
+          sumZenithError += zenithError;
+          maxZenithError = std::max (maxZenithError, zenithError);
+          if (reference.dElevationAngle > 5)
+            {
+              double azimuthError = std::fabs (coordinates.dAzimuth - reference.dAzimuth);
+              maxAzimuthError = std::max (maxAzimuthError, std::min (azimuthError, 360 - azimuthError));
+            }
+          ++samples;
+        }
+      os << name << "," << latitudes[l] << "," << samples << "," << sumZenithError / samples << ","
+         << maxZenithError << "," << maxAzimuthError << std::endl;
+    }
+}
+
+static void
+Measure (Benchmark &benchmark, uint64_t ops, uint32_t repetitions, std::ostream &os)
+{
+  benchmark.Run (std::max<uint64_t> (ops / 10, 1)); // warm-up
+
+  std::vector<double> samples;
+  double sum = 0;
+  for (uint32_t r = 0; r < repetitions; ++r)
+    {
+      double ns = benchmark.Run (ops) * 1e9 / ops;
+      samples.push_back (ns);
+      sum += ns;
+    }
+  std::sort (samples.begin (), samples.end ());
+
+  os << benchmark.GetName () << "," << ops << "," << repetitions << ","
+     << samples.front () << "," << samples[samples.size () / 2] << "," << sum / repetitions << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t ops = 1000000;
+  uint32_t repetitions = 5;
+  uint32_t harvesters = 100;
+  bool simulations = true;
+  std::string output = "";
+  bool accuracy = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("ops", "Operations per repetition of the micro-benchmarks", ops);
+  cmd.AddValue ("repetitions", "Repetitions of every benchmark", repetitions);
+  cmd.AddValue ("harvesters", "Harvesters simulated by the UpdateHarvestedPower benchmark", harvesters);
+  cmd.AddValue ("simulations", "Run the benchmarks that need the simulator", simulations);
+  cmd.AddValue ("accuracy", "Print the accuracy of the sun position algorithms against SPA instead of the timings", accuracy);
+  cmd.AddValue ("output", "Write the results to this file instead of the standard output", output);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (ops > 0 && repetitions > 0 && harvesters > 0, "ops, repetitions and harvesters must be positive");
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      NS_ABORT_MSG_UNLESS (file.is_open (), "Cannot open " << output);
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+
+  if (accuracy)
+    {
+      os << "algorithm,latitude,samples,mean_zenith_error,max_zenith_error,max_azimuth_error" << std::endl;
+      MeasureAccuracy (&Sun::PSA, "PSA", os);
+      MeasureAccuracy (&Sun::FastPosition, "Fast", os);
+      return 0;
+    }
+
+  std::vector<tm> dates = MakeDates (4096);
+
+  os << "benchmark,ops,repetitions,min_ns_per_op,median_ns_per_op,mean_ns_per_op" << std::endl;
+
+  SunPositionBenchmark psa (dates, &Sun::PSA, "Sun::PSA");
+  Measure (psa, ops, repetitions, os);
+  CelestialStateBenchmark celestialState (dates);
+  Measure (celestialState, ops, repetitions, os);
+  LocalStageBenchmark localStage (dates);
+  Measure (localStage, ops, repetitions, os);
+  SunPositionBenchmark fast (dates, &Sun::FastPosition, "Sun::FastPosition");
+  Measure (fast, ops, repetitions, os);
+  SunPositionBenchmark spa (dates, &Sun::SPA, "Sun::SPA");
+  Measure (spa, ops, repetitions, os);
+  IncidentInsolationBenchmark incidentInsolation (dates);
+  Measure (incidentInsolation, ops, repetitions, os);
+  AirMassBenchmark airMass;
+  Measure (airMass, ops, repetitions, os);
+  CalculateHarvestedPowerBenchmark calculateHarvestedPower (dates);
+  Measure (calculateHarvestedPower, ops, repetitions, os);
+  SunTrackBenchmark sunTrack (dates);
+  Measure (sunTrack, ops, repetitions, os);
+
+  if (simulations)
+    {
+      SimulationBenchmark update (harvesters, 1, "SolarEnergyHarvester::UpdateHarvestedPower");
+      Measure (update, (uint64_t) harvesters * SECONDS_IN_HOUR, repetitions, os);
+      SimulationBenchmark day (1, SECONDS_IN_DAY, "SolarEnergyHarvester::Day");
+      Measure (day, 1, repetitions, os);
+    }
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Golden reference series generator.
+ *
+ * Writes the power of a set of sites and panels over one year, computed by
+ * the reference path (SolarEnergyHarvester::CalculateHarvestedPower with
+ * PSA), in the format read by the sun-harvester-accuracy test suite.
+ * The step is not a divisor of an hour, so that the samples fall at every
+ * phase of the knots, blocks and chunks of the fast paths.
+ *
+ * The series must be regenerated, and the change reviewed, only when the
+ * reference model itself is changed on purpose:
+ *
+ *   ./waf --run "sun-harvester-golden --output=src/sun-harvester/test/data/sun-harvester-golden.txt"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SunHarvesterGolden");
+
+struct GoldenConfig
+{
+  const char *name;
+  double latitude;
+  double longitude;
+  double altitude;
+  double panelTiltAngle;
+  double panelAzimuthAngle;
+};
+
+static const GoldenConfig g_configs[] = {
+  { "reggio-flat", 38.11, 15.661, 31, 0, 0 },
+  { "reggio-tilted", 38.11, 15.661, 31, 30, 0 },
+  { "reggio-vertical", 38.11, 15.661, 31, 90, 90 },
+  { "quito", -0.18, -78.47, 2850, 10, 180 },
+  { "sydney", -33.87, 151.21, 58, 30, 180 },
+  { "reykjavik", 64.15, -21.94, 30, 60, 45 },
+};
+
+int
+main (int argc, char *argv[])
+{
+  std::string output = "sun-harvester-golden.txt";
+  int64_t start = 1420070400; // 2015-01-01 00:00:00 UTC
+  uint32_t step = 3607;
+  uint32_t samples = 365 * SECONDS_IN_DAY / step;
+
+  CommandLine cmd;
+  cmd.AddValue ("output", "The golden series file", output);
+  cmd.Parse (argc, argv);
+
+  FILE *file = fopen (output.c_str (), "w");
+  NS_ABORT_MSG_UNLESS (file != 0, "Cannot open " << output);
+
+  const uint32_t nConfigs = sizeof (g_configs) / sizeof (g_configs[0]);
+  std::vector<SolarEnergyHarvester::Panel> panels;
+  fprintf (file, "# sun-harvester golden series: the reference PSA power [W], one sample per line, one column per config\n");
+  fprintf (file, "# config: name latitude longitude altitude solarCellEfficiency dcdcEfficiency "
+           "panelAzimuthAngle panelTiltAngle panelDimension diffusePercentage\n");
+  fprintf (file, "start %lld\nstep %u\nsamples %u\n", (long long) start, step, samples);
+  for (uint32_t c = 0; c < nConfigs; ++c)
+    {
+      SolarEnergyHarvester::Panel panel;
+      panel.latitude = g_configs[c].latitude;
+      panel.longitude = g_configs[c].longitude;
+      panel.altitude = g_configs[c].altitude;
+      panel.airMass = Sun::GetAirMass (panel.latitude, panel.altitude);
+      panel.solarCellEfficiency = 8;
+      panel.dcdcEfficiency = 90;
+      panel.panelAzimuthAngle = g_configs[c].panelAzimuthAngle;
+      panel.panelTiltAngle = g_configs[c].panelTiltAngle;
+      panel.panelDimension = 1;
+      panel.diffusePercentage = 10;
+      panel.sunPositionAlgorithm = Sun::PSA_ALGORITHM;
+      panels.push_back (panel);
+      fprintf (file, "config %s %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g\n", g_configs[c].name,
+               panel.latitude, panel.longitude, panel.altitude, panel.solarCellEfficiency, panel.dcdcEfficiency,
+               panel.panelAzimuthAngle, panel.panelTiltAngle, panel.panelDimension, panel.diffusePercentage);
+    }
+
+  time_t when = start;
+  tm startDate;
+  gmtime_r (&when, &startDate);
+  for (uint32_t i = 0; i < samples; ++i)
+    {
+      tm date = startDate;
+      Sun::AddSeconds (&date, (int64_t) i * step);
+      for (uint32_t c = 0; c < nConfigs; ++c)
+        {
+          double power = SolarEnergyHarvester::CalculateHarvestedPower (&date, panels[c]);
+          fprintf (file, c == 0 ? "%.12g" : " %.12g", power);
+        }
+      fprintf (file, "\n");
+    }
+  fclose (file);
+
+  return 0;
+}
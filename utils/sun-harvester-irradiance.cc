@@ -0,0 +1,369 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2015 Universita' Mediterranea di Reggio Calabria (UNIRC)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Orazio Briante <orazio.briante@unirc.it>
+ */
+
+/*
+ * Measured irradiance converter.
+ *
+ * Converts, once, a measured irradiance file into the fixed-stride binary
+ * dataset mapped by SolarIrradianceDataset and replayed by the harvesters
+ * through the IrradianceDataset attribute. The input formats are:
+ *
+ *  - csv: one "time,ghi,dni,dhi" line per sample, further columns ignored,
+ *    time being seconds since the Epoch or "YYYY-MM-DD hh:mm[:ss]" (also
+ *    with a T separator), in UTC unless utcOffset is given; the lines that
+ *    do not start with a digit are skipped;
+ *  - tmy3: the NREL TMY3 CSV files, with the station in the first line and
+ *    hourly values in local standard time;
+ *  - epw: the EnergyPlus weather files, with the station in the LOCATION
+ *    line and hourly values in local standard time.
+ *
+ * The TMY3 and EPW values integrate the hour ending at their time stamp, so
+ * they are stamped at the middle of that hour, and, as their months come
+ * from different years, they are all moved to the year of the first one.
+ * Missing or negative values become NaN; gaps up to maxGap samples are
+ * linearly interpolated, longer ones are left missing.
+ *
+ *   ./waf --run "sun-harvester-irradiance --input=station.csv --output=station.irr"
+ *   ./waf --run "sun-harvester-irradiance --input=723650TYA.CSV --format=tmy3 --output=abq.irr"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/sun-harvester-module.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SunHarvesterIrradiance");
+
+struct Sample
+{
+  int64_t time; //!< UTC, in seconds since the Epoch
+  SolarIrradianceDataset::Record record;
+};
+
+static bool
+operator< (const Sample &a, const Sample &b)
+{
+  return a.time < b.time;
+}
+
+static std::vector<std::string>
+Split (const std::string &line)
+{
+  std::vector<std::string> fields;
+  std::istringstream iss (line);
+  std::string field;
+  while (std::getline (iss, field, ','))
+    {
+      fields.push_back (field);
+    }
+  return fields;
+}
+
+static float
+ParseValue (const std::string &field)
+{
+  char *end;
+  double value = strtod (field.c_str (), &end);
+  if (end == field.c_str () || value < 0 || value >= 9999)
+    {
+      return std::numeric_limits<float>::quiet_NaN ();
+    }
+  return value;
+}
+
+static int64_t
+GetTime (int year, int month, int day, int hour, int minute, int second, double utcOffset)
+{
+  tm date;
+  memset (&date, 0, sizeof (date));
+  date.tm_year = year - 1900;
+  date.tm_mon = month - 1;
+  date.tm_mday = day;
+  date.tm_hour = hour;
+  date.tm_min = minute;
+  date.tm_sec = second;
+  date.tm_gmtoff = (long) (utcOffset * SECONDS_IN_HOUR);
+  return Sun::GetUnixTime (&date);
+}
+
+static bool
+ParseCsvTime (const std::string &field, double utcOffset, int64_t *time)
+{
+  int year, month, day, hour, minute, second = 0;
+  if (sscanf (field.c_str (), "%d-%d-%d%*1[ T]%d:%d:%d", &year, &month, &day, &hour, &minute, &second) >= 5)
+    {
+      *time = GetTime (year, month, day, hour, minute, second, utcOffset);
+      return true;
+    }
+  char *end;
+  *time = strtoll (field.c_str (), &end, 10);
+  return end != field.c_str ();
+}
+
+static void
+ReadCsv (std::istream &is, double utcOffset, std::vector<Sample> *samples)
+{
+  std::string line;
+  while (std::getline (is, line))
+    {
+      if (line.empty () || !isdigit (line[0]))
+        {
+          continue;
+        }
+      std::vector<std::string> fields = Split (line);
+      Sample sample;
+      if (fields.size () < 4 || !ParseCsvTime (fields[0], utcOffset, &sample.time))
+        {
+          continue;
+        }
+      sample.record.ghi = ParseValue (fields[1]);
+      sample.record.dni = ParseValue (fields[2]);
+      sample.record.dhi = ParseValue (fields[3]);
+      samples->push_back (sample);
+    }
+}
+
+static void
+ReadTmy3 (std::istream &is, SolarIrradianceDataset::Header *header, std::vector<Sample> *samples)
+{
+  std::string line;
+  NS_ABORT_MSG_UNLESS (std::getline (is, line), "Empty TMY3 file");
+  // USAF,Name,State,TZ,latitude,longitude,elevation
+  std::vector<std::string> station = Split (line);
+  NS_ABORT_MSG_UNLESS (station.size () >= 7, "Not a TMY3 file");
+  double utcOffset = atof (station[3].c_str ());
+  header->latitude = atof (station[4].c_str ());
+  header->longitude = atof (station[5].c_str ());
+  header->altitude = atof (station[6].c_str ());
+  std::getline (is, line); // the column names
+
+  int firstYear = 0;
+  while (std::getline (is, line))
+    {
+      // MM/DD/YYYY,HH:MM,ETR,ETRN,GHI,source,uncertainty,DNI,source,uncertainty,DHI,...
+      std::vector<std::string> fields = Split (line);
+      int year, month, day, hour, minute;
+      if (fields.size () < 11 || sscanf (fields[0].c_str (), "%d/%d/%d", &month, &day, &year) != 3
+          || sscanf (fields[1].c_str (), "%d:%d", &hour, &minute) != 2)
+        {
+          continue;
+        }
+      firstYear = firstYear ? firstYear : year;
+      Sample sample;
+      sample.time = GetTime (firstYear, month, day, hour, minute, 0, utcOffset) - SECONDS_IN_HOUR / 2;
+      sample.record.ghi = ParseValue (fields[4]);
+      sample.record.dni = ParseValue (fields[7]);
+      sample.record.dhi = ParseValue (fields[10]);
+      samples->push_back (sample);
+    }
+}
+
+static void
+ReadEpw (std::istream &is, SolarIrradianceDataset::Header *header, std::vector<Sample> *samples)
+{
+  std::string line;
+  double utcOffset = 0;
+  int firstYear = 0;
+  while (std::getline (is, line))
+    {
+      std::vector<std::string> fields = Split (line);
+      if (!fields.empty () && fields[0] == "LOCATION" && fields.size () >= 10)
+        {
+          // LOCATION,city,state,country,source,WMO,latitude,longitude,TZ,elevation
+          header->latitude = atof (fields[6].c_str ());
+          header->longitude = atof (fields[7].c_str ());
+          utcOffset = atof (fields[8].c_str ());
+          header->altitude = atof (fields[9].c_str ());
+          continue;
+        }
+      // year,month,day,hour,minute,source,...,GHI (13),DNI (14),DHI (15),...
+      if (fields.size () < 16 || line.empty () || !isdigit (line[0]))
+        {
+          continue;
+        }
+      int year = atoi (fields[0].c_str ());
+      firstYear = firstYear ? firstYear : year;
+      Sample sample;
+      sample.time = GetTime (firstYear, atoi (fields[1].c_str ()), atoi (fields[2].c_str ()),
+                             atoi (fields[3].c_str ()), 0, 0, utcOffset) - SECONDS_IN_HOUR / 2;
+      sample.record.ghi = ParseValue (fields[13]);
+      sample.record.dni = ParseValue (fields[14]);
+      sample.record.dhi = ParseValue (fields[15]);
+      samples->push_back (sample);
+    }
+}
+
+/**
+ * Interpolate the runs of at most maxGap missing values of one field.
+ * \return the values left missing
+ */
+static uint64_t
+FillGaps (std::vector<SolarIrradianceDataset::Record> &records, float SolarIrradianceDataset::Record::*field,
+          uint32_t maxGap)
+{
+  uint64_t missing = 0;
+  uint64_t last = records.size (); // the last valid record, none yet
+  for (uint64_t i = 0; i < records.size (); ++i)
+    {
+      if (std::isnan (records[i].*field))
+        {
+          continue;
+        }
+      uint64_t gap = last < records.size () ? i - last - 1 : i;
+      if (gap > 0 && gap <= maxGap && last < records.size ())
+        {
+          float a = records[last].*field;
+          float b = records[i].*field;
+          for (uint64_t j = last + 1; j < i; ++j)
+            {
+              records[j].*field = a + (b - a) * (j - last) / (i - last);
+            }
+        }
+      else
+        {
+          missing += gap;
+        }
+      last = i;
+    }
+  missing += last < records.size () ? records.size () - last - 1 : records.size ();
+  return missing;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input;
+  std::string output = "irradiance.irr";
+  std::string format = "csv";
+  uint32_t step = 0;
+  uint32_t maxGap = 60;
+  double utcOffset = 0;
+  double latitude = NAN;
+  double longitude = NAN;
+  double altitude = NAN;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "The measured irradiance file", input);
+  cmd.AddValue ("output", "The binary dataset", output);
+  cmd.AddValue ("format", "The input format: csv, tmy3 or epw", format);
+  cmd.AddValue ("step", "Seconds between two samples, 0 to take the shortest one of the input", step);
+  cmd.AddValue ("maxGap", "The longest run of missing samples to interpolate", maxGap);
+  cmd.AddValue ("utcOffset", "The UTC offset of the csv time stamps, in hours", utcOffset);
+  cmd.AddValue ("latitude", "The station latitude, if not in the input", latitude);
+  cmd.AddValue ("longitude", "The station longitude, if not in the input", longitude);
+  cmd.AddValue ("altitude", "The station altitude [m], if not in the input", altitude);
+  cmd.Parse (argc, argv);
+
+  std::ifstream is (input.c_str ());
+  NS_ABORT_MSG_UNLESS (is, "Cannot open " << input);
+
+  SolarIrradianceDataset::Header header;
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, SolarIrradianceDataset::MAGIC, sizeof (header.magic));
+  header.version = SolarIrradianceDataset::VERSION;
+  header.recordSize = sizeof (SolarIrradianceDataset::Record);
+  header.latitude = latitude;
+  header.longitude = longitude;
+  header.altitude = altitude;
+
+  std::vector<Sample> samples;
+  if (format == "csv")
+    {
+      ReadCsv (is, utcOffset, &samples);
+    }
+  else if (format == "tmy3")
+    {
+      ReadTmy3 (is, &header, &samples);
+    }
+  else if (format == "epw")
+    {
+      ReadEpw (is, &header, &samples);
+    }
+  else
+    {
+      NS_ABORT_MSG ("Unknown format " << format);
+    }
+  NS_ABORT_MSG_IF (samples.size () < 2, "Less than two samples in " << input);
+  std::stable_sort (samples.begin (), samples.end ());
+
+  if (step == 0)
+    {
+      int64_t shortest = std::numeric_limits<int64_t>::max ();
+      for (uint64_t i = 1; i < samples.size (); ++i)
+        {
+          int64_t difference = samples[i].time - samples[i - 1].time;
+          if (difference > 0)
+            {
+              shortest = std::min (shortest, difference);
+            }
+        }
+      step = shortest;
+    }
+  header.step = step;
+  header.start = samples.front ().time;
+  header.records = (samples.back ().time - header.start) / step + 1;
+
+  float nan = std::numeric_limits<float>::quiet_NaN ();
+  SolarIrradianceDataset::Record missing = { nan, nan, nan };
+  std::vector<SolarIrradianceDataset::Record> records (header.records, missing);
+  uint64_t misplaced = 0;
+  for (uint64_t i = 0; i < samples.size (); ++i)
+    {
+      int64_t offset = samples[i].time - header.start;
+      if (offset % step != 0)
+        {
+          ++misplaced;
+          continue;
+        }
+      records[offset / step] = samples[i].record;
+    }
+
+  uint64_t missingGhi = FillGaps (records, &SolarIrradianceDataset::Record::ghi, maxGap);
+  uint64_t missingDni = FillGaps (records, &SolarIrradianceDataset::Record::dni, maxGap);
+  uint64_t missingDhi = FillGaps (records, &SolarIrradianceDataset::Record::dhi, maxGap);
+
+  FILE *file = fopen (output.c_str (), "wb");
+  NS_ABORT_MSG_UNLESS (file != 0, "Cannot open " << output);
+  NS_ABORT_MSG_UNLESS (fwrite (&header, sizeof (header), 1, file) == 1
+                       && fwrite (&records[0], sizeof (records[0]), records.size (), file) == records.size ()
+                       && fclose (file) == 0,
+                       "Cannot write " << output);
+
+  std::cout << "records " << header.records << std::endl;
+  std::cout << "step_s " << header.step << std::endl;
+  std::cout << "start " << header.start << std::endl;
+  std::cout << "off_step_samples " << misplaced << std::endl;
+  std::cout << "missing_ghi " << missingGhi << std::endl;
+  std::cout << "missing_dni " << missingDni << std::endl;
+  std::cout << "missing_dhi " << missingDhi << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Runs the solar-harvester-mpi example on the local host with 1, 2, 4, ...
+# up to MAX_RANKS ranks, and prints one CSV line per run:
+#
+#   ranks,nodes,run_wall_s,events,events_per_wall_s
+#
+# Usage, from the ns-3 top level directory, after ./waf configure --enable-mpi:
+#
+#   src/sun-harvester/utils/sun-harvester-mpi-scaling.sh [MAX_RANKS] [NODES] [DAYS]
+
+MAX_RANKS=${1:-4}
+NODES=${2:-10000}
+DAYS=${3:-7}
+
+./waf build > /dev/null || exit 1
+
+echo "ranks,nodes,run_wall_s,events,events_per_wall_s"
+ranks=1
+while [ "$ranks" -le "$MAX_RANKS" ]; do
+  ./waf --run "solar-harvester-mpi --nodes=$NODES --days=$DAYS --interval=60s" --command-template="mpirun -np $ranks %s" |
+    awk -v ranks="$ranks" -v nodes="$NODES" '
+      $1 == "run_wall_s" { wall = $2 }
+      $1 == "events" { events = $2 }
+      $1 == "events_per_wall_s" { rate = $2 }
+      END { printf "%d,%d,%s,%s,%s\n", ranks, nodes, wall, events, rate }'
+  ranks=$((ranks * 2))
+done